@@ -8,6 +8,7 @@
 
 #include <freertos/FreeRTOS.h>
 #include <esp_err.h>
+#include <stdbool.h>
 
 #define ESP_AGENT_API_ENDPOINT CONFIG_ESP_AGENT_API_ENDPOINT
 
@@ -43,8 +44,10 @@ typedef enum {
  */
 typedef struct {
     esp_agent_conversation_audio_format_t format;
-    uint16_t sample_rate;       /**< Sample rate in Hz (e.g., 8000, 16000) */
+    uint16_t sample_rate;       /**< Sample rate in Hz. Opus supports 8000, 12000, 16000, 24000 and 48000 */
     uint8_t frame_duration;     /**< Frame duration in ms (e.g., 20, 40, 60) */
+    uint32_t frame_duration_us; /**< Frame duration in us, takes precedence over frame_duration when non-zero.
+                                     Needed for 2.5 ms frames. Opus supports 2.5, 5, 10, 20, 40, 60, 80, 100 and 120 ms */
 } esp_agent_audio_config_t;
 
 /**
@@ -59,6 +62,8 @@ typedef struct {
     esp_agent_conversation_type_t conversation_type;
     esp_agent_audio_config_t *upload_audio_config;
     esp_agent_audio_config_t *download_audio_config;
+    bool text_delta;            /**< Deliver text events as deltas of the previous text of the same role.
+                                     See `offset` in esp_agent_message_data_t. */
 } esp_agent_config_t;
 
 /**
@@ -40,6 +40,9 @@ typedef enum {
     ESP_AGENT_EVENT_DATA_TYPE_THINKING,
     ESP_AGENT_EVENT_DATA_TYPE_SPEECH,
 
+    ESP_AGENT_EVENT_AUDIO_CONFIG_CHANGED,   /*!< The server picked a different audio configuration in the handshake */
+    ESP_AGENT_EVENT_BARGE_IN,               /*!< The server detected the user talking over the assistant's speech */
+
     ESP_AGENT_EVENT_DATA_TYPE_MAX,
 } esp_agent_event_t;
 
@@ -71,12 +74,18 @@ typedef enum {
 
 /**
  * @brief This is the `event_data` for the event handler, based on the type of event.
+ *
+ * @note For text data, `offset` is the byte offset in the accumulated text of the role
+ *       at which `text` applies: truncate the previously received text to `offset` bytes
+ *       and append `text`. It is always 0 (full replace) unless `text_delta` is set in
+ *       esp_agent_config_t, and never splits a UTF-8 code point.
  */
 typedef union {
     struct {
         const char *text;
         esp_agent_message_role_t role;
         esp_agent_message_generation_stage_t generation_stage;
+        size_t offset;
     } text;
 
     struct {
@@ -95,6 +104,11 @@ typedef union {
     struct {
         esp_agent_error_t error;
     } error;
+
+    struct {
+        esp_agent_audio_config_t upload;
+        esp_agent_audio_config_t download;
+    } audio_config;
 } esp_agent_message_data_t;
 
 /**
@@ -109,6 +123,18 @@ typedef union {
  */
 esp_err_t esp_agent_register_event_handler(esp_agent_handle_t handle, esp_agent_event_t event, esp_event_handler_t handler, void *user_data, esp_event_handler_instance_t *handler_instance);
 
+/**
+ * @brief Take over the buffer of an ESP_AGENT_EVENT_DATA_TYPE_SPEECH event
+ *
+ * The buffer is normally freed once all event handlers have run. A handler that wants
+ * to keep it, for example to queue it for playback without a copy, takes it over here
+ * and must free() it. Only one handler can take a buffer.
+ *
+ * @param[in] data The `event_data` of the speech event
+ * @return The speech buffer, or NULL if it was already taken
+ */
+uint8_t *esp_agent_speech_data_take(esp_agent_message_data_t *data);
+
 /**
  * @brief This unregisters the events handler for the agent.
  *
@@ -20,12 +20,15 @@ extern "C" {
 #endif
 
 /**
- * @brief Currently only supporting number, string and bool
+ * @brief Tool parameter types
  */
 typedef enum {
     ESP_AGENT_PARAM_TYPE_NUMBER,
     ESP_AGENT_PARAM_TYPE_STRING,
     ESP_AGENT_PARAM_TYPE_BOOL,
+    ESP_AGENT_PARAM_TYPE_OBJECT,    /*!< Walk with esp_agent_tool_param_iter_init() or esp_agent_tool_param_get_member() */
+    ESP_AGENT_PARAM_TYPE_ARRAY,     /*!< Walk with esp_agent_tool_param_iter_init() */
+    ESP_AGENT_PARAM_TYPE_NONE,      /*!< Optional schema parameter that was not provided by the server */
     ESP_AGENT_PARAM_TYPE_MAX,
 } esp_agent_tool_param_type_t;
 
@@ -36,10 +39,14 @@ typedef union {
     double i;
     const char *s;
     bool b;
+    const void *node;   /*!< Object or array, opaque */
 } esp_agent_tool_param_value_t;
 
 /**
  * @brief Tool parameter structure
+ *
+ * Names, strings, objects and arrays are views into the received request, not copies. They
+ * stay valid until the handler returns, or until an async call is completed.
  */
 typedef struct {
     const char *name;
@@ -47,6 +54,20 @@ typedef struct {
     esp_agent_tool_param_value_t value;
 } esp_agent_tool_param_t;
 
+/**
+ * @brief Iterator over the members of an object or the elements of an array parameter
+ */
+typedef struct {
+    const void *next;   /*!< Internal */
+} esp_agent_tool_param_iter_t;
+
+/**
+ * @brief Tool call being executed
+ *
+ * Valid until the handler of the call returns.
+ */
+typedef struct esp_agent_tool_call esp_agent_tool_call_t;
+
 /**
  * @brief Function callback signature
  * @param[in] handle Agent handle
@@ -58,9 +79,97 @@ typedef struct {
  * @return ESP_OK on success, error code otherwise
  *
  * @note The result string must heap allocated and will be freed internally after sending the tool response.
+ * @note Handlers that wait on something slow should get their call with esp_agent_tool_get_current_call()
+ *       and give up once esp_agent_tool_call_is_cancelled() returns true. The response of a cancelled
+ *       call is dropped.
  */
 typedef esp_err_t (*esp_agent_tool_handler_t)(esp_agent_handle_t handle, const char *tool_name, esp_agent_tool_param_t params[], size_t num_params, void *user_data, char **result);
 
+/**
+ * @brief Asynchronous tool callback signature
+ *
+ * The handler starts the work and returns without waiting for it. The call stays open, counts
+ * against `max_concurrency` and keeps its deadline until esp_agent_tool_complete() is called for it.
+ * The worker is free to run other calls in the meantime.
+ *
+ * @param[in] handle Agent handle
+ * @param[in] call Completion token, pass it to esp_agent_tool_complete() exactly once
+ * @param[in] tool_name Name of the tool being executed
+ * @param[in] params Array of tool parameters, valid until the call is completed
+ * @param[in] num_params Number of tool parameters
+ * @param[in] user_data User data
+ * @return ESP_OK if the call will be completed later, an error code to fail the call right away
+ *         (esp_agent_tool_complete() must not be called then)
+ */
+typedef esp_err_t (*esp_agent_async_tool_handler_t)(esp_agent_handle_t handle, esp_agent_tool_call_t *call, const char *tool_name,
+                                                    esp_agent_tool_param_t params[], size_t num_params, void *user_data);
+
+/**
+ * @brief Result writer of a streaming tool call
+ */
+typedef struct esp_agent_tool_writer esp_agent_tool_writer_t;
+
+/**
+ * @brief Streaming tool callback signature
+ *
+ * The handler emits the result in pieces with esp_agent_tool_writer_write() instead of building
+ * one string. Large results are sent as a fragmented websocket message once the handler returns.
+ *
+ * @param[in] handle Agent handle
+ * @param[in] tool_name Name of the tool being executed
+ * @param[in] params Array of tool parameters
+ * @param[in] num_params Number of tool parameters
+ * @param[in] user_data User data
+ * @param[in] writer Result writer, valid until the handler returns
+ * @return ESP_OK on success, error code otherwise. The status is sent after the written result.
+ */
+typedef esp_err_t (*esp_agent_stream_tool_handler_t)(esp_agent_handle_t handle, const char *tool_name, esp_agent_tool_param_t params[],
+                                                     size_t num_params, void *user_data, esp_agent_tool_writer_t *writer);
+
+/**
+ * @brief Declared parameter of a local tool
+ */
+typedef struct {
+    const char *name;                   /**< Parameter name */
+    esp_agent_tool_param_type_t type;   /**< Expected type */
+    bool required;                      /**< Reject the call if the parameter is missing */
+} esp_agent_tool_param_schema_t;
+
+/**
+ * @brief Optional execution settings for a local tool
+ *
+ * @note When a schema is given, calls are validated before any work is scheduled and the handler
+ *       receives exactly `num_params` parameters in the declared order, so it can index them directly.
+ *       Optional parameters that were not provided have type ESP_AGENT_PARAM_TYPE_NONE and
+ *       parameters not in the schema are dropped. The schema is not copied and must stay valid
+ *       while the tool is registered.
+ */
+typedef struct {
+    uint32_t stack_size;        /**< Stack needed by the handler in bytes, 0 if the default is enough.
+                                     Must not exceed CONFIG_ESP_AGENT_TOOL_WORKER_STACK_SIZE */
+    uint8_t max_concurrency;    /**< Max calls of this tool in flight at once, 0 for no limit */
+    const esp_agent_tool_param_schema_t *params;    /**< Parameter schema, NULL to pass parameters as received */
+    size_t num_params;          /**< Number of entries in `params` */
+    uint32_t timeout_ms;        /**< Answer the call with a timeout error if it has not completed within this
+                                     time of being received, 0 for CONFIG_ESP_AGENT_TOOL_DEFAULT_TIMEOUT_MS */
+    uint32_t cache_ttl_ms;      /**< Answer identical calls from the last successful result for this long,
+                                     0 to disable. Only for tools whose result depends on nothing but the
+                                     parameters, or whose owner calls esp_agent_tool_cache_invalidate() */
+} esp_agent_tool_config_t;
+
+/**
+ * @brief Local tool worker pool statistics
+ */
+typedef struct {
+    uint32_t executed;          /**< Calls picked up by a worker */
+    uint32_t rejected;          /**< Calls answered with an error because the pool or the tool was saturated */
+    uint32_t cache_hits;        /**< Calls answered from the result cache without a worker */
+    uint32_t timed_out;         /**< Calls answered with a timeout error because they missed their deadline */
+    uint32_t cancelled;         /**< Calls cancelled by a barge-in, the end of the turn or a disconnect */
+    uint32_t max_queue_wait_ms; /**< Longest time a call waited for a free worker */
+    uint32_t avg_queue_wait_ms; /**< Average time a call waited for a free worker */
+} esp_agent_tool_stats_t;
+
 /**
  * @brief Registers a local tool handler with the agent.
  *
@@ -72,6 +181,91 @@ typedef esp_err_t (*esp_agent_tool_handler_t)(esp_agent_handle_t handle, const c
  */
 esp_err_t esp_agent_register_local_tool(esp_agent_handle_t handle, const char *name, esp_agent_tool_handler_t tool_handler, void *user_data);
 
+/**
+ * @brief Registers a local tool handler with execution settings.
+ *
+ * Tool calls run on a fixed pool of CONFIG_ESP_AGENT_TOOL_WORKER_COUNT workers.
+ *
+ * @param[in] handle Agent handle obtained from esp_agent_init
+ * @param[in] name Name of the tool to register
+ * @param[in] tool_handler Function pointer to the tool handler
+ * @param[in] user_data User data passed to the tool handler
+ * @param[in] config Execution settings, NULL for defaults
+ * @return
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_SIZE if the stack size hint exceeds the worker stack size
+ *      - error code otherwise
+ */
+esp_err_t esp_agent_register_local_tool_with_config(esp_agent_handle_t handle, const char *name, esp_agent_tool_handler_t tool_handler, void *user_data, const esp_agent_tool_config_t *config);
+
+/**
+ * @brief Registers an asynchronous local tool handler.
+ *
+ * Use this for tools that wait on something slow, such as a network request or a device
+ * command, so that the wait does not hold a worker task.
+ *
+ * @param[in] handle Agent handle obtained from esp_agent_init
+ * @param[in] name Name of the tool to register
+ * @param[in] tool_handler Function pointer to the async tool handler
+ * @param[in] user_data User data passed to the tool handler
+ * @param[in] config Execution settings, NULL for defaults
+ * @return ESP_OK on success, error code otherwise
+ */
+esp_err_t esp_agent_register_local_async_tool(esp_agent_handle_t handle, const char *name, esp_agent_async_tool_handler_t tool_handler, void *user_data, const esp_agent_tool_config_t *config);
+
+/**
+ * @brief Registers a streaming local tool handler.
+ *
+ * Streaming tools are never cached, `cache_ttl_ms` is ignored for them.
+ *
+ * @note The result is kept in 1 KiB pieces until the handler returns, then sent as one
+ *       fragmented message. Other messages go out meanwhile, so a slow handler does not hold
+ *       up the conversation.
+ *
+ * @param[in] handle Agent handle obtained from esp_agent_init
+ * @param[in] name Name of the tool to register
+ * @param[in] tool_handler Function pointer to the streaming tool handler
+ * @param[in] user_data User data passed to the tool handler
+ * @param[in] config Execution settings, NULL for defaults
+ * @return ESP_OK on success, error code otherwise
+ */
+esp_err_t esp_agent_register_local_stream_tool(esp_agent_handle_t handle, const char *name, esp_agent_stream_tool_handler_t tool_handler, void *user_data, const esp_agent_tool_config_t *config);
+
+/**
+ * @brief Append a piece of the result of a streaming tool call.
+ *
+ * The data is escaped and appended to the result string, it does not need to be NUL terminated.
+ *
+ * @param[in] writer Writer received by the streaming handler
+ * @param[in] data Result piece
+ * @param[in] len Length of the piece in bytes
+ * @return
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_STATE if the call was cancelled or timed out, or memory ran out, the
+ *        handler should stop writing
+ *      - error code otherwise
+ */
+esp_err_t esp_agent_tool_writer_write(esp_agent_tool_writer_t *writer, const char *data, size_t len);
+
+/**
+ * @brief Complete an asynchronous tool call.
+ *
+ * May be called from any task, including from within the async handler. The response is
+ * dropped if the call was cancelled or has timed out meanwhile, see esp_agent_tool_call_is_cancelled().
+ * The call must not be used after this returns.
+ *
+ * @note All pending calls must be completed before esp_agent_deinit().
+ *
+ * @param[in] call Completion token received by the async handler
+ * @param[in] status ESP_OK if the tool succeeded, error code otherwise
+ * @param[in] result Heap allocated result string, freed internally. May be NULL
+ * @return
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_STATE if the call was already completed
+ *      - ESP_ERR_INVALID_ARG if the call is not an async call
+ */
+esp_err_t esp_agent_tool_complete(esp_agent_tool_call_t *call, esp_err_t status, char *result);
+
 /**
  * @brief This unregisters the local tool for the agent.
  *
@@ -81,6 +275,99 @@ esp_err_t esp_agent_register_local_tool(esp_agent_handle_t handle, const char *n
  */
 esp_err_t esp_agent_unregister_local_tool(esp_agent_handle_t handle, const char *name);
 
+/**
+ * @brief Start iterating over an object or array parameter.
+ *
+ * @param[out] iter Iterator
+ * @param[in] param Object or array parameter
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if the parameter is not an object or array
+ */
+esp_err_t esp_agent_tool_param_iter_init(esp_agent_tool_param_iter_t *iter, const esp_agent_tool_param_t *param);
+
+/**
+ * @brief Get the next member or element.
+ *
+ * @param[in,out] iter Iterator
+ * @param[out] item Next item, with the member name for objects and a NULL name for arrays.
+ *                  JSON null is reported as ESP_AGENT_PARAM_TYPE_NONE
+ * @return true if an item was returned, false at the end
+ */
+bool esp_agent_tool_param_iter_next(esp_agent_tool_param_iter_t *iter, esp_agent_tool_param_t *item);
+
+/**
+ * @brief Look up a member of an object parameter.
+ *
+ * @param[in] param Object parameter
+ * @param[in] name Member name
+ * @param[out] member Member
+ * @return
+ *      - ESP_OK on success
+ *      - ESP_ERR_NOT_FOUND if the object has no such member
+ *      - ESP_ERR_INVALID_ARG if the parameter is not an object
+ */
+esp_err_t esp_agent_tool_param_get_member(const esp_agent_tool_param_t *param, const char *name, esp_agent_tool_param_t *member);
+
+/**
+ * @brief Get the number of members or elements of an object or array parameter.
+ *
+ * @param[in] param Object or array parameter
+ * @return Number of items, 0 for other types
+ */
+size_t esp_agent_tool_param_get_size(const esp_agent_tool_param_t *param);
+
+/**
+ * @brief Get the tool call executed by the calling task.
+ *
+ * Async handlers receive their call directly and do not need this.
+ *
+ * @param[in] handle Agent handle obtained from esp_agent_init
+ * @return The call, or NULL if the calling task is not running a tool handler
+ */
+esp_agent_tool_call_t *esp_agent_tool_get_current_call(esp_agent_handle_t handle);
+
+/**
+ * @brief Check whether a tool call should be abandoned.
+ *
+ * A call is cancelled when it misses its deadline, when the user barges in, when the
+ * turn ends or when the connection is lost.
+ *
+ * @param[in] call Tool call
+ * @return true if the response of the call will not be sent
+ */
+bool esp_agent_tool_call_is_cancelled(const esp_agent_tool_call_t *call);
+
+/**
+ * @brief Get the time left until the deadline of a tool call.
+ *
+ * @param[in] call Tool call
+ * @return Remaining time in ms, 0 if cancelled or expired, UINT32_MAX if the call has no deadline
+ */
+uint32_t esp_agent_tool_call_get_remaining_ms(const esp_agent_tool_call_t *call);
+
+/**
+ * @brief Drop the cached results of a local tool.
+ *
+ * Call this when the state a cached tool reports has changed. Results of calls that are
+ * still running when this is called are not cached either.
+ *
+ * @param[in] handle Agent handle obtained from esp_agent_init
+ * @param[in] name Name of the tool, NULL for all tools
+ * @return
+ *      - ESP_OK on success
+ *      - ESP_ERR_NOT_FOUND if no tool with that name is registered
+ *      - error code otherwise
+ */
+esp_err_t esp_agent_tool_cache_invalidate(esp_agent_handle_t handle, const char *name);
+
+/**
+ * @brief Get the local tool worker pool statistics.
+ *
+ * @param[in] handle Agent handle obtained from esp_agent_init
+ * @param[out] stats Statistics
+ * @return ESP_OK on success, error code otherwise
+ */
+esp_err_t esp_agent_get_tool_stats(esp_agent_handle_t handle, esp_agent_tool_stats_t *stats);
+
 #ifdef __cplusplus
 }
 #endif
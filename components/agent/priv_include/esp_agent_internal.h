@@ -10,6 +10,7 @@
 #include <esp_websocket_client.h>
 #include <esp_timer.h>
 #include <freertos/event_groups.h>
+#include <freertos/semphr.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -29,14 +30,63 @@ typedef enum {
     ESP_AGENT_HANDSHAKE_DONE,
 } esp_agent_handshake_state_t;
 
-/* Local tool node structure for simple linked list */
+/* Number of hash buckets for the local tool registry, must be a power of 2 */
+#define ESP_AGENT_TOOL_HASH_BUCKETS 16
+
+/* Number of cached results per tool with a cache TTL */
+#define ESP_AGENT_TOOL_CACHE_ENTRIES 4
+
+/* Cached result of a successful tool call */
+typedef struct {
+    uint64_t key;                                  /* Hash of the normalized parameters */
+    int64_t expires_us;                            /* esp_timer time after which the entry is stale */
+    char *result;                                  /* NULL if the entry is unused */
+} esp_agent_tool_cache_entry_t;
+
+/* Local tool node, chained per hash bucket */
 typedef struct local_tool_node {
     char *name;                                    /* Tool name (dynamically allocated) */
-    esp_agent_tool_handler_t tool_handler;         /* Function pointer */
+    uint32_t hash;                                 /* Hash of the name */
+    uint32_t registration;                         /* Tells this registration apart from earlier ones of the same name */
+    const esp_agent_tool_param_schema_t *params;   /* Declared parameters, NULL if none */
+    size_t num_params;
+    esp_agent_tool_handler_t tool_handler;         /* Function pointer, NULL for async and streaming tools */
+    esp_agent_async_tool_handler_t async_handler;  /* Function pointer, NULL for sync tools */
+    esp_agent_stream_tool_handler_t stream_handler; /* Function pointer, NULL for non-streaming tools */
     void *user_data;                               /* User-provided context */
-    struct local_tool_node *next;                 /* Next node in the list */
+    uint8_t max_concurrency;                       /* Max calls in flight, 0 for no limit */
+    uint8_t in_flight;                             /* Calls queued or running */
+    uint32_t timeout_ms;                           /* Call deadline, 0 for none */
+    uint32_t cache_ttl_ms;                         /* Result cache TTL, 0 if caching is disabled */
+    uint32_t cache_generation;                     /* Renewed on invalidation, results of older calls are not stored */
+    esp_agent_tool_cache_entry_t *cache;           /* ESP_AGENT_TOOL_CACHE_ENTRIES entries, NULL if caching is disabled */
+    struct local_tool_node *next;                 /* Next node in the bucket */
 } local_tool_node_t;
 
+/* Local tool worker pool */
+typedef struct {
+    QueueHandle_t queue;                           /* Pending tool requests, NULL request stops a worker */
+    esp_agent_tool_call_t *active;                 /* Calls queued or running, for deadlines and cancellation */
+    TaskHandle_t workers[CONFIG_ESP_AGENT_TOOL_WORKER_COUNT];
+    SemaphoreHandle_t lock;                        /* Protects local_tools, the active calls and the counters below */
+    uint32_t executed;
+    uint32_t rejected;
+    uint32_t cache_hits;
+    uint32_t timed_out;
+    uint32_t cancelled;
+    uint32_t cache_generation;                     /* Source of tool cache generations */
+    uint32_t registrations;                        /* Source of tool registration ids */
+    uint32_t max_wait_ms;
+    uint64_t total_wait_ms;
+} esp_agent_tool_pool_t;
+
+/* Per-role transcript coalescing state */
+typedef struct {
+    char *pending;                                 /* Latest undelivered speculative text */
+    char *delivered;                               /* Last delivered full text, baseline for deltas */
+    int64_t last_delivery_us;                      /* Time of the last delivered text event */
+} esp_agent_transcript_slot_t;
+
 /* Agent handle structure */
 typedef struct {
     bool started;
@@ -49,6 +99,7 @@ typedef struct {
     esp_agent_audio_config_t upload_audio_config;
     esp_agent_audio_config_t download_audio_config;
     esp_agent_conversation_type_t conversation_type;
+    bool text_delta;
     esp_event_handler_instance_t internal_event_handler;
     esp_agent_handshake_state_t handshake_state;
     esp_event_loop_handle_t event_loop;
@@ -58,12 +109,20 @@ typedef struct {
     QueueHandle_t send_queue;
     TaskHandle_t send_task_handle;
     EventGroupHandle_t event_group;               /* Event group for task stop signals */
-    local_tool_node_t *local_tools;               /* Head of linked list of registered local tools */
+    local_tool_node_t *local_tools[ESP_AGENT_TOOL_HASH_BUCKETS]; /* Registered local tools */
+    esp_agent_tool_pool_t tool_pool;
+    esp_agent_transcript_slot_t transcript[ESP_AGENT_MESSAGE_ROLE_MAX]; /* Only touched from the message task */
 } esp_agent_t;
 
 /* This function will strip the https:// prefix from the menuconfig URL */
 char *esp_agents_get_api_endpoint(void);
 
+/* Frame duration of an audio config in us, frame_duration_us taking precedence */
+static inline uint32_t esp_agent_audio_frame_duration_us(const esp_agent_audio_config_t *config)
+{
+    return config->frame_duration_us ? config->frame_duration_us : config->frame_duration * 1000;
+}
+
 #ifdef __cplusplus
 }
 #endif
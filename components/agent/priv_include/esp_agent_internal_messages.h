@@ -84,3 +84,11 @@ char *esp_agent_messages_prepare_speech_conversation_start(esp_agent_handle_t ha
  * @return The JSON string of the speech conversation end message, if successful, otherwise NULL
  */
 char *esp_agent_messages_prepare_speech_conversation_end(esp_agent_handle_t handle);
+
+/**
+ * @brief Prepare the barge in message
+ *
+ * @param handle The agent handle
+ * @return The JSON string of the barge in message, if successful, otherwise NULL
+ */
+char *esp_agent_messages_prepare_barge_in(esp_agent_handle_t handle);
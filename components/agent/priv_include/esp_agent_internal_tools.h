@@ -6,6 +6,8 @@
 
 #pragma once
 
+#include <cJSON.h>
+
 #include <esp_agent.h>
 
 #include <esp_agent_internal.h>
@@ -14,17 +16,58 @@
 extern "C" {
 #endif
 
+/**
+ * @brief Create the tool worker pool
+ *
+ * @param handle Agent handle
+ * @return ESP_OK on success, error code otherwise
+ */
+esp_err_t esp_agent_tools_init(esp_agent_handle_t handle);
+
+/**
+ * @brief Stop the tool workers and free all registered tools
+ *
+ * @param handle Agent handle
+ */
+void esp_agent_tools_deinit(esp_agent_handle_t handle);
+
 /**
  * @brief Execute a client tool (called from message handler)
  *
+ * The parameters are validated against the tool schema and the call is queued for the
+ * worker pool. If the tool is unknown, the parameters are invalid or the pool is saturated,
+ * an error tool response is sent to the server and an error is returned.
+ *
  * @param handle Agent handle
  * @param request_id Request ID for the tool call
  * @param tool_name Name of the tool to execute
- * @param parameters Array of tool parameters
- * @param num_parameters Number of parameters
- * @return ESP_OK on success, error code otherwise
+ * @param input Tool input object detached from the request, may be NULL. Ownership is taken, the
+ *              handler parameters are views into it and it is freed with the call.
+ * @return ESP_OK if the call was queued, error code otherwise
+ */
+esp_err_t esp_agent_execute_tool(esp_agent_handle_t handle, const char *request_id, const char *tool_name, cJSON *input);
+
+/**
+ * @brief Answer tool calls whose deadline has passed with a timeout error
+ *
+ * The handler keeps running, but its response is dropped.
+ *
+ * @note Called periodically from the message processing task.
+ *
+ * @param handle Agent handle
+ */
+void esp_agent_tools_check_deadlines(esp_agent_handle_t handle);
+
+/**
+ * @brief Cancel all queued and running tool calls
+ *
+ * Queued calls are skipped, running handlers see esp_agent_tool_call_is_cancelled() return
+ * true, and no response is sent for any of them.
+ *
+ * @param handle Agent handle
+ * @param reason Reason for the log
  */
-esp_err_t esp_agent_execute_tool(esp_agent_handle_t handle, char *request_id, char *tool_name, esp_agent_tool_param_t *parameters, size_t num_parameters);
+void esp_agent_tools_cancel_all(esp_agent_handle_t handle, const char *reason);
 
 #ifdef __cplusplus
 }
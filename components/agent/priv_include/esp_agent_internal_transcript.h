@@ -0,0 +1,72 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <freertos/FreeRTOS.h>
+
+#include <esp_agent.h>
+
+#include <esp_agent_internal.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Submit a transcript received from the server for delivery
+ *
+ * Speculative text is coalesced per role and delivered at most
+ * CONFIG_ESP_AGENT_TRANSCRIPT_MAX_RATE_HZ times per second. Any other
+ * stage drops the pending speculative text of that role and is delivered immediately.
+ * In delta mode, the delivered text is diffed against the previous one of the same role.
+ *
+ * @note Must only be called from the message processing task.
+ *
+ * @param handle Agent handle
+ * @param role Role of the transcript
+ * @param stage Generation stage of the transcript
+ * @param text Transcript text (copied)
+ * @return ESP_OK on success, error code otherwise
+ */
+esp_err_t esp_agent_transcript_submit(esp_agent_handle_t handle, esp_agent_message_role_t role,
+                                      esp_agent_message_generation_stage_t stage, const char *text);
+
+/**
+ * @brief Deliver pending speculative text whose rate limit has elapsed
+ *
+ * @param handle Agent handle
+ */
+void esp_agent_transcript_flush_due(esp_agent_handle_t handle);
+
+/**
+ * @brief Deliver all pending speculative text immediately and start a new turn
+ *
+ * The next text of each role is delivered as a full replace.
+ *
+ * @param handle Agent handle
+ */
+void esp_agent_transcript_flush(esp_agent_handle_t handle);
+
+/**
+ * @brief Get how long the message task may block before a pending text becomes due
+ *
+ * @param handle Agent handle
+ * @param max_wait Upper bound to return when nothing is pending
+ * @return Ticks to wait
+ */
+TickType_t esp_agent_transcript_next_wait(esp_agent_handle_t handle, TickType_t max_wait);
+
+/**
+ * @brief Drop all pending transcript state
+ *
+ * @param handle Agent handle
+ */
+void esp_agent_transcript_reset(esp_agent_handle_t handle);
+
+#ifdef __cplusplus
+}
+#endif
@@ -18,13 +18,22 @@ extern "C" {
 typedef enum {
     WS_SEND_MSG_TYPE_TEXT,
     WS_SEND_MSG_TYPE_BINARY,
+    WS_SEND_MSG_TYPE_TEXT_FRAGMENTS,
 } ws_send_msg_type_t;
 
+/* One piece of a text message sent in fragments */
+typedef struct ws_send_fragment {
+    struct ws_send_fragment *next;
+    size_t len;
+    char data[];
+} ws_send_fragment_t;
+
 /* WebSocket send message structure */
 typedef struct {
     ws_send_msg_type_t type;
     char *payload;
     size_t len;
+    ws_send_fragment_t *fragments;  /* WS_SEND_MSG_TYPE_TEXT_FRAGMENTS only, payload is NULL */
 } ws_send_message_t;
 
 /**
@@ -47,6 +56,25 @@ esp_err_t esp_agent_websocket_start(esp_agent_handle_t handle);
  */
 esp_err_t esp_agent_websocket_queue_message(esp_agent_handle_t handle, ws_send_msg_type_t type, const char *payload, size_t len, TickType_t timeout);
 
+/**
+ * @brief Queue a text message made of several pieces, sent as one fragmented message
+ *
+ * The send task writes the pieces back to back, so no other message comes between them.
+ *
+ * @param handle Agent handle
+ * @param fragments The pieces in order. Ownership is taken, also on failure
+ * @param timeout Queue timeout
+ * @return ESP_OK on success, error code otherwise
+ */
+esp_err_t esp_agent_websocket_queue_fragments(esp_agent_handle_t handle, ws_send_fragment_t *fragments, TickType_t timeout);
+
+/**
+ * @brief Free a list of message pieces
+ *
+ * @param fragments First piece, may be NULL
+ */
+void esp_agent_websocket_free_fragments(ws_send_fragment_t *fragments);
+
 /**
  * @brief WebSocket send task
  *
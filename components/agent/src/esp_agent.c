@@ -26,6 +26,7 @@
 #include <esp_agent_websocket.h>
 #include <esp_agent_internal_tools.h>
 #include <esp_agent_internal_events.h>
+#include <esp_agent_internal_transcript.h>
 
 static const char *TAG = "esp_agent";
 
@@ -52,10 +53,14 @@ static void message_processing_task(void *pvParameters)
             break;
         }
 
-        if (xQueueReceive(agent->message_queue, &message, pdMS_TO_TICKS(100)) == pdTRUE) {
+        /* Wake up early if a coalesced transcript is due before the next message */
+        TickType_t wait = esp_agent_transcript_next_wait(agent, pdMS_TO_TICKS(100));
+        if (xQueueReceive(agent->message_queue, &message, wait) == pdTRUE) {
             esp_agent_messages_parse_process(agent, message);
             free(message);
         }
+        esp_agent_transcript_flush_due(agent);
+        esp_agent_tools_check_deadlines(agent);
     }
 
     ESP_LOGD(TAG, "Message Parsing Task exiting cleanly");
@@ -78,6 +83,7 @@ esp_agent_handle_t esp_agent_init(const esp_agent_config_t *config)
 
     agent->conversation_id = NULL;
     agent->conversation_type = config->conversation_type;
+    agent->text_delta = config->text_delta;
 
     if (config->agent_id != NULL) {
         agent->agent_id = strdup(config->agent_id);
@@ -153,8 +159,12 @@ esp_agent_handle_t esp_agent_init(const esp_agent_config_t *config)
     agent->started = false;
     agent->handshake_state = ESP_AGENT_HANDSHAKE_NOT_DONE;
 
-    // Initialize local tools list
-    agent->local_tools = NULL;
+    // Initialize the worker pool that runs local tools
+    err = esp_agent_tools_init(agent);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to initialize tool worker pool");
+        goto err;
+    }
 
     // Create event group for task stop signals
     agent->event_group = xEventGroupCreate();
@@ -233,11 +243,16 @@ void esp_agent_deinit(esp_agent_handle_t handle)
     stop_task_gracefully(&agent->send_task_handle, agent->event_group,
                          SEND_TASK_STOP_BIT, SEND_TASK_EXIT_WAIT_MS, "Send task");
 
+    /* Workers may still queue responses, so stop them before the send queue goes away */
+    esp_agent_tools_deinit(handle);
+
     if (agent->event_group) {
         vEventGroupDelete(agent->event_group);
         agent->event_group = NULL;
     }
 
+    esp_agent_transcript_reset(handle);
+
     if (agent->ws_client) {
         esp_websocket_client_destroy(agent->ws_client);
     }
@@ -283,17 +298,6 @@ void esp_agent_deinit(esp_agent_handle_t handle)
         free(agent->access_token);
     }
 
-    // Clean up all registered local tools
-    local_tool_node_t *tool_node = agent->local_tools;
-    while (tool_node != NULL) {
-        local_tool_node_t *next_node = tool_node->next;
-        if (tool_node->name) {
-            free(tool_node->name);
-        }
-        free(tool_node);
-        tool_node = next_node;
-    }
-
     free(agent);
 
     ESP_LOGI(TAG, "Agent deinitialized");
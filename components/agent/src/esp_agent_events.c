@@ -51,6 +51,18 @@ void esp_agent_internal_event_handler(void *handler_args, esp_event_base_t base,
     }
 }
 
+uint8_t *esp_agent_speech_data_take(esp_agent_message_data_t *data)
+{
+    if (data == NULL) {
+        return NULL;
+    }
+
+    /* The internal handler skips a NULL buffer */
+    uint8_t *speech = (uint8_t *)data->speech.data;
+    data->speech.data = NULL;
+    return speech;
+}
+
 esp_err_t esp_agent_post_event(esp_agent_handle_t handle, esp_agent_event_t event, esp_agent_message_data_t *data)
 {
     if (handle == NULL) {
@@ -11,6 +11,7 @@
 #include <esp_agent_internal_messages.h>
 #include <esp_agent_internal_events.h>
 #include <esp_agent_internal_tools.h>
+#include <esp_agent_internal_transcript.h>
 
 static const char *TAG = "esp_agent_message_handlers";
 
@@ -22,6 +23,8 @@ esp_err_t esp_agent_message_audio_stream_start_handler(esp_agent_handle_t handle
 esp_err_t esp_agent_message_audio_stream_end_handler(esp_agent_handle_t handle, cJSON *content, cJSON *metadata);
 esp_err_t esp_agent_message_tool_request_handler(esp_agent_handle_t handle, cJSON *content, cJSON *metadata);
 esp_err_t esp_agent_message_thinking_handler(esp_agent_handle_t handle, cJSON *content, cJSON *metadata);
+esp_err_t esp_agent_message_transaction_end_handler(esp_agent_handle_t handle, cJSON *content, cJSON *metadata);
+esp_err_t esp_agent_message_barge_in_handler(esp_agent_handle_t handle, cJSON *content, cJSON *metadata);
 
 const esp_agent_message_handler_info_t esp_agent_message_handlers[] = {
     {.type = ESP_AGENT_MESSAGE_TYPE_HANDSHAKE_ACK, .handler = esp_agent_message_handshake_ack_handler},
@@ -35,11 +38,72 @@ const esp_agent_message_handler_info_t esp_agent_message_handlers[] = {
     {.type = ESP_AGENT_MESSAGE_TYPE_TOOL_CALL_INFO, .handler = esp_agent_message_dummy_handler},
     {.type = ESP_AGENT_MESSAGE_TYPE_TOOL_REQUEST, .handler = esp_agent_message_tool_request_handler},
     {.type = ESP_AGENT_MESSAGE_TYPE_TOOL_RESULT_INFO, .handler = esp_agent_message_dummy_handler},
-    {.type = ESP_AGENT_MESSAGE_TYPE_TRANSACTION_END, .handler = esp_agent_message_dummy_handler},
-    {.type = ESP_AGENT_MESSAGE_TYPE_BARGE_IN, .handler = esp_agent_message_dummy_handler}
+    {.type = ESP_AGENT_MESSAGE_TYPE_TRANSACTION_END, .handler = esp_agent_message_transaction_end_handler},
+    {.type = ESP_AGENT_MESSAGE_TYPE_BARGE_IN, .handler = esp_agent_message_barge_in_handler}
 };
 const size_t esp_agent_message_handlers_count = sizeof(esp_agent_message_handlers) / sizeof(esp_agent_message_handler_info_t);
 
+static bool audio_sample_rate_is_valid(double sample_rate)
+{
+    static const uint32_t rates[] = {8000, 12000, 16000, 24000, 48000};
+    for (size_t i = 0; i < sizeof(rates) / sizeof(rates[0]); i++) {
+        if (sample_rate == rates[i]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool audio_frame_duration_is_valid(uint32_t duration_us)
+{
+    static const uint32_t durations_us[] = {2500, 5000, 10000, 20000, 40000, 60000, 80000, 100000, 120000};
+    for (size_t i = 0; i < sizeof(durations_us) / sizeof(durations_us[0]); i++) {
+        if (duration_us == durations_us[i]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Take the server's choice for one direction, returns true if the config changed */
+static bool handshake_apply_audio_config(cJSON *config, esp_agent_audio_config_t *audio_config, const char *direction)
+{
+    if (!cJSON_IsObject(config)) {
+        return false;
+    }
+
+    bool changed = false;
+    cJSON *sample_rate = cJSON_GetObjectItemCaseSensitive(config, "sampleRate");
+    if (cJSON_IsNumber(sample_rate) && sample_rate->valuedouble != audio_config->sample_rate) {
+        if (audio_sample_rate_is_valid(sample_rate->valuedouble)) {
+            audio_config->sample_rate = (uint16_t)sample_rate->valuedouble;
+            changed = true;
+        } else {
+            ESP_LOGW(TAG, "Ignoring unsupported %s sample rate: %g", direction, sample_rate->valuedouble);
+        }
+    }
+
+    cJSON *frame_duration = cJSON_GetObjectItemCaseSensitive(config, "frameDurationMs");
+    if (cJSON_IsNumber(frame_duration)) {
+        uint32_t duration_us = (uint32_t)(frame_duration->valuedouble * 1000 + 0.5);
+        if (duration_us != esp_agent_audio_frame_duration_us(audio_config)) {
+            if (audio_frame_duration_is_valid(duration_us)) {
+                audio_config->frame_duration_us = duration_us;
+                audio_config->frame_duration = duration_us / 1000;
+                changed = true;
+            } else {
+                ESP_LOGW(TAG, "Ignoring unsupported %s frame duration: %g ms", direction, frame_duration->valuedouble);
+            }
+        }
+    }
+
+    if (changed) {
+        ESP_LOGI(TAG, "Server chose %s audio: %d Hz, %" PRIu32 " us frames", direction,
+                 audio_config->sample_rate, esp_agent_audio_frame_duration_us(audio_config));
+    }
+    return changed;
+}
+
 esp_err_t esp_agent_message_handshake_ack_handler(esp_agent_handle_t handle, cJSON *content, cJSON *metadata)
 {
     if (handle == NULL || content == NULL) {
@@ -74,6 +138,22 @@ esp_err_t esp_agent_message_handshake_ack_handler(esp_agent_handle_t handle, cJS
         return ESP_ERR_NO_MEM;
     }
 
+    /* The server may settle on a different audio configuration than the one requested */
+    cJSON *audio_configuration = cJSON_GetObjectItemCaseSensitive(content, "audioConfiguration");
+    if (agent->conversation_type == ESP_AGENT_CONVERSATION_SPEECH && audio_configuration) {
+        bool upload_changed = handshake_apply_audio_config(cJSON_GetObjectItemCaseSensitive(audio_configuration, "input"),
+                                                           &agent->upload_audio_config, "upload");
+        bool download_changed = handshake_apply_audio_config(cJSON_GetObjectItemCaseSensitive(audio_configuration, "output"),
+                                                             &agent->download_audio_config, "download");
+        if (upload_changed || download_changed) {
+            esp_agent_message_data_t config_data;
+            config_data.audio_config.upload = agent->upload_audio_config;
+            config_data.audio_config.download = agent->download_audio_config;
+            /* Posted before START, so the audio path is reconfigured before the conversation begins */
+            esp_agent_post_event(handle, ESP_AGENT_EVENT_AUDIO_CONFIG_CHANGED, &config_data);
+        }
+    }
+
     esp_agent_message_data_t event_data;
     event_data.start.conversation_id = strdup(conv_id);
 
@@ -116,31 +196,53 @@ esp_err_t esp_agent_message_transcript_handler(esp_agent_handle_t handle, cJSON
     cJSON *generation_stage = cJSON_GetObjectItemCaseSensitive(metadata, "generation_stage");
     char *generation_stage_str = cJSON_GetStringValue(generation_stage);
 
-    esp_agent_message_data_t event_data;
-    event_data.text.text = strdup(content_str);
-    event_data.text.generation_stage = ESP_AGENT_MESSAGE_GENERATION_STAGE_UNKNOWN;
+    esp_agent_message_role_t role_type;
+    esp_agent_message_generation_stage_t stage = ESP_AGENT_MESSAGE_GENERATION_STAGE_UNKNOWN;
 
     if (strcmp(role_str, "user") == 0) {
-        event_data.text.role = ESP_AGENT_MESSAGE_ROLE_USER;
+        role_type = ESP_AGENT_MESSAGE_ROLE_USER;
     } else if (strcmp(role_str, "assistant") == 0) {
-        event_data.text.role = ESP_AGENT_MESSAGE_ROLE_ASSISTANT;
+        role_type = ESP_AGENT_MESSAGE_ROLE_ASSISTANT;
 
         if (!generation_stage_str) {
-            event_data.text.generation_stage = ESP_AGENT_MESSAGE_GENERATION_STAGE_UNKNOWN;
+            stage = ESP_AGENT_MESSAGE_GENERATION_STAGE_UNKNOWN;
         } else if (strcmp(generation_stage_str, "speculative") == 0) {
-            event_data.text.generation_stage = ESP_AGENT_MESSAGE_GENERATION_STAGE_SPECULATIVE;
+            stage = ESP_AGENT_MESSAGE_GENERATION_STAGE_SPECULATIVE;
         } else if (strcmp(generation_stage_str, "final") == 0) {
-            event_data.text.generation_stage = ESP_AGENT_MESSAGE_GENERATION_STAGE_FINAL;
+            stage = ESP_AGENT_MESSAGE_GENERATION_STAGE_FINAL;
         }
+    } else {
+        ESP_LOGE(TAG, "Unknown transcript role: %s", role_str);
+        return ESP_FAIL;
     }
 
+    return esp_agent_transcript_submit(handle, role_type, stage, content_str);
+}
 
-    esp_err_t err = esp_agent_post_event(handle, ESP_AGENT_EVENT_DATA_TYPE_TEXT, &event_data);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to post text event: 0x%x", err);
-        free((char *)event_data.text.text);
+esp_err_t esp_agent_message_transaction_end_handler(esp_agent_handle_t handle, cJSON *content, cJSON *metadata)
+{
+    if (handle == NULL) {
+        ESP_LOGE(TAG, "Invalid handle for processing transaction end");
+        return ESP_ERR_INVALID_ARG;
     }
-    return err;
+
+    /* Do not hold back the last speculative text of the turn */
+    esp_agent_transcript_flush(handle);
+    esp_agent_tools_cancel_all(handle, "end of turn");
+    return ESP_OK;
+}
+
+esp_err_t esp_agent_message_barge_in_handler(esp_agent_handle_t handle, cJSON *content, cJSON *metadata)
+{
+    if (handle == NULL) {
+        ESP_LOGE(TAG, "Invalid handle for processing barge in");
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    esp_agent_tools_cancel_all(handle, "barge-in");
+    /* The user talked over the response, the application stops playing it */
+    esp_agent_post_event(handle, ESP_AGENT_EVENT_BARGE_IN, NULL);
+    return ESP_OK;
 }
 
 esp_err_t esp_agent_message_thinking_handler(esp_agent_handle_t handle, cJSON *content, cJSON *metadata)
@@ -245,66 +347,16 @@ esp_err_t esp_agent_message_tool_request_handler(esp_agent_handle_t handle, cJSO
         return ESP_FAIL;
     }
 
-    esp_agent_tool_param_t *parameters = NULL;
-    size_t num_parameters = 0;
-
-    num_parameters = cJSON_GetArraySize(input);
-    if (num_parameters == 0) {
-        ESP_LOGD(TAG, "No parameters found for tool: %s", tool_name);
-        goto no_parameters;
-    }
-
-    parameters = (esp_agent_tool_param_t *)calloc(num_parameters, sizeof(esp_agent_tool_param_t));
-    if (!parameters) {
-        ESP_LOGE(TAG, "Failed to allocate memory for parameters");
-        return ESP_ERR_NO_MEM;
-    }
-
-    for (size_t i = 0; i < num_parameters; i++) {
-        cJSON *curr_element = cJSON_GetArrayItem(input, i);
-        char *name = strdup(curr_element->string);
-        ESP_LOGD(TAG, "Got Parameter: %s", name);
-        parameters[i].name = name;
-        cJSON *value = cJSON_GetObjectItemCaseSensitive(input, name);
-        if (cJSON_IsString(value)) {
-            parameters[i].type = ESP_AGENT_PARAM_TYPE_STRING;
-            parameters[i].value.s = strdup(cJSON_GetStringValue(value));
-        } else if (cJSON_IsNumber(value)) {
-            parameters[i].type = ESP_AGENT_PARAM_TYPE_NUMBER;
-            parameters[i].value.i = cJSON_GetNumberValue(value);
-        } else if (cJSON_IsBool(value)) {
-            parameters[i].type = ESP_AGENT_PARAM_TYPE_BOOL;
-            parameters[i].value.b = cJSON_IsTrue(value);
-        } else {
-            ESP_LOGE(TAG, "Invalid parameter value type");
-            goto err;
-        }
-    }
-
-no_parameters:
     char *input_str = cJSON_PrintUnformatted(input);
     ESP_LOGI(TAG, "Executing tool: %s: %s", tool_name, input_str);
     free(input_str);
 
-    esp_err_t err = esp_agent_execute_tool(handle, request_id, tool_name, parameters, num_parameters);
+    /* The call keeps the input, so that the handler parameters can point into it without copies.
+     * Invalid calls are answered with an error tool response by esp_agent_execute_tool. */
+    cJSON_DetachItemViaPointer(content, input);
+    esp_err_t err = esp_agent_execute_tool(handle, request_id, tool_name, input);
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "Failed to execute tool: 0x%x", err);
-        goto err;
     }
-
-    return ESP_OK;
-
-err:
-    if (parameters) {
-        for (size_t i = 0; i < num_parameters; i++) {
-            if (parameters[i].name) {
-                free((char *)parameters[i].name);
-            }
-            if (parameters[i].type == ESP_AGENT_PARAM_TYPE_STRING && parameters[i].value.s) {
-                free((char *)parameters[i].value.s);
-            }
-        }
-        free(parameters);
-    }
-    return ESP_FAIL;
+    return err;
 }
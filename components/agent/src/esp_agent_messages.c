@@ -13,6 +13,7 @@
 #include <cJSON.h>
 
 #include <esp_agent_internal_messages.h>
+#include <esp_agent_internal_tools.h>
 #include <esp_agent_websocket.h>
 
 extern const esp_agent_message_handler_info_t esp_agent_message_handlers[];
@@ -100,8 +101,8 @@ static cJSON *esp_agent_messages_get_audio_configuration(esp_agent_handle_t hand
 
     ESP_GOTO_ON_FALSE(agent->upload_audio_config.sample_rate != 0, ESP_ERR_INVALID_ARG, err, TAG, "Invalid input sample rate");
     ESP_GOTO_ON_FALSE(agent->download_audio_config.sample_rate != 0, ESP_ERR_INVALID_ARG, err, TAG, "Invalid output sample rate");
-    ESP_GOTO_ON_FALSE(agent->upload_audio_config.frame_duration != 0, ESP_ERR_INVALID_ARG, err, TAG, "Invalid input frame duration");
-    ESP_GOTO_ON_FALSE(agent->download_audio_config.frame_duration != 0, ESP_ERR_INVALID_ARG, err, TAG, "Invalid output frame duration");
+    ESP_GOTO_ON_FALSE(esp_agent_audio_frame_duration_us(&agent->upload_audio_config) != 0, ESP_ERR_INVALID_ARG, err, TAG, "Invalid input frame duration");
+    ESP_GOTO_ON_FALSE(esp_agent_audio_frame_duration_us(&agent->download_audio_config) != 0, ESP_ERR_INVALID_ARG, err, TAG, "Invalid output frame duration");
 
     ESP_GOTO_ON_FALSE(input_format_string, ESP_ERR_NO_MEM, err, TAG, "Failed to get input format string");
     ESP_GOTO_ON_FALSE(output_format_string, ESP_ERR_NO_MEM, err, TAG, "Failed to get output format string");
@@ -111,12 +112,12 @@ static cJSON *esp_agent_messages_get_audio_configuration(esp_agent_handle_t hand
 
     cJSON_AddStringToObject(audio_input_config, "format", input_format_string);
     cJSON_AddNumberToObject(audio_input_config, "sampleRate", agent->upload_audio_config.sample_rate);
-    cJSON_AddNumberToObject(audio_input_config, "frameDurationMs", agent->upload_audio_config.frame_duration);
+    cJSON_AddNumberToObject(audio_input_config, "frameDurationMs", esp_agent_audio_frame_duration_us(&agent->upload_audio_config) / 1000.0);
     cJSON_AddItemToObject(audio_configuration, "input", audio_input_config);
 
     cJSON_AddStringToObject(audio_output_config, "format", output_format_string);
     cJSON_AddNumberToObject(audio_output_config, "sampleRate", agent->download_audio_config.sample_rate);
-    cJSON_AddNumberToObject(audio_output_config, "frameDurationMs", agent->download_audio_config.frame_duration);
+    cJSON_AddNumberToObject(audio_output_config, "frameDurationMs", esp_agent_audio_frame_duration_us(&agent->download_audio_config) / 1000.0);
     cJSON_AddItemToObject(audio_configuration, "output", audio_output_config);
 
     /* For keping the compiler happy about not using variable ret */
@@ -259,7 +260,9 @@ char *esp_agent_messages_prepare_tool_response(esp_agent_handle_t handle, char *
     cJSON_AddItemToObject(content, "result", result);
     cJSON_AddItemToObject(tool_response_json, "content", content);
 
-    return cJSON_PrintUnformatted(tool_response_json);
+    char *tool_response_str = cJSON_PrintUnformatted(tool_response_json);
+    cJSON_Delete(tool_response_json);
+    return tool_response_str;
 
     /* To prevent unused variable warning */
     if (0) {
@@ -363,6 +366,51 @@ only_delete_final_json:
     return ret_json_str;
 }
 
+char *esp_agent_messages_prepare_barge_in(esp_agent_handle_t handle)
+{
+    esp_err_t ret = ESP_OK;
+    cJSON *final_json = cJSON_CreateObject();
+    cJSON *metadata = cJSON_CreateObject();
+    cJSON *content = cJSON_CreateObject();
+
+    char *ret_json_str = NULL;
+
+    /* GOTO to delete_content_n_metadata if any of the JSON objects are not created */
+    ESP_GOTO_ON_FALSE(final_json, ESP_ERR_NO_MEM, delete_all_json_objects, TAG, "Failed to create final JSON");
+    ESP_GOTO_ON_FALSE(metadata, ESP_ERR_NO_MEM, delete_all_json_objects, TAG, "Failed to create metadata JSON");
+    ESP_GOTO_ON_FALSE(content, ESP_ERR_NO_MEM, delete_all_json_objects, TAG, "Failed to create content JSON");
+
+    cJSON_AddStringToObject(metadata, "role", "user");
+
+    cJSON_AddStringToObject(final_json, "type", ESP_AGENT_MESSAGE_TYPE_BARGE_IN);
+    cJSON_AddStringToObject(final_json, "content_type", "json");
+    cJSON_AddItemToObject(final_json, "metadata", metadata);
+    cJSON_AddItemToObject(final_json, "content", content);
+
+    ret_json_str = cJSON_PrintUnformatted(final_json);
+
+    /* For keping the compiler happy about not using variable ret */
+    /* Will be optimized away */
+    if (ret) {}
+
+    /* final_json has ownership of content and metadata*/
+    goto only_delete_final_json;
+
+delete_all_json_objects:
+    if (metadata) {
+        cJSON_Delete(metadata);
+    }
+    if (content) {
+        cJSON_Delete(content);
+    }
+only_delete_final_json:
+    if (final_json) {
+        cJSON_Delete(final_json);
+    }
+
+    return ret_json_str;
+}
+
 esp_err_t esp_agent_speech_conversation_start(esp_agent_handle_t handle)
 {
     if (handle == NULL) {
@@ -434,6 +482,37 @@ end:
     return err;
 }
 
+esp_err_t esp_agent_send_barge_in(esp_agent_handle_t handle)
+{
+    if (handle == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    esp_agent_t *agent = (esp_agent_t *)handle;
+    if (agent->conversation_type != ESP_AGENT_CONVERSATION_SPEECH) {
+        ESP_LOGE(TAG, "Conversation type is not speech");
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    /* Pending tool calls belong to the interrupted response */
+    esp_agent_tools_cancel_all(agent, "barge-in");
+
+    char *barge_in_json_str = esp_agent_messages_prepare_barge_in(agent);
+    if (barge_in_json_str == NULL) {
+        ESP_LOGE(TAG, "Failed to prepare barge in");
+        return ESP_ERR_NO_MEM;
+    }
+    ESP_LOGD(TAG, "Barge in: %s", barge_in_json_str);
+
+    esp_err_t err = esp_agent_websocket_queue_message(agent, WS_SEND_MSG_TYPE_TEXT, barge_in_json_str, strlen(barge_in_json_str), pdMS_TO_TICKS(100));
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to queue barge in: %d", err);
+    }
+
+    free(barge_in_json_str);
+    return err;
+}
+
 /* Send speech data */
 esp_err_t esp_agent_send_speech(esp_agent_handle_t handle, const uint8_t *data, size_t len, TickType_t timeout)
 {
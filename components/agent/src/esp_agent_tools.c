@@ -6,12 +6,16 @@
 
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
 
 #include <string.h>
 #include <stdlib.h>
+#include <inttypes.h>
 
 #include <esp_log.h>
 #include <esp_check.h>
+#include <esp_timer.h>
 
 #include <esp_agent.h>
 #include <esp_agent_internal_tools.h>
@@ -20,122 +24,1091 @@
 
 static const char *TAG = "esp_agent_tools";
 
+#define TOOL_WORKER_PRIORITY 5
+#define TOOL_WORKER_EXIT_WAIT_MS 2000
+#define TOOL_RESPONSE_QUEUE_TIMEOUT_MS 5000
+#define TOOL_STREAM_FRAGMENT_SIZE 1024
+
+/* Handler flavors of a tool, exactly one is set */
 typedef struct {
+    esp_agent_tool_handler_t sync;
+    esp_agent_async_tool_handler_t async;
+    esp_agent_stream_tool_handler_t stream;
+} tool_handlers_t;
+
+/* Result writer of a streaming tool call. The response is written into fragment-sized pieces,
+ * handed to the send task as one fragmented message when the handler returns. The connection
+ * stays free for other messages while the handler runs, and no contiguous copy is made. */
+struct esp_agent_tool_writer {
+    esp_agent_t *agent;
+    esp_agent_tool_call_t *call;
+    ws_send_fragment_t *head;
+    ws_send_fragment_t *tail;           /* Piece being filled */
+    bool no_mem;                        /* A piece could not be allocated */
+    bool discard;                       /* Call cancelled or out of memory, drop everything */
+};
+
+struct esp_agent_tool_call {
     char *request_id;
     char *tool_name;
+    uint32_t tool_registration;         /* Registration of the tool the call was counted against */
     esp_agent_tool_param_t *parameters;
     size_t num_parameters;
     esp_agent_tool_handler_t tool_handler;
+    esp_agent_async_tool_handler_t async_handler;
+    esp_agent_stream_tool_handler_t stream_handler;
     void *user_data;
     esp_agent_handle_t handle;
-} tool_request_t;
+    int64_t enqueue_time_us;
+    cJSON *input;                       /* Detached request input, parameters are views into it */
+    bool cacheable;                     /* Store a successful result in the tool cache */
+    uint64_t cache_key;
+    uint32_t cache_generation;
+    int64_t deadline_us;                /* esp_timer time after which the call times out, 0 for none */
+    volatile bool cancelled;            /* Set on timeout, barge-in, end of turn or disconnect */
+    bool answered;                      /* A response was sent or must no longer be sent */
+    TaskHandle_t worker;                /* Worker running the call, NULL while queued */
+    uint8_t refs;                       /* Async calls: held by the worker and by the pending completion */
+    bool completed;                     /* Async calls: esp_agent_tool_complete() was called */
+    struct esp_agent_tool_call *next;   /* Next call in the active list */
+};
 
-static void execute_tool_task(void *pvParameters)
+static void free_tool_request(esp_agent_tool_call_t *request)
 {
-    tool_request_t *request = (tool_request_t *)pvParameters;
-    if (request == NULL) {
-        ESP_LOGE(TAG, "Invalid request");
-        vTaskDelete(NULL);
-        return;
+    free(request->request_id);
+    free(request->tool_name);
+    free(request->parameters);
+    cJSON_Delete(request->input);
+    free(request);
+}
+
+/* FNV-1a */
+static uint32_t tool_name_hash(const char *name)
+{
+    uint32_t hash = 2166136261u;
+    while (*name) {
+        hash ^= (uint8_t)*name++;
+        hash *= 16777619u;
     }
+    return hash;
+}
 
-    esp_agent_t *agent = (esp_agent_t *)request->handle;
-    char *tool_result = NULL;
-    ESP_LOGD(TAG, "Executing tool: %s", request->tool_name);
-    esp_err_t err = request->tool_handler(agent, request->tool_name, request->parameters, request->num_parameters, request->user_data, &tool_result);
+static void free_tool_node(local_tool_node_t *tool_node)
+{
+    if (tool_node->cache) {
+        for (int i = 0; i < ESP_AGENT_TOOL_CACHE_ENTRIES; i++) {
+            free(tool_node->cache[i].result);
+        }
+        free(tool_node->cache);
+    }
+    free(tool_node->name);
+    free(tool_node);
+}
+
+/* Must be called with the pool lock held */
+static local_tool_node_t *find_tool(esp_agent_t *agent, const char *name)
+{
+    uint32_t hash = tool_name_hash(name);
+    local_tool_node_t *tool_node = agent->local_tools[hash & (ESP_AGENT_TOOL_HASH_BUCKETS - 1)];
+    while (tool_node != NULL) {
+        if (tool_node->hash == hash && strcmp(tool_node->name, name) == 0) {
+            return tool_node;
+        }
+        tool_node = tool_node->next;
+    }
+    return NULL;
+}
+
+static const char *param_type_name(esp_agent_tool_param_type_t type)
+{
+    switch (type) {
+    case ESP_AGENT_PARAM_TYPE_NUMBER:
+        return "number";
+    case ESP_AGENT_PARAM_TYPE_STRING:
+        return "string";
+    case ESP_AGENT_PARAM_TYPE_BOOL:
+        return "bool";
+    case ESP_AGENT_PARAM_TYPE_OBJECT:
+        return "object";
+    case ESP_AGENT_PARAM_TYPE_ARRAY:
+        return "array";
+    default:
+        return "unknown";
+    }
+}
+
+/* Fill a parameter with a view of a JSON value, nothing is copied */
+static void fill_param_view(const cJSON *value, esp_agent_tool_param_t *param)
+{
+    if (cJSON_IsString(value)) {
+        param->type = ESP_AGENT_PARAM_TYPE_STRING;
+        param->value.s = value->valuestring;
+    } else if (cJSON_IsNumber(value)) {
+        param->type = ESP_AGENT_PARAM_TYPE_NUMBER;
+        param->value.i = value->valuedouble;
+    } else if (cJSON_IsBool(value)) {
+        param->type = ESP_AGENT_PARAM_TYPE_BOOL;
+        param->value.b = cJSON_IsTrue(value);
+    } else if (cJSON_IsObject(value)) {
+        param->type = ESP_AGENT_PARAM_TYPE_OBJECT;
+        param->value.node = value;
+    } else if (cJSON_IsArray(value)) {
+        param->type = ESP_AGENT_PARAM_TYPE_ARRAY;
+        param->value.node = value;
+    } else {
+        param->type = ESP_AGENT_PARAM_TYPE_NONE;
+    }
+}
+
+/* Fill a parameter from a JSON value of the expected type, or any type if type is MAX */
+static esp_err_t parse_param_value(const cJSON *value, esp_agent_tool_param_type_t type, esp_agent_tool_param_t *param)
+{
+    fill_param_view(value, param);
+    if (type != ESP_AGENT_PARAM_TYPE_MAX && param->type != type) {
+        param->type = ESP_AGENT_PARAM_TYPE_NONE;
+        return ESP_ERR_INVALID_ARG;
+    }
+    return ESP_OK;
+}
+
+/* Build the handler parameters from the request input. On failure, err_msg explains why. */
+static esp_err_t build_tool_parameters(const local_tool_node_t *tool_node, const cJSON *input, esp_agent_tool_call_t *request,
+                                       char *err_msg, size_t err_msg_len)
+{
+    esp_err_t err = ESP_OK;
+    size_t num_parameters = tool_node->params ? tool_node->num_params : (size_t)cJSON_GetArraySize(input);
+    if (num_parameters == 0) {
+        ESP_LOGD(TAG, "No parameters found for tool: %s", tool_node->name);
+        return ESP_OK;
+    }
+
+    esp_agent_tool_param_t *parameters = calloc(num_parameters, sizeof(esp_agent_tool_param_t));
+    if (parameters == NULL) {
+        snprintf(err_msg, err_msg_len, "Out of memory");
+        return ESP_ERR_NO_MEM;
+    }
+
+    if (tool_node->params) {
+        /* Deliver in declared order, so handlers can index the slots directly */
+        for (size_t i = 0; i < num_parameters; i++) {
+            const esp_agent_tool_param_schema_t *schema = &tool_node->params[i];
+            const cJSON *value = cJSON_GetObjectItemCaseSensitive(input, schema->name);
+            parameters[i].name = schema->name;
+            parameters[i].type = ESP_AGENT_PARAM_TYPE_NONE;
+            if (value == NULL || cJSON_IsNull(value)) {
+                if (schema->required) {
+                    snprintf(err_msg, err_msg_len, "Missing required parameter '%s'", schema->name);
+                    err = ESP_ERR_INVALID_ARG;
+                    break;
+                }
+                continue;
+            }
+            err = parse_param_value(value, schema->type, &parameters[i]);
+            if (err != ESP_OK) {
+                snprintf(err_msg, err_msg_len, "Parameter '%s' must be a %s", schema->name, param_type_name(schema->type));
+                break;
+            }
+        }
+    } else {
+        size_t i = 0;
+        const cJSON *value = NULL;
+        cJSON_ArrayForEach(value, input) {
+            ESP_LOGD(TAG, "Got Parameter: %s", value->string);
+            parameters[i].name = value->string;
+            parse_param_value(value, ESP_AGENT_PARAM_TYPE_MAX, &parameters[i]);
+            i++;
+        }
+    }
+
+    request->parameters = parameters;
+    request->num_parameters = num_parameters;
     if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to execute tool: 0x%x", err);
+        ESP_LOGE(TAG, "Invalid call to %s: %s", tool_node->name, err_msg);
+    }
+    return err;
+}
+
+/* FNV-1a, 64-bit */
+static uint64_t cache_hash_bytes(uint64_t hash, const void *data, size_t len)
+{
+    const uint8_t *bytes = (const uint8_t *)data;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+#define CACHE_HASH_INIT 14695981039346656037ull
+#define CACHE_HASH_MAX_DEPTH 8
+
+/* Mix before summing, so that sums stay order independent without cancelling out */
+static uint64_t cache_hash_mix(uint64_t hash)
+{
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdull;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+/* Hash a parameter value. Object members are hashed independently of their order. */
+static bool cache_hash_param(uint64_t *hash, const esp_agent_tool_param_t *param, int depth)
+{
+    uint8_t type = (uint8_t)param->type;
+    *hash = cache_hash_bytes(*hash, &type, sizeof(type));
+
+    switch (param->type) {
+    case ESP_AGENT_PARAM_TYPE_STRING:
+        *hash = cache_hash_bytes(*hash, param->value.s, strlen(param->value.s) + 1);
+        break;
+    case ESP_AGENT_PARAM_TYPE_NUMBER: {
+        double number = param->value.i == 0 ? 0 : param->value.i;   /* -0 and 0 are the same call */
+        *hash = cache_hash_bytes(*hash, &number, sizeof(number));
+        break;
+    }
+    case ESP_AGENT_PARAM_TYPE_BOOL: {
+        uint8_t b = param->value.b;
+        *hash = cache_hash_bytes(*hash, &b, sizeof(b));
+        break;
+    }
+    case ESP_AGENT_PARAM_TYPE_OBJECT:
+    case ESP_AGENT_PARAM_TYPE_ARRAY: {
+        if (depth >= CACHE_HASH_MAX_DEPTH) {
+            return false;
+        }
+        uint64_t sum = 0;
+        esp_agent_tool_param_iter_t iter;
+        esp_agent_tool_param_t item;
+        esp_agent_tool_param_iter_init(&iter, param);
+        while (esp_agent_tool_param_iter_next(&iter, &item)) {
+            if (param->type == ESP_AGENT_PARAM_TYPE_ARRAY) {
+                if (!cache_hash_param(hash, &item, depth + 1)) {
+                    return false;
+                }
+                continue;
+            }
+            uint64_t member = cache_hash_bytes(CACHE_HASH_INIT, item.name, strlen(item.name) + 1);
+            if (!cache_hash_param(&member, &item, depth + 1)) {
+                return false;
+            }
+            sum += cache_hash_mix(member);
+        }
+        *hash = cache_hash_bytes(*hash, &sum, sizeof(sum));
+        break;
+    }
+    default:
+        break;
+    }
+    return true;
+}
+
+/* Hash the parameters so that the order the server sent them in does not matter.
+ * Returns false for inputs nested too deeply to be worth caching. */
+static bool tool_cache_key(const esp_agent_tool_param_t *params, size_t num_params, uint64_t *key)
+{
+    *key = 0;
+    for (size_t i = 0; i < num_params; i++) {
+        const esp_agent_tool_param_t *param = &params[i];
+        if (param->type == ESP_AGENT_PARAM_TYPE_NONE) {
+            continue;
+        }
+        uint64_t hash = cache_hash_bytes(CACHE_HASH_INIT, param->name, strlen(param->name) + 1);
+        if (!cache_hash_param(&hash, param, 0)) {
+            return false;
+        }
+        *key += cache_hash_mix(hash);
+    }
+    return true;
+}
+
+/* Must be called with the pool lock held. Returns a copy of the cached result or NULL. */
+static char *tool_cache_lookup(const local_tool_node_t *tool_node, uint64_t key)
+{
+    int64_t now = esp_timer_get_time();
+    for (int i = 0; i < ESP_AGENT_TOOL_CACHE_ENTRIES; i++) {
+        const esp_agent_tool_cache_entry_t *entry = &tool_node->cache[i];
+        if (entry->result && entry->key == key && entry->expires_us > now) {
+            return strdup(entry->result);
+        }
+    }
+    return NULL;
+}
+
+/* Must be called with the pool lock held. Takes ownership of result. */
+static void tool_cache_store(local_tool_node_t *tool_node, uint64_t key, char *result)
+{
+    esp_agent_tool_cache_entry_t *victim = &tool_node->cache[0];
+    for (int i = 0; i < ESP_AGENT_TOOL_CACHE_ENTRIES; i++) {
+        esp_agent_tool_cache_entry_t *entry = &tool_node->cache[i];
+        if (entry->result && entry->key == key) {
+            victim = entry;
+            break;
+        }
+        /* Prefer an unused entry, then the one closest to expiry */
+        if (victim->result && (entry->result == NULL || entry->expires_us < victim->expires_us)) {
+            victim = entry;
+        }
+    }
+    free(victim->result);
+    victim->key = key;
+    victim->result = result;
+    victim->expires_us = esp_timer_get_time() + (int64_t)tool_node->cache_ttl_ms * 1000;
+}
+
+/* Must be called with the pool lock held */
+static void tool_cache_clear(esp_agent_t *agent, local_tool_node_t *tool_node)
+{
+    if (tool_node->cache == NULL) {
+        return;
+    }
+    for (int i = 0; i < ESP_AGENT_TOOL_CACHE_ENTRIES; i++) {
+        free(tool_node->cache[i].result);
+        tool_node->cache[i].result = NULL;
     }
-    char *tool_response_json_str = esp_agent_messages_prepare_tool_response(agent, request->request_id, err, tool_result);
+    tool_node->cache_generation = ++agent->tool_pool.cache_generation;
+}
+
+static void send_tool_response(esp_agent_t *agent, const char *request_id, esp_err_t status, const char *tool_result)
+{
+    char *tool_response_json_str = esp_agent_messages_prepare_tool_response(agent, (char *)request_id, status, (char *)tool_result);
     if (tool_response_json_str == NULL) {
         ESP_LOGE(TAG, "Failed to prepare tool response");
-        goto end;
+        return;
     }
     ESP_LOGD(TAG, "Tool response: %s", tool_response_json_str);
 
-    esp_err_t queue_err = esp_agent_websocket_queue_message(agent, WS_SEND_MSG_TYPE_TEXT, tool_response_json_str, strlen(tool_response_json_str), portMAX_DELAY);
+    esp_err_t queue_err = esp_agent_websocket_queue_message(agent, WS_SEND_MSG_TYPE_TEXT, tool_response_json_str, strlen(tool_response_json_str), pdMS_TO_TICKS(TOOL_RESPONSE_QUEUE_TIMEOUT_MS));
     if (queue_err != ESP_OK) {
         ESP_LOGE(TAG, "Failed to queue tool response: %d", queue_err);
     }
     free(tool_response_json_str);
+}
 
-end:
-    if (request->request_id) {
-        free(request->request_id);
+/* Must be called with the pool lock held */
+static void unlink_active_call(esp_agent_tool_pool_t *pool, esp_agent_tool_call_t *request)
+{
+    for (esp_agent_tool_call_t **it = &pool->active; *it; it = &(*it)->next) {
+        if (*it == request) {
+            *it = request->next;
+            request->next = NULL;
+            return;
+        }
     }
-    if (request->tool_name) {
-        free(request->tool_name);
+}
+
+static void release_tool_slot(esp_agent_t *agent, esp_agent_tool_call_t *request)
+{
+    xSemaphoreTake(agent->tool_pool.lock, portMAX_DELAY);
+    unlink_active_call(&agent->tool_pool, request);
+    /* The tool may have been unregistered, or registered anew, while the call was in flight */
+    local_tool_node_t *tool_node = find_tool(agent, request->tool_name);
+    if (tool_node && tool_node->registration == request->tool_registration && tool_node->in_flight > 0) {
+        tool_node->in_flight--;
     }
-    if (request->parameters) {
-        for (size_t i = 0; i < request->num_parameters; i++) {
-            if (request->parameters[i].name) {
-                free((char *)request->parameters[i].name);
-            }
-            if (request->parameters[i].type == ESP_AGENT_PARAM_TYPE_STRING && request->parameters[i].value.s) {
-                free((char *)request->parameters[i].value.s);
-            }
+    xSemaphoreGive(agent->tool_pool.lock);
+}
+
+/* Claim the right to answer a call. Returns false if it timed out or was cancelled. */
+static bool claim_tool_response(esp_agent_t *agent, esp_agent_tool_call_t *request)
+{
+    xSemaphoreTake(agent->tool_pool.lock, portMAX_DELAY);
+    bool claimed = !request->answered && !request->cancelled;
+    request->answered = true;
+    xSemaphoreGive(agent->tool_pool.lock);
+    return claimed;
+}
+
+/* Drop a reference to an async call, freeing it with the last one */
+static void put_tool_call(esp_agent_t *agent, esp_agent_tool_call_t *request)
+{
+    xSemaphoreTake(agent->tool_pool.lock, portMAX_DELAY);
+    bool last = (--request->refs == 0);
+    xSemaphoreGive(agent->tool_pool.lock);
+    if (last) {
+        free_tool_request(request);
+    }
+}
+
+/* Send the result of a call unless it was cancelled, and cache it. Takes ownership of tool_result. */
+static void finish_tool_call(esp_agent_t *agent, esp_agent_tool_call_t *request, esp_err_t err, char *tool_result)
+{
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to execute tool: 0x%x", err);
+    }
+
+    if (!claim_tool_response(agent, request)) {
+        /* Nobody is waiting for this response any more, do not occupy the send queue with it */
+        ESP_LOGW(TAG, "Dropping response of cancelled tool call %s (%s)", request->tool_name, request->request_id);
+        free(tool_result);
+        return;
+    }
+    send_tool_response(agent, request->request_id, err, tool_result);
+
+    if (err == ESP_OK && tool_result && request->cacheable) {
+        xSemaphoreTake(agent->tool_pool.lock, portMAX_DELAY);
+        local_tool_node_t *tool_node = find_tool(agent, request->tool_name);
+        /* Skip results that may predate an invalidation */
+        if (tool_node && tool_node->cache && tool_node->cache_generation == request->cache_generation) {
+            tool_cache_store(tool_node, request->cache_key, tool_result);
+            tool_result = NULL;
         }
-        free(request->parameters);
+        xSemaphoreGive(agent->tool_pool.lock);
     }
+
     if (tool_result) {
         free(tool_result);
     }
-    free(request);
+}
+
+static void execute_tool_request(esp_agent_t *agent, esp_agent_tool_call_t *request)
+{
+    char *tool_result = NULL;
+    ESP_LOGD(TAG, "Executing tool: %s", request->tool_name);
+    esp_err_t err = request->tool_handler(agent, request->tool_name, request->parameters, request->num_parameters, request->user_data, &tool_result);
+    finish_tool_call(agent, request, err, tool_result);
+    release_tool_slot(agent, request);
+    free_tool_request(request);
+}
+
+static void start_async_tool_request(esp_agent_t *agent, esp_agent_tool_call_t *request)
+{
+    ESP_LOGD(TAG, "Starting async tool: %s", request->tool_name);
+    request->refs = 2;
+    esp_err_t err = request->async_handler(agent, request, request->tool_name, request->parameters, request->num_parameters, request->user_data);
+    if (err != ESP_OK) {
+        /* The handler declined the call and will not complete it */
+        esp_agent_tool_complete(request, err, NULL);
+    }
+
+    xSemaphoreTake(agent->tool_pool.lock, portMAX_DELAY);
+    request->worker = NULL;
+    xSemaphoreGive(agent->tool_pool.lock);
+    put_tool_call(agent, request);
+}
+
+static esp_err_t tool_writer_add_fragment(esp_agent_tool_writer_t *writer)
+{
+    ws_send_fragment_t *fragment = malloc(sizeof(ws_send_fragment_t) + TOOL_STREAM_FRAGMENT_SIZE);
+    if (fragment == NULL) {
+        ESP_LOGE(TAG, "Out of memory for the response of %s", writer->call->tool_name);
+        writer->no_mem = true;
+        writer->discard = true;
+        return ESP_ERR_NO_MEM;
+    }
+    fragment->next = NULL;
+    fragment->len = 0;
+    if (writer->tail) {
+        writer->tail->next = fragment;
+    } else {
+        writer->head = fragment;
+    }
+    writer->tail = fragment;
+    return ESP_OK;
+}
+
+static esp_err_t tool_writer_append(esp_agent_tool_writer_t *writer, const char *data, size_t len)
+{
+    while (len > 0) {
+        if (writer->tail == NULL || writer->tail->len == TOOL_STREAM_FRAGMENT_SIZE) {
+            ESP_RETURN_ON_ERROR(tool_writer_add_fragment(writer), TAG, "Tool response stream aborted");
+        }
+        size_t chunk = TOOL_STREAM_FRAGMENT_SIZE - writer->tail->len;
+        chunk = chunk < len ? chunk : len;
+        memcpy(writer->tail->data + writer->tail->len, data, chunk);
+        writer->tail->len += chunk;
+        data += chunk;
+        len -= chunk;
+    }
+    return ESP_OK;
+}
+
+/* Hand the written response to the send task */
+static esp_err_t tool_writer_queue(esp_agent_tool_writer_t *writer)
+{
+    ws_send_fragment_t *fragments = writer->head;
+    writer->head = NULL;
+    writer->tail = NULL;
+
+    if (fragments->next == NULL) {
+        /* Everything fit in one piece, send it as a regular message */
+        esp_err_t err = esp_agent_websocket_queue_message(writer->agent, WS_SEND_MSG_TYPE_TEXT, fragments->data, fragments->len,
+                                                          pdMS_TO_TICKS(TOOL_RESPONSE_QUEUE_TIMEOUT_MS));
+        esp_agent_websocket_free_fragments(fragments);
+        return err;
+    }
+    return esp_agent_websocket_queue_fragments(writer->agent, fragments, pdMS_TO_TICKS(TOOL_RESPONSE_QUEUE_TIMEOUT_MS));
+}
+
+/* Append data as the contents of a JSON string */
+static esp_err_t tool_writer_append_escaped(esp_agent_tool_writer_t *writer, const char *data, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = (unsigned char)data[i];
+        char escaped[7];
+        size_t escaped_len = 2;
+        escaped[0] = '\\';
+        switch (c) {
+        case '"':
+            escaped[1] = '"';
+            break;
+        case '\\':
+            escaped[1] = '\\';
+            break;
+        case '\n':
+            escaped[1] = 'n';
+            break;
+        case '\r':
+            escaped[1] = 'r';
+            break;
+        case '\t':
+            escaped[1] = 't';
+            break;
+        case '\b':
+            escaped[1] = 'b';
+            break;
+        case '\f':
+            escaped[1] = 'f';
+            break;
+        default:
+            if (c < 0x20) {
+                escaped_len = snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            } else {
+                escaped[0] = (char)c;
+                escaped_len = 1;
+            }
+            break;
+        }
+        ESP_RETURN_ON_ERROR(tool_writer_append(writer, escaped, escaped_len), TAG, "Tool response stream aborted");
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_agent_tool_writer_write(esp_agent_tool_writer_t *writer, const char *data, size_t len)
+{
+    if (writer == NULL || (data == NULL && len > 0)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (writer->discard) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (esp_agent_tool_call_is_cancelled(writer->call)) {
+        /* The response would be dropped, let the handler stop early */
+        writer->discard = true;
+        return ESP_ERR_INVALID_STATE;
+    }
+    return tool_writer_append_escaped(writer, data, len);
+}
+
+static void execute_stream_tool_request(esp_agent_t *agent, esp_agent_tool_call_t *request)
+{
+    esp_agent_tool_writer_t *writer = calloc(1, sizeof(esp_agent_tool_writer_t));
+    if (writer == NULL) {
+        ESP_LOGE(TAG, "Failed to allocate memory for tool response writer");
+        finish_tool_call(agent, request, ESP_ERR_NO_MEM, NULL);
+        release_tool_slot(agent, request);
+        free_tool_request(request);
+        return;
+    }
+    writer->agent = agent;
+    writer->call = request;
+
+    /* The result string comes first, so that the status can be appended once it is known */
+    static const char prefix[] = "{\"type\":\"" ESP_AGENT_MESSAGE_TYPE_TOOL_RESPONSE "\",\"content_type\":{\"type\":\"json\"},"
+                                 "\"content\":{\"request_id\":\"";
+    tool_writer_append(writer, prefix, sizeof(prefix) - 1);
+    tool_writer_append_escaped(writer, request->request_id, strlen(request->request_id));
+    tool_writer_append(writer, "\",\"result\":{\"result\":\"", strlen("\",\"result\":{\"result\":\""));
+
+    ESP_LOGD(TAG, "Executing streaming tool: %s", request->tool_name);
+    esp_err_t err = request->stream_handler(agent, request->tool_name, request->parameters, request->num_parameters,
+                                            request->user_data, writer);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to execute tool: 0x%x", err);
+    }
+
+    const char *suffix = err == ESP_OK ? "\",\"status\":\"success\"}}}" : "\",\"status\":\"error\"}}}";
+    if (!writer->discard) {
+        tool_writer_append(writer, suffix, strlen(suffix));
+    }
+
+    if (writer->discard && !writer->no_mem) {
+        /* Cancelled, the deadline check or the canceller answers the call if needed */
+        ESP_LOGW(TAG, "Dropping streamed response of cancelled tool call %s (%s)", request->tool_name, request->request_id);
+    } else if (!claim_tool_response(agent, request)) {
+        ESP_LOGW(TAG, "Dropping streamed response of cancelled tool call %s (%s)", request->tool_name, request->request_id);
+    } else if (writer->no_mem) {
+        send_tool_response(agent, request->request_id, ESP_ERR_NO_MEM, "Out of memory");
+    } else if (tool_writer_queue(writer) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to queue streamed response of %s", request->tool_name);
+    }
+
+    esp_agent_websocket_free_fragments(writer->head);
+    free(writer);
+    release_tool_slot(agent, request);
+    free_tool_request(request);
+}
+
+static void tool_worker_task(void *pvParameters)
+{
+    esp_agent_t *agent = (esp_agent_t *)pvParameters;
+    esp_agent_tool_call_t *request = NULL;
+
+    ESP_LOGD(TAG, "Tool worker started");
+
+    while (xQueueReceive(agent->tool_pool.queue, &request, portMAX_DELAY) == pdTRUE) {
+        if (request == NULL) {
+            /* Stop signal from esp_agent_tools_deinit */
+            break;
+        }
+
+        uint32_t wait_ms = (uint32_t)((esp_timer_get_time() - request->enqueue_time_us) / 1000);
+        xSemaphoreTake(agent->tool_pool.lock, portMAX_DELAY);
+        if (request->cancelled) {
+            xSemaphoreGive(agent->tool_pool.lock);
+            ESP_LOGD(TAG, "Skipping cancelled tool call %s", request->tool_name);
+            release_tool_slot(agent, request);
+            free_tool_request(request);
+            continue;
+        }
+        request->worker = xTaskGetCurrentTaskHandle();
+        agent->tool_pool.executed++;
+        agent->tool_pool.total_wait_ms += wait_ms;
+        if (wait_ms > agent->tool_pool.max_wait_ms) {
+            agent->tool_pool.max_wait_ms = wait_ms;
+        }
+        xSemaphoreGive(agent->tool_pool.lock);
+        ESP_LOGD(TAG, "Tool %s waited %" PRIu32 " ms for a worker", request->tool_name, wait_ms);
+
+        if (request->async_handler) {
+            start_async_tool_request(agent, request);
+        } else if (request->stream_handler) {
+            execute_stream_tool_request(agent, request);
+        } else {
+            execute_tool_request(agent, request);
+        }
+    }
+
+    ESP_LOGD(TAG, "Tool worker exiting");
     vTaskDelete(NULL);
 }
 
-esp_err_t esp_agent_execute_tool(esp_agent_handle_t handle, char *request_id, char *tool_name, esp_agent_tool_param_t *parameters, size_t num_parameters)
+esp_err_t esp_agent_tools_init(esp_agent_handle_t handle)
 {
-    if (handle == NULL || tool_name == NULL) {
+    if (handle == NULL) {
         return ESP_ERR_INVALID_ARG;
     }
 
     esp_agent_t *agent = (esp_agent_t *)handle;
-    local_tool_node_t *tool_node = agent->local_tools;
-    while (tool_node != NULL) {
-        if (strcmp(tool_node->name, tool_name) == 0) {
-            ESP_LOGD(TAG, "Found tool: %s", tool_name);
-            tool_request_t *request = malloc(sizeof(tool_request_t));
-            if (request == NULL) {
-                ESP_LOGE(TAG, "Failed to allocate memory for tool request");
-                return ESP_ERR_NO_MEM;
+    esp_agent_tool_pool_t *pool = &agent->tool_pool;
+
+    pool->lock = xSemaphoreCreateMutex();
+    ESP_RETURN_ON_FALSE(pool->lock, ESP_ERR_NO_MEM, TAG, "Failed to create tool pool lock");
+
+    pool->queue = xQueueCreate(CONFIG_ESP_AGENT_TOOL_QUEUE_SIZE, sizeof(esp_agent_tool_call_t *));
+    ESP_RETURN_ON_FALSE(pool->queue, ESP_ERR_NO_MEM, TAG, "Failed to create tool queue");
+
+    for (int i = 0; i < CONFIG_ESP_AGENT_TOOL_WORKER_COUNT; i++) {
+        BaseType_t ret = xTaskCreate(tool_worker_task, "agent_tool", CONFIG_ESP_AGENT_TOOL_WORKER_STACK_SIZE,
+                                     agent, TOOL_WORKER_PRIORITY, &pool->workers[i]);
+        ESP_RETURN_ON_FALSE(ret == pdPASS, ESP_ERR_NO_MEM, TAG, "Failed to create tool worker %d", i);
+    }
+
+    return ESP_OK;
+}
+
+void esp_agent_tools_deinit(esp_agent_handle_t handle)
+{
+    if (handle == NULL) {
+        return;
+    }
+
+    esp_agent_t *agent = (esp_agent_t *)handle;
+    esp_agent_tool_pool_t *pool = &agent->tool_pool;
+
+    if (pool->queue) {
+        esp_agent_tool_call_t *stop = NULL;
+        for (int i = 0; i < CONFIG_ESP_AGENT_TOOL_WORKER_COUNT; i++) {
+            if (pool->workers[i]) {
+                xQueueSend(pool->queue, &stop, pdMS_TO_TICKS(TOOL_WORKER_EXIT_WAIT_MS));
             }
-            request->request_id = strdup(request_id);
-            request->tool_name = strdup(tool_name);
-            request->parameters = parameters;
-            request->num_parameters = num_parameters;
-            request->tool_handler = tool_node->tool_handler;
-            request->user_data = tool_node->user_data;
-            request->handle = handle;
-
-            xTaskCreate(execute_tool_task, "execute_tool_task", 4096, request, 5, NULL);
-            return ESP_OK;
         }
-        tool_node = tool_node->next;
     }
-    ESP_LOGE(TAG, "Tool with name '%s' not found", tool_name);
-    return ESP_ERR_NOT_FOUND;
+
+    for (int i = 0; i < CONFIG_ESP_AGENT_TOOL_WORKER_COUNT; i++) {
+        if (!pool->workers[i]) {
+            continue;
+        }
+        TickType_t start_time = xTaskGetTickCount();
+        while (eTaskGetState(pool->workers[i]) != eDeleted &&
+               (xTaskGetTickCount() - start_time) < pdMS_TO_TICKS(TOOL_WORKER_EXIT_WAIT_MS)) {
+            vTaskDelay(pdMS_TO_TICKS(10));
+        }
+        if (eTaskGetState(pool->workers[i]) != eDeleted) {
+            ESP_LOGW(TAG, "Tool worker %d did not exit cleanly within timeout, forcefully deleting", i);
+            vTaskDelete(pool->workers[i]);
+        }
+        pool->workers[i] = NULL;
+    }
+
+    if (pool->queue) {
+        /* Purge calls that never reached a worker */
+        esp_agent_tool_call_t *request = NULL;
+        while (xQueueReceive(pool->queue, &request, 0) == pdTRUE) {
+            if (request) {
+                free_tool_request(request);
+            }
+        }
+        vQueueDelete(pool->queue);
+        pool->queue = NULL;
+    }
+    pool->active = NULL;
+
+    for (int i = 0; i < ESP_AGENT_TOOL_HASH_BUCKETS; i++) {
+        local_tool_node_t *tool_node = agent->local_tools[i];
+        while (tool_node != NULL) {
+            local_tool_node_t *next_node = tool_node->next;
+            free_tool_node(tool_node);
+            tool_node = next_node;
+        }
+        agent->local_tools[i] = NULL;
+    }
+
+    if (pool->lock) {
+        vSemaphoreDelete(pool->lock);
+        pool->lock = NULL;
+    }
 }
 
-esp_err_t esp_agent_register_local_tool(esp_agent_handle_t handle, const char *name, esp_agent_tool_handler_t tool_handler, void *user_data)
+esp_err_t esp_agent_execute_tool(esp_agent_handle_t handle, const char *request_id, const char *tool_name, cJSON *input)
 {
-    if (handle == NULL || name == NULL || tool_handler == NULL) {
+    if (handle == NULL || request_id == NULL || tool_name == NULL) {
+        cJSON_Delete(input);
         return ESP_ERR_INVALID_ARG;
     }
 
     esp_agent_t *agent = (esp_agent_t *)handle;
+    esp_agent_tool_pool_t *pool = &agent->tool_pool;
+    esp_err_t err = ESP_OK;
+    char err_msg[96] = "Device is busy, please try again later";
+    char *cached_result = NULL;
 
-    // Check for duplicate tool names
-    local_tool_node_t *existing_node = agent->local_tools;
-    while (existing_node != NULL) {
-        if (strcmp(existing_node->name, name) == 0) {
-            ESP_LOGE(TAG, "Tool with name '%s' already registered", name);
-            return ESP_ERR_INVALID_STATE;
+    esp_agent_tool_call_t *request = calloc(1, sizeof(esp_agent_tool_call_t));
+    if (request == NULL) {
+        ESP_LOGE(TAG, "Failed to allocate memory for tool request");
+        cJSON_Delete(input);
+        return ESP_ERR_NO_MEM;
+    }
+    request->input = input;
+    request->request_id = strdup(request_id);
+    request->tool_name = strdup(tool_name);
+    if (request->request_id == NULL || request->tool_name == NULL) {
+        ESP_LOGE(TAG, "Failed to allocate memory for tool request");
+        free_tool_request(request);
+        return ESP_ERR_NO_MEM;
+    }
+
+    xSemaphoreTake(pool->lock, portMAX_DELAY);
+    local_tool_node_t *tool_node = find_tool(agent, tool_name);
+    if (tool_node == NULL) {
+        ESP_LOGE(TAG, "Tool with name '%s' not found", tool_name);
+        snprintf(err_msg, sizeof(err_msg), "Unknown tool '%s'", tool_name);
+        err = ESP_ERR_NOT_FOUND;
+    } else if ((err = build_tool_parameters(tool_node, input, request, err_msg, sizeof(err_msg))) == ESP_OK) {
+        ESP_LOGD(TAG, "Found tool: %s", tool_name);
+        if (tool_node->cache && tool_cache_key(request->parameters, request->num_parameters, &request->cache_key)) {
+            request->cacheable = true;
+            request->cache_generation = tool_node->cache_generation;
+            cached_result = tool_cache_lookup(tool_node, request->cache_key);
+        }
+        request->tool_handler = tool_node->tool_handler;
+        request->async_handler = tool_node->async_handler;
+        request->stream_handler = tool_node->stream_handler;
+        request->user_data = tool_node->user_data;
+        request->handle = handle;
+        request->enqueue_time_us = esp_timer_get_time();
+        if (tool_node->timeout_ms) {
+            request->deadline_us = request->enqueue_time_us + (int64_t)tool_node->timeout_ms * 1000;
+        }
+
+        if (cached_result) {
+            /* Answered without a worker, so the concurrency limit does not apply */
+            pool->cache_hits++;
+        } else if (tool_node->max_concurrency && tool_node->in_flight >= tool_node->max_concurrency) {
+            ESP_LOGW(TAG, "Tool '%s' already has %d calls in flight", tool_name, tool_node->in_flight);
+            snprintf(err_msg, sizeof(err_msg), "Device is busy, please try again later");
+            pool->rejected++;
+            err = ESP_ERR_INVALID_STATE;
+        } else if (xQueueSend(pool->queue, &request, 0) == pdTRUE) {
+            tool_node->in_flight++;
+            request->tool_registration = tool_node->registration;
+            request->next = pool->active;
+            pool->active = request;
+        } else {
+            ESP_LOGW(TAG, "Tool worker pool is saturated, rejecting '%s'", tool_name);
+            snprintf(err_msg, sizeof(err_msg), "Device is busy, please try again later");
+            pool->rejected++;
+            err = ESP_ERR_NO_MEM;
+        }
+    }
+    xSemaphoreGive(pool->lock);
+
+    if (cached_result) {
+        ESP_LOGD(TAG, "Answering '%s' from the result cache", tool_name);
+        send_tool_response(agent, request->request_id, ESP_OK, cached_result);
+        free(cached_result);
+        free_tool_request(request);
+    } else if (err != ESP_OK) {
+        /* Answer right away instead of leaving the call unanswered */
+        send_tool_response(agent, request->request_id, err, err_msg);
+        free_tool_request(request);
+    }
+    return err;
+}
+
+void esp_agent_tools_check_deadlines(esp_agent_handle_t handle)
+{
+    esp_agent_t *agent = (esp_agent_t *)handle;
+    esp_agent_tool_pool_t *pool = &agent->tool_pool;
+
+    /* One call per pass, since the response is sent without the lock held */
+    while (true) {
+        char *request_id = NULL;
+        char *tool_name = NULL;
+        int64_t now = esp_timer_get_time();
+
+        xSemaphoreTake(pool->lock, portMAX_DELAY);
+        for (esp_agent_tool_call_t *call = pool->active; call; call = call->next) {
+            if (call->deadline_us && now >= call->deadline_us && !call->answered) {
+                call->answered = true;
+                call->cancelled = true;
+                pool->timed_out++;
+                request_id = strdup(call->request_id);
+                tool_name = strdup(call->tool_name);
+                break;
+            }
+        }
+        xSemaphoreGive(pool->lock);
+
+        if (request_id == NULL) {
+            free(tool_name);
+            return;
+        }
+        ESP_LOGW(TAG, "Tool call %s (%s) timed out", tool_name ? tool_name : "?", request_id);
+        send_tool_response(agent, request_id, ESP_ERR_TIMEOUT, "Tool call timed out");
+        free(request_id);
+        free(tool_name);
+    }
+}
+
+void esp_agent_tools_cancel_all(esp_agent_handle_t handle, const char *reason)
+{
+    esp_agent_t *agent = (esp_agent_t *)handle;
+    esp_agent_tool_pool_t *pool = &agent->tool_pool;
+    int count = 0;
+
+    if (pool->lock == NULL) {
+        return;
+    }
+
+    xSemaphoreTake(pool->lock, portMAX_DELAY);
+    for (esp_agent_tool_call_t *call = pool->active; call; call = call->next) {
+        if (!call->cancelled) {
+            /* The server is no longer waiting for these, so no response is sent */
+            call->cancelled = true;
+            call->answered = true;
+            pool->cancelled++;
+            count++;
+        }
+    }
+    xSemaphoreGive(pool->lock);
+
+    if (count) {
+        ESP_LOGI(TAG, "Cancelled %d tool call(s) on %s", count, reason);
+    }
+}
+
+esp_err_t esp_agent_tool_param_iter_init(esp_agent_tool_param_iter_t *iter, const esp_agent_tool_param_t *param)
+{
+    if (iter == NULL || param == NULL ||
+            (param->type != ESP_AGENT_PARAM_TYPE_OBJECT && param->type != ESP_AGENT_PARAM_TYPE_ARRAY)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    iter->next = ((const cJSON *)param->value.node)->child;
+    return ESP_OK;
+}
+
+bool esp_agent_tool_param_iter_next(esp_agent_tool_param_iter_t *iter, esp_agent_tool_param_t *item)
+{
+    if (iter == NULL || item == NULL || iter->next == NULL) {
+        return false;
+    }
+    const cJSON *value = (const cJSON *)iter->next;
+    iter->next = value->next;
+    item->name = value->string;
+    fill_param_view(value, item);
+    return true;
+}
+
+esp_err_t esp_agent_tool_param_get_member(const esp_agent_tool_param_t *param, const char *name, esp_agent_tool_param_t *member)
+{
+    if (param == NULL || name == NULL || member == NULL || param->type != ESP_AGENT_PARAM_TYPE_OBJECT) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    const cJSON *value = cJSON_GetObjectItemCaseSensitive((const cJSON *)param->value.node, name);
+    if (value == NULL) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    member->name = value->string;
+    fill_param_view(value, member);
+    return ESP_OK;
+}
+
+size_t esp_agent_tool_param_get_size(const esp_agent_tool_param_t *param)
+{
+    if (param == NULL || (param->type != ESP_AGENT_PARAM_TYPE_OBJECT && param->type != ESP_AGENT_PARAM_TYPE_ARRAY)) {
+        return 0;
+    }
+    return (size_t)cJSON_GetArraySize((const cJSON *)param->value.node);
+}
+
+esp_err_t esp_agent_tool_complete(esp_agent_tool_call_t *call, esp_err_t status, char *result)
+{
+    if (call == NULL || call->async_handler == NULL) {
+        free(result);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    esp_agent_t *agent = (esp_agent_t *)call->handle;
+
+    xSemaphoreTake(agent->tool_pool.lock, portMAX_DELAY);
+    bool completed = call->completed;
+    call->completed = true;
+    xSemaphoreGive(agent->tool_pool.lock);
+    if (completed) {
+        ESP_LOGE(TAG, "Tool call %s (%s) completed twice", call->tool_name, call->request_id);
+        free(result);
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    finish_tool_call(agent, call, status, result);
+    release_tool_slot(agent, call);
+    put_tool_call(agent, call);
+    return ESP_OK;
+}
+
+esp_agent_tool_call_t *esp_agent_tool_get_current_call(esp_agent_handle_t handle)
+{
+    if (handle == NULL) {
+        return NULL;
+    }
+
+    esp_agent_t *agent = (esp_agent_t *)handle;
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    esp_agent_tool_call_t *current = NULL;
+
+    xSemaphoreTake(agent->tool_pool.lock, portMAX_DELAY);
+    for (esp_agent_tool_call_t *call = agent->tool_pool.active; call; call = call->next) {
+        if (call->worker == self) {
+            current = call;
+            break;
+        }
+    }
+    xSemaphoreGive(agent->tool_pool.lock);
+    return current;
+}
+
+bool esp_agent_tool_call_is_cancelled(const esp_agent_tool_call_t *call)
+{
+    if (call == NULL) {
+        return false;
+    }
+    return call->cancelled || (call->deadline_us && esp_timer_get_time() >= call->deadline_us);
+}
+
+uint32_t esp_agent_tool_call_get_remaining_ms(const esp_agent_tool_call_t *call)
+{
+    if (call == NULL || call->deadline_us == 0) {
+        return UINT32_MAX;
+    }
+    if (call->cancelled) {
+        return 0;
+    }
+    int64_t remaining_us = call->deadline_us - esp_timer_get_time();
+    return remaining_us > 0 ? (uint32_t)(remaining_us / 1000) : 0;
+}
+
+esp_err_t esp_agent_tool_cache_invalidate(esp_agent_handle_t handle, const char *name)
+{
+    if (handle == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    esp_agent_t *agent = (esp_agent_t *)handle;
+    esp_err_t err = ESP_OK;
+
+    xSemaphoreTake(agent->tool_pool.lock, portMAX_DELAY);
+    if (name) {
+        local_tool_node_t *tool_node = find_tool(agent, name);
+        if (tool_node) {
+            tool_cache_clear(agent, tool_node);
+        } else {
+            err = ESP_ERR_NOT_FOUND;
+        }
+    } else {
+        for (int i = 0; i < ESP_AGENT_TOOL_HASH_BUCKETS; i++) {
+            for (local_tool_node_t *tool_node = agent->local_tools[i]; tool_node; tool_node = tool_node->next) {
+                tool_cache_clear(agent, tool_node);
+            }
         }
-        existing_node = existing_node->next;
     }
+    xSemaphoreGive(agent->tool_pool.lock);
+
+    ESP_LOGD(TAG, "Invalidated tool cache of %s", name ? name : "all tools");
+    return err;
+}
 
-    local_tool_node_t *new_node = malloc(sizeof(local_tool_node_t));
+esp_err_t esp_agent_get_tool_stats(esp_agent_handle_t handle, esp_agent_tool_stats_t *stats)
+{
+    if (handle == NULL || stats == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    esp_agent_t *agent = (esp_agent_t *)handle;
+    esp_agent_tool_pool_t *pool = &agent->tool_pool;
+
+    xSemaphoreTake(pool->lock, portMAX_DELAY);
+    stats->executed = pool->executed;
+    stats->rejected = pool->rejected;
+    stats->cache_hits = pool->cache_hits;
+    stats->timed_out = pool->timed_out;
+    stats->cancelled = pool->cancelled;
+    stats->max_queue_wait_ms = pool->max_wait_ms;
+    stats->avg_queue_wait_ms = pool->executed ? (uint32_t)(pool->total_wait_ms / pool->executed) : 0;
+    xSemaphoreGive(pool->lock);
+
+    return ESP_OK;
+}
+
+static esp_err_t register_local_tool(esp_agent_handle_t handle, const char *name, const tool_handlers_t *handlers,
+                                     void *user_data, const esp_agent_tool_config_t *config)
+{
+    if (handle == NULL || name == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    esp_agent_t *agent = (esp_agent_t *)handle;
+
+    if (config && config->num_params && config->params == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (config && config->stack_size > CONFIG_ESP_AGENT_TOOL_WORKER_STACK_SIZE) {
+        ESP_LOGE(TAG, "Tool '%s' needs %" PRIu32 " bytes of stack, workers have %d. Increase CONFIG_ESP_AGENT_TOOL_WORKER_STACK_SIZE",
+                 name, config->stack_size, CONFIG_ESP_AGENT_TOOL_WORKER_STACK_SIZE);
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    local_tool_node_t *new_node = calloc(1, sizeof(local_tool_node_t));
     if (new_node == NULL) {
         ESP_LOGE(TAG, "Failed to allocate memory for tool node");
         return ESP_ERR_NO_MEM;
@@ -148,16 +1121,81 @@ esp_err_t esp_agent_register_local_tool(esp_agent_handle_t handle, const char *n
         return ESP_ERR_NO_MEM;
     }
 
-    new_node->tool_handler = tool_handler;
+    new_node->hash = tool_name_hash(name);
+    new_node->tool_handler = handlers->sync;
+    new_node->async_handler = handlers->async;
+    new_node->stream_handler = handlers->stream;
     new_node->user_data = user_data;
+    new_node->max_concurrency = config ? config->max_concurrency : 0;
+    new_node->timeout_ms = (config && config->timeout_ms) ? config->timeout_ms : CONFIG_ESP_AGENT_TOOL_DEFAULT_TIMEOUT_MS;
+    if (config && config->params && config->num_params) {
+        new_node->params = config->params;
+        new_node->num_params = config->num_params;
+    }
+    if (config && config->cache_ttl_ms && handlers->stream) {
+        ESP_LOGW(TAG, "Streaming tool '%s' cannot be cached, ignoring cache_ttl_ms", name);
+    } else if (config && config->cache_ttl_ms) {
+        new_node->cache = calloc(ESP_AGENT_TOOL_CACHE_ENTRIES, sizeof(esp_agent_tool_cache_entry_t));
+        if (new_node->cache == NULL) {
+            ESP_LOGE(TAG, "Failed to allocate memory for tool cache");
+            free_tool_node(new_node);
+            return ESP_ERR_NO_MEM;
+        }
+        new_node->cache_ttl_ms = config->cache_ttl_ms;
+    }
 
-    new_node->next = agent->local_tools;
-    agent->local_tools = new_node;
+    xSemaphoreTake(agent->tool_pool.lock, portMAX_DELAY);
+    // Check for duplicate tool names
+    if (find_tool(agent, name) != NULL) {
+        xSemaphoreGive(agent->tool_pool.lock);
+        ESP_LOGE(TAG, "Tool with name '%s' already registered", name);
+        free_tool_node(new_node);
+        return ESP_ERR_INVALID_STATE;
+    }
+    new_node->cache_generation = ++agent->tool_pool.cache_generation;
+    new_node->registration = ++agent->tool_pool.registrations;
+
+    local_tool_node_t **bucket = &agent->local_tools[new_node->hash & (ESP_AGENT_TOOL_HASH_BUCKETS - 1)];
+    new_node->next = *bucket;
+    *bucket = new_node;
+    xSemaphoreGive(agent->tool_pool.lock);
 
     ESP_LOGI(TAG, "Registered local tool: %s", name);
     return ESP_OK;
 }
 
+esp_err_t esp_agent_register_local_tool_with_config(esp_agent_handle_t handle, const char *name, esp_agent_tool_handler_t tool_handler, void *user_data, const esp_agent_tool_config_t *config)
+{
+    if (tool_handler == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    tool_handlers_t handlers = {.sync = tool_handler};
+    return register_local_tool(handle, name, &handlers, user_data, config);
+}
+
+esp_err_t esp_agent_register_local_async_tool(esp_agent_handle_t handle, const char *name, esp_agent_async_tool_handler_t tool_handler, void *user_data, const esp_agent_tool_config_t *config)
+{
+    if (tool_handler == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    tool_handlers_t handlers = {.async = tool_handler};
+    return register_local_tool(handle, name, &handlers, user_data, config);
+}
+
+esp_err_t esp_agent_register_local_stream_tool(esp_agent_handle_t handle, const char *name, esp_agent_stream_tool_handler_t tool_handler, void *user_data, const esp_agent_tool_config_t *config)
+{
+    if (tool_handler == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    tool_handlers_t handlers = {.stream = tool_handler};
+    return register_local_tool(handle, name, &handlers, user_data, config);
+}
+
+esp_err_t esp_agent_register_local_tool(esp_agent_handle_t handle, const char *name, esp_agent_tool_handler_t tool_handler, void *user_data)
+{
+    return esp_agent_register_local_tool_with_config(handle, name, tool_handler, user_data, NULL);
+}
+
 esp_err_t esp_agent_unregister_local_tool(esp_agent_handle_t handle, const char *name)
 {
     if (handle == NULL || name == NULL) {
@@ -166,22 +1204,24 @@ esp_err_t esp_agent_unregister_local_tool(esp_agent_handle_t handle, const char
 
     esp_agent_t *agent = (esp_agent_t *)handle;
 
+    xSemaphoreTake(agent->tool_pool.lock, portMAX_DELAY);
+
     // Find the tool node by name
-    local_tool_node_t *tool_node = agent->local_tools;
+    uint32_t hash = tool_name_hash(name);
+    local_tool_node_t **bucket = &agent->local_tools[hash & (ESP_AGENT_TOOL_HASH_BUCKETS - 1)];
+    local_tool_node_t *tool_node = *bucket;
     local_tool_node_t *prev_node = NULL;
 
     while (tool_node != NULL) {
-        if (strcmp(tool_node->name, name) == 0) {
+        if (tool_node->hash == hash && strcmp(tool_node->name, name) == 0) {
             if (prev_node == NULL) {
-                agent->local_tools = tool_node->next;
+                *bucket = tool_node->next;
             } else {
                 prev_node->next = tool_node->next;
             }
+            xSemaphoreGive(agent->tool_pool.lock);
 
-            if (tool_node->name) {
-                free(tool_node->name);
-            }
-            free(tool_node);
+            free_tool_node(tool_node);
 
             ESP_LOGI(TAG, "Unregistered local tool: %s", name);
             return ESP_OK;
@@ -189,6 +1229,7 @@ esp_err_t esp_agent_unregister_local_tool(esp_agent_handle_t handle, const char
         prev_node = tool_node;
         tool_node = tool_node->next;
     }
+    xSemaphoreGive(agent->tool_pool.lock);
 
     ESP_LOGW(TAG, "Tool with name '%s' not found", name);
     return ESP_ERR_NOT_FOUND;
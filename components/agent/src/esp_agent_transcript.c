@@ -0,0 +1,198 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <esp_log.h>
+#include <esp_timer.h>
+
+#include <esp_agent.h>
+#include <esp_agent_internal.h>
+#include <esp_agent_internal_events.h>
+#include <esp_agent_internal_transcript.h>
+
+static const char *TAG = "esp_agent_transcript";
+
+#if CONFIG_ESP_AGENT_TRANSCRIPT_MAX_RATE_HZ > 0
+#define TRANSCRIPT_MIN_INTERVAL_US (1000000LL / CONFIG_ESP_AGENT_TRANSCRIPT_MAX_RATE_HZ)
+#else
+#define TRANSCRIPT_MIN_INTERVAL_US 0
+#endif
+
+/* Length of the common prefix of a and b, never ending inside a UTF-8 code point of b */
+static size_t transcript_common_prefix(const char *a, const char *b)
+{
+    size_t len = 0;
+    while (a[len] != '\0' && a[len] == b[len]) {
+        len++;
+    }
+    while (len > 0 && ((unsigned char)b[len] & 0xC0) == 0x80) {
+        len--;
+    }
+    return len;
+}
+
+/* Takes ownership of text */
+static esp_err_t transcript_deliver(esp_agent_t *agent, esp_agent_message_role_t role,
+                                    esp_agent_message_generation_stage_t stage, char *text)
+{
+    esp_agent_transcript_slot_t *slot = &agent->transcript[role];
+    esp_agent_message_data_t event_data;
+    event_data.text.text = text;
+    event_data.text.role = role;
+    event_data.text.generation_stage = stage;
+    event_data.text.offset = 0;
+
+    slot->last_delivery_us = esp_timer_get_time();
+
+    if (agent->text_delta) {
+        /* Append only if the previous text is an exact prefix, otherwise replace */
+        if (slot->delivered) {
+            size_t common = transcript_common_prefix(slot->delivered, text);
+            if (slot->delivered[common] == '\0') {
+                event_data.text.offset = common;
+            }
+        }
+
+        if (text[event_data.text.offset] == '\0' && event_data.text.offset > 0 &&
+                stage == ESP_AGENT_MESSAGE_GENERATION_STAGE_SPECULATIVE) {
+            ESP_LOGV(TAG, "Skipping unchanged speculative transcript for role %d", role);
+            free(text);
+            return ESP_OK;
+        }
+
+        char *delta = strdup(text + event_data.text.offset);
+        if (delta == NULL) {
+            ESP_LOGE(TAG, "Failed to allocate memory for transcript delta");
+            free(text);
+            return ESP_ERR_NO_MEM;
+        }
+        event_data.text.text = delta;
+
+        /* Keep the full text as the baseline for the next delta of this turn */
+        free(slot->delivered);
+        slot->delivered = NULL;
+        if (stage == ESP_AGENT_MESSAGE_GENERATION_STAGE_FINAL) {
+            free(text);
+        } else {
+            slot->delivered = text;
+        }
+    }
+
+    esp_err_t err = esp_agent_post_event(agent, ESP_AGENT_EVENT_DATA_TYPE_TEXT, &event_data);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to post text event: 0x%x", err);
+        free((char *)event_data.text.text);
+        /* The consumer missed this text, so the next one must be a full replace */
+        free(slot->delivered);
+        slot->delivered = NULL;
+    }
+    return err;
+}
+
+static void transcript_deliver_pending(esp_agent_t *agent, esp_agent_message_role_t role)
+{
+    char *text = agent->transcript[role].pending;
+    agent->transcript[role].pending = NULL;
+    if (text) {
+        transcript_deliver(agent, role, ESP_AGENT_MESSAGE_GENERATION_STAGE_SPECULATIVE, text);
+    }
+}
+
+esp_err_t esp_agent_transcript_submit(esp_agent_handle_t handle, esp_agent_message_role_t role,
+                                      esp_agent_message_generation_stage_t stage, const char *text)
+{
+    if (handle == NULL || text == NULL || role >= ESP_AGENT_MESSAGE_ROLE_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    esp_agent_t *agent = (esp_agent_t *)handle;
+    esp_agent_transcript_slot_t *slot = &agent->transcript[role];
+
+    char *copy = strdup(text);
+    if (copy == NULL) {
+        ESP_LOGE(TAG, "Failed to allocate memory for transcript");
+        return ESP_ERR_NO_MEM;
+    }
+
+    /* A newer speculative text always supersedes the pending one */
+    free(slot->pending);
+    slot->pending = NULL;
+
+    if (stage != ESP_AGENT_MESSAGE_GENERATION_STAGE_SPECULATIVE || TRANSCRIPT_MIN_INTERVAL_US == 0) {
+        return transcript_deliver(agent, role, stage, copy);
+    }
+
+    slot->pending = copy;
+    if (esp_timer_get_time() - slot->last_delivery_us >= TRANSCRIPT_MIN_INTERVAL_US) {
+        transcript_deliver_pending(agent, role);
+    } else {
+        ESP_LOGV(TAG, "Coalescing speculative transcript for role %d", role);
+    }
+    return ESP_OK;
+}
+
+void esp_agent_transcript_flush_due(esp_agent_handle_t handle)
+{
+    esp_agent_t *agent = (esp_agent_t *)handle;
+    int64_t now = esp_timer_get_time();
+
+    for (int role = 0; role < ESP_AGENT_MESSAGE_ROLE_MAX; role++) {
+        esp_agent_transcript_slot_t *slot = &agent->transcript[role];
+        if (slot->pending && now - slot->last_delivery_us >= TRANSCRIPT_MIN_INTERVAL_US) {
+            transcript_deliver_pending(agent, role);
+        }
+    }
+}
+
+void esp_agent_transcript_flush(esp_agent_handle_t handle)
+{
+    esp_agent_t *agent = (esp_agent_t *)handle;
+
+    for (int role = 0; role < ESP_AGENT_MESSAGE_ROLE_MAX; role++) {
+        transcript_deliver_pending(agent, role);
+        free(agent->transcript[role].delivered);
+        agent->transcript[role].delivered = NULL;
+    }
+}
+
+TickType_t esp_agent_transcript_next_wait(esp_agent_handle_t handle, TickType_t max_wait)
+{
+    esp_agent_t *agent = (esp_agent_t *)handle;
+    int64_t now = esp_timer_get_time();
+    TickType_t wait = max_wait;
+
+    for (int role = 0; role < ESP_AGENT_MESSAGE_ROLE_MAX; role++) {
+        esp_agent_transcript_slot_t *slot = &agent->transcript[role];
+        if (slot->pending == NULL) {
+            continue;
+        }
+        int64_t remaining_us = slot->last_delivery_us + TRANSCRIPT_MIN_INTERVAL_US - now;
+        TickType_t ticks = 0;
+        if (remaining_us > 0) {
+            ticks = pdMS_TO_TICKS((remaining_us + 999) / 1000);
+            ticks = ticks > 0 ? ticks : 1;
+        }
+        if (ticks < wait) {
+            wait = ticks;
+        }
+    }
+    return wait;
+}
+
+void esp_agent_transcript_reset(esp_agent_handle_t handle)
+{
+    esp_agent_t *agent = (esp_agent_t *)handle;
+
+    for (int role = 0; role < ESP_AGENT_MESSAGE_ROLE_MAX; role++) {
+        free(agent->transcript[role].pending);
+        agent->transcript[role].pending = NULL;
+        free(agent->transcript[role].delivered);
+        agent->transcript[role].delivered = NULL;
+        agent->transcript[role].last_delivery_us = 0;
+    }
+}
@@ -26,11 +26,56 @@
 #include <esp_agent_internal_messages.h>
 #include <esp_agent_internal_events.h>
 #include <esp_agent_auth.h>
+#include <esp_agent_internal_tools.h>
 
 static const char *TAG = "esp_agent_ws";
 
 #define ACCESS_TOKEN_EXPIRATION_SECONDS 3600
 
+void esp_agent_websocket_free_fragments(ws_send_fragment_t *fragments)
+{
+    while (fragments) {
+        ws_send_fragment_t *next = fragments->next;
+        free(fragments);
+        fragments = next;
+    }
+}
+
+static void free_send_message(ws_send_message_t *msg)
+{
+    if (msg->payload) {
+        free(msg->payload);
+    }
+    esp_agent_websocket_free_fragments(msg->fragments);
+    free(msg);
+}
+
+/*
+ * Send the pieces of a message back to back. Only control frames may come between them, so when a
+ * piece after the first fails, the message is left open and the connection is closed.
+ */
+static void send_fragments(esp_agent_t *agent, const ws_send_fragment_t *fragments)
+{
+    ws_transport_opcodes_t opcode = WS_TRANSPORT_OPCODES_TEXT;
+
+    for (const ws_send_fragment_t *fragment = fragments; fragment; fragment = fragment->next) {
+        if (fragment->next == NULL) {
+            opcode |= WS_TRANSPORT_OPCODES_FIN;
+        }
+        int ws_ret = esp_websocket_client_send_with_exact_opcode(agent->ws_client, opcode, (const uint8_t *)fragment->data,
+                                                                 fragment->len, pdMS_TO_TICKS(5000));
+        if (ws_ret < 0) {
+            ESP_LOGE(TAG, "Failed to send message fragment: %d", ws_ret);
+            if (fragment != fragments) {
+                ESP_LOGW(TAG, "Closing the connection, a fragmented message is left unfinished");
+                esp_websocket_client_close(agent->ws_client, pdMS_TO_TICKS(100));
+            }
+            return;
+        }
+        opcode = WS_TRANSPORT_OPCODES_CONT;
+    }
+}
+
 void esp_agent_websocket_send_task(void *pvParameters)
 {
     esp_agent_t *agent = (esp_agent_t *)pvParameters;
@@ -67,6 +112,9 @@ void esp_agent_websocket_send_task(void *pvParameters)
                 case WS_SEND_MSG_TYPE_BINARY:
                     send_opcode = WS_TRANSPORT_OPCODES_BINARY;
                     break;
+                case WS_SEND_MSG_TYPE_TEXT_FRAGMENTS:
+                    send_fragments(agent, msg->fragments);
+                    goto deallocate_message;
                 default:
                     goto deallocate_message;
             }
@@ -77,10 +125,7 @@ void esp_agent_websocket_send_task(void *pvParameters)
             }
 
         deallocate_message:
-            if (msg->payload) {
-                free(msg->payload);
-            }
-            free(msg);
+            free_send_message(msg);
         }
     }
 
@@ -119,6 +164,7 @@ esp_err_t esp_agent_websocket_queue_message(esp_agent_handle_t handle, ws_send_m
     memcpy(msg->payload, payload, len);
     msg->type = type;
     msg->len = len;
+    msg->fragments = NULL;
 
     ESP_GOTO_ON_FALSE(xQueueSend(agent->send_queue, &msg, timeout), ESP_ERR_TIMEOUT, error, TAG, "Failed to queue message (queue full), dropping");
 
@@ -135,6 +181,40 @@ error:
     return ret;
 }
 
+esp_err_t esp_agent_websocket_queue_fragments(esp_agent_handle_t handle, ws_send_fragment_t *fragments, TickType_t timeout)
+{
+    if (handle == NULL || fragments == NULL) {
+        esp_agent_websocket_free_fragments(fragments);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    esp_agent_t *agent = (esp_agent_t *)handle;
+
+    if (!agent->started || agent->send_queue == NULL) {
+        ESP_LOGW(TAG, "Agent not started, cannot queue message");
+        esp_agent_websocket_free_fragments(fragments);
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    ws_send_message_t *msg = calloc(1, sizeof(ws_send_message_t));
+    if (msg == NULL) {
+        ESP_LOGE(TAG, "Failed to allocate memory for send message");
+        esp_agent_websocket_free_fragments(fragments);
+        return ESP_ERR_NO_MEM;
+    }
+    msg->type = WS_SEND_MSG_TYPE_TEXT_FRAGMENTS;
+    msg->fragments = fragments;
+
+    if (xQueueSend(agent->send_queue, &msg, timeout) != pdTRUE) {
+        ESP_LOGE(TAG, "Failed to queue message (queue full), dropping");
+        free_send_message(msg);
+        return ESP_ERR_TIMEOUT;
+    }
+
+    ESP_LOGV(TAG, "Queued fragmented text message");
+    return ESP_OK;
+}
+
 static esp_err_t build_ws_uri(const char *agent_id, const char *access_token, char **uri_out, size_t *uri_len)
 {
     if (agent_id == NULL || access_token == NULL || uri_out == NULL || uri_len == NULL) {
@@ -273,15 +353,14 @@ esp_err_t esp_agent_stop(esp_agent_handle_t handle)
     agent->connected = false;
     agent->handshake_state = ESP_AGENT_HANDSHAKE_NOT_DONE;
 
+    esp_agent_tools_cancel_all(handle, "stop");
+
     // Purge any remaining messages in send queue
     if (agent->send_queue) {
         ws_send_message_t *msg = NULL;
         while (xQueueReceive(agent->send_queue, &msg, 0) == pdTRUE) {
             if (msg) {
-                if (msg->payload) {
-                    free(msg->payload);
-                }
-                free(msg);
+                free_send_message(msg);
             }
         }
     }
@@ -429,6 +508,7 @@ void esp_agent_websocket_event_handler(void *handler_args, esp_event_base_t base
             agent->started = false;
             /* Perform handshake again on reconnect */
             agent->handshake_state = ESP_AGENT_HANDSHAKE_NOT_DONE;
+            esp_agent_tools_cancel_all(agent, "disconnect");
             esp_agent_post_event(agent, ESP_AGENT_EVENT_DISCONNECTED, NULL);
 
             // Reset message buffer on error
@@ -92,12 +92,13 @@ static esp_gmf_err_t pool_register_converters(esp_gmf_pool_handle_t pool)
     return ESP_GMF_ERR_OK;
 }
 
-static esp_gmf_afe_manager_handle_t pool_setup_afe(const char *input_format, esp_gmf_pool_handle_t pool)
+static esp_gmf_afe_manager_handle_t pool_setup_afe(const char *input_format, const audio_recorder_afe_profile_t *profile,
+                                                   const char *vcmd_language, esp_gmf_pool_handle_t pool)
 {
     esp_gmf_err_t err = ESP_GMF_ERR_OK;
 
     void *models = esp_srmodel_init("model");
-    afe_config_t *afe_cfg = afe_config_init(input_format, models, AFE_TYPE_SR, AFE_MODE_HIGH_PERF);
+    afe_config_t *afe_cfg = afe_config_init(input_format, models, AFE_TYPE_SR, profile->high_perf ? AFE_MODE_HIGH_PERF : AFE_MODE_LOW_COST);
     afe_cfg->wakenet_init = true;
 #if CONFIG_ENABLE_AEC
     afe_cfg->aec_init = true;
@@ -107,18 +108,22 @@ static esp_gmf_afe_manager_handle_t pool_setup_afe(const char *input_format, esp
     afe_cfg->vad_init = true;
     afe_cfg->vad_min_noise_ms = 1000;
     afe_cfg->vad_min_speech_ms = 64;
-    afe_cfg->vad_mode = VAD_MODE_3;
-    afe_cfg->se_init = false;
-    afe_cfg->agc_init = true;
-    afe_cfg->memory_alloc_mode = AFE_MEMORY_ALLOC_MORE_PSRAM;
+    afe_cfg->vad_mode = (vad_mode_t)profile->vad_mode;
+    afe_cfg->se_init = profile->se_enable;
+    afe_cfg->agc_init = profile->agc_enable;
+    afe_cfg->memory_alloc_mode = profile->prefer_psram ? AFE_MEMORY_ALLOC_MORE_PSRAM : AFE_MEMORY_ALLOC_INTERNAL_PSRAM_BALANCE;
+
+    ESP_LOGI(TAG, "AFE profile: %s mode, %s memory, SE %d, AGC %d, VAD mode %d",
+             profile->high_perf ? "high perf" : "low cost", profile->prefer_psram ? "PSRAM" : "balanced",
+             profile->se_enable, profile->agc_enable, profile->vad_mode);
 
     esp_gmf_afe_manager_cfg_t gmf_afe_cfg = DEFAULT_GMF_AFE_MANAGER_CFG(afe_cfg, NULL, NULL, NULL, NULL);
-    gmf_afe_cfg.feed_task_setting.core = 1;
-    gmf_afe_cfg.feed_task_setting.prio = 6;
+    gmf_afe_cfg.feed_task_setting.core = profile->feed_core;
+    gmf_afe_cfg.feed_task_setting.prio = profile->feed_prio;
     gmf_afe_cfg.feed_task_setting.stack_size = 5*1024;
 
-    gmf_afe_cfg.fetch_task_setting.core = 0;
-    gmf_afe_cfg.fetch_task_setting.prio = 6;
+    gmf_afe_cfg.fetch_task_setting.core = profile->fetch_core;
+    gmf_afe_cfg.fetch_task_setting.prio = profile->fetch_prio;
     gmf_afe_cfg.fetch_task_setting.stack_size = 5*1024;
 
     esp_gmf_afe_manager_handle_t gmf_afe_manager = NULL;
@@ -132,6 +137,13 @@ static esp_gmf_afe_manager_handle_t pool_setup_afe(const char *input_format, esp
     esp_gmf_element_handle_t ai_afe = NULL;
     esp_gmf_afe_cfg_t ai_afe_cfg = DEFAULT_GMF_AFE_CFG(gmf_afe_manager, NULL, NULL, models);
     ai_afe_cfg.wakeup_end = 15 * 1000; // 15 seconds
+    if (vcmd_language) {
+        /* MultiNet listens for a command after each wake word, the uplink is held back meanwhile */
+        ai_afe_cfg.vcmd_detect_en = true;
+        ai_afe_cfg.vcmd_timeout = AUDIO_RECORDER_COMMAND_WINDOW_MS;
+        ai_afe_cfg.mn_language = (char *)vcmd_language;
+        ESP_LOGI(TAG, "Voice command detection enabled, language %s", vcmd_language);
+    }
 
     err = esp_gmf_afe_init(&ai_afe_cfg, &ai_afe);
     if (err != ESP_GMF_ERR_OK) {
@@ -185,12 +197,12 @@ esp_gmf_pool_handle_t audio_pool_get(void)
     return g_audio_common_data.pool_handle;
 }
 
-void* audio_pool_register_afe(const char *input_format)
+void* audio_pool_register_afe(const char *input_format, const audio_recorder_afe_profile_t *profile, const char *vcmd_language)
 {
-    if (!g_audio_common_data.initialized || !g_audio_common_data.pool_handle) {
+    if (!g_audio_common_data.initialized || !g_audio_common_data.pool_handle || profile == NULL) {
         ESP_LOGE(TAG, "Audio pool not initialized");
         return NULL;
     }
 
-    return pool_setup_afe(input_format, g_audio_common_data.pool_handle);
+    return pool_setup_afe(input_format, profile, vcmd_language, g_audio_common_data.pool_handle);
 }
@@ -0,0 +1,333 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <audio_convert.h>
+
+/* Frames handled per iteration of the unrolled kernels */
+#define AUDIO_CONVERT_UNROLL 4
+
+/* Word access to int16_t/int32_t buffers, exempt from strict aliasing */
+typedef uint32_t __attribute__((may_alias)) audio_convert_word_t;
+
+static inline bool audio_convert_is_aligned(const void *ptr, size_t align)
+{
+    return ((uintptr_t)ptr & (align - 1)) == 0;
+}
+
+void audio_convert_s16_mono_to_s32_stereo_ref(const int16_t *src, int32_t *dst, size_t frames)
+{
+    for (size_t i = 0; i < frames; i++) {
+        int32_t sample = (int32_t)((uint32_t)(uint16_t)src[i] << 16);
+        dst[2 * i] = sample;
+        dst[2 * i + 1] = sample;
+    }
+}
+
+void audio_convert_s16_mono_to_s32_stereo(const int16_t *src, int32_t *dst, size_t frames)
+{
+    size_t i = 0;
+
+    /* Two input samples per 32-bit load, the upper half is already in place */
+    if (audio_convert_is_aligned(src, sizeof(uint32_t))) {
+        const audio_convert_word_t *src32 = (const audio_convert_word_t *)src;
+        for (; i + AUDIO_CONVERT_UNROLL <= frames; i += AUDIO_CONVERT_UNROLL) {
+            uint32_t w0 = src32[i / 2];
+            uint32_t w1 = src32[i / 2 + 1];
+            int32_t s0 = (int32_t)(w0 << 16);
+            int32_t s1 = (int32_t)(w0 & 0xFFFF0000);
+            int32_t s2 = (int32_t)(w1 << 16);
+            int32_t s3 = (int32_t)(w1 & 0xFFFF0000);
+            int32_t *d = dst + 2 * i;
+            d[0] = s0;
+            d[1] = s0;
+            d[2] = s1;
+            d[3] = s1;
+            d[4] = s2;
+            d[5] = s2;
+            d[6] = s3;
+            d[7] = s3;
+        }
+    }
+
+    audio_convert_s16_mono_to_s32_stereo_ref(src + i, dst + 2 * i, frames - i);
+}
+
+void audio_convert_s16_mono_to_s16_stereo_ref(const int16_t *src, int16_t *dst, size_t frames)
+{
+    for (size_t i = 0; i < frames; i++) {
+        dst[2 * i] = src[i];
+        dst[2 * i + 1] = src[i];
+    }
+}
+
+void audio_convert_s16_mono_to_s16_stereo(const int16_t *src, int16_t *dst, size_t frames)
+{
+    size_t i = 0;
+
+    /* One stereo frame per 32-bit store */
+    if (audio_convert_is_aligned(dst, sizeof(uint32_t))) {
+        audio_convert_word_t *dst32 = (audio_convert_word_t *)dst;
+        for (; i + AUDIO_CONVERT_UNROLL <= frames; i += AUDIO_CONVERT_UNROLL) {
+            uint32_t s0 = (uint16_t)src[i];
+            uint32_t s1 = (uint16_t)src[i + 1];
+            uint32_t s2 = (uint16_t)src[i + 2];
+            uint32_t s3 = (uint16_t)src[i + 3];
+            dst32[i] = s0 | (s0 << 16);
+            dst32[i + 1] = s1 | (s1 << 16);
+            dst32[i + 2] = s2 | (s2 << 16);
+            dst32[i + 3] = s3 | (s3 << 16);
+        }
+    }
+
+    audio_convert_s16_mono_to_s16_stereo_ref(src + i, dst + 2 * i, frames - i);
+}
+
+/*
+ * Half-band low-pass, Kaiser windowed sinc (beta 7), Q15, unity DC gain.
+ * Only the taps next to the 0.5 center tap are listed, the even taps are 0:
+ * h[15] = 0.5, h[15 - (2j + 1)] = h[15 + (2j + 1)] = audio_convert_halfband[j]
+ */
+#define AUDIO_CONVERT_HALFBAND_TAPS  31
+#define AUDIO_CONVERT_HALFBAND_SIDE  8
+static const int16_t audio_convert_halfband[AUDIO_CONVERT_HALFBAND_SIDE] = {
+    10281, -3050, 1441, -708, 321, -124, 35, -4,
+};
+
+static inline int16_t audio_convert_sat16(int32_t value)
+{
+    if (value > INT16_MAX) {
+        return INT16_MAX;
+    } else if (value < INT16_MIN) {
+        return INT16_MIN;
+    }
+    return (int16_t)value;
+}
+
+static inline int32_t audio_convert_sat32(int64_t value)
+{
+    if (value > INT32_MAX) {
+        return INT32_MAX;
+    } else if (value < INT32_MIN) {
+        return INT32_MIN;
+    }
+    return (int32_t)value;
+}
+
+/* Output k uses w[2k] to w[2k + 30], the newest sample last */
+static void audio_convert_decimate_block(const int16_t *w, int16_t *dst, size_t count)
+{
+    for (size_t k = 0; k < count; k++, w += 2) {
+        int32_t acc = (int32_t)w[15] << 14;
+        for (int j = 0; j < AUDIO_CONVERT_HALFBAND_SIDE; j++) {
+            acc += audio_convert_halfband[j] * ((int32_t)w[14 - 2 * j] + w[16 + 2 * j]);
+        }
+        dst[k] = audio_convert_sat16((acc + (1 << 14)) >> 15);
+    }
+}
+
+/* Output pair k uses w[k] to w[k + 15], the newest sample last */
+static void audio_convert_interpolate_block(const int16_t *w, int16_t *dst, size_t count)
+{
+    for (size_t k = 0; k < count; k++, w++) {
+        int32_t acc = 0;
+        for (int j = 0; j < AUDIO_CONVERT_HALFBAND_SIDE; j++) {
+            acc += audio_convert_halfband[j] * ((int32_t)w[8 + j] + w[7 - j]);
+        }
+        /* The zero stuffed input has half the energy, hence the gain of 2 */
+        dst[2 * k] = audio_convert_sat16((acc + (1 << 13)) >> 14);
+        dst[2 * k + 1] = w[8];
+    }
+}
+
+/* Keep the newest history_len samples of the history followed by src */
+static void audio_convert_update_history(int16_t *history, size_t history_len, const int16_t *src, size_t frames)
+{
+    if (frames >= history_len) {
+        memcpy(history, src + frames - history_len, history_len * sizeof(int16_t));
+    } else {
+        memmove(history, history + frames, (history_len - frames) * sizeof(int16_t));
+        memcpy(history + history_len - frames, src, frames * sizeof(int16_t));
+    }
+}
+
+/* The gain is at most 2^15, so the product of a 16-bit sample fits in 32 bits */
+static inline int16_t audio_convert_mix_sample_s16(int32_t src, int32_t dst, int32_t gain)
+{
+    return audio_convert_sat16(dst + ((src * gain) >> 15));
+}
+
+void audio_convert_mix_s16_ref(const int16_t *src, int16_t *dst, size_t samples, int32_t gain)
+{
+    for (size_t i = 0; i < samples; i++) {
+        dst[i] = audio_convert_mix_sample_s16(src[i], dst[i], gain);
+    }
+}
+
+void audio_convert_mix_s16(const int16_t *src, int16_t *dst, size_t samples, int32_t gain)
+{
+    size_t i = 0;
+
+    if (gain == 0) {
+        return;
+    }
+
+    /* Two samples per 32-bit load and store of each buffer */
+    if (audio_convert_is_aligned(src, sizeof(uint32_t)) && audio_convert_is_aligned(dst, sizeof(uint32_t))) {
+        const audio_convert_word_t *src32 = (const audio_convert_word_t *)src;
+        audio_convert_word_t *dst32 = (audio_convert_word_t *)dst;
+        for (; i + AUDIO_CONVERT_UNROLL <= samples; i += AUDIO_CONVERT_UNROLL) {
+            uint32_t s0 = src32[i / 2];
+            uint32_t s1 = src32[i / 2 + 1];
+            uint32_t d0 = dst32[i / 2];
+            uint32_t d1 = dst32[i / 2 + 1];
+            uint16_t m0 = (uint16_t)audio_convert_mix_sample_s16((int16_t)s0, (int16_t)d0, gain);
+            uint16_t m1 = (uint16_t)audio_convert_mix_sample_s16((int32_t)s0 >> 16, (int32_t)d0 >> 16, gain);
+            uint16_t m2 = (uint16_t)audio_convert_mix_sample_s16((int16_t)s1, (int16_t)d1, gain);
+            uint16_t m3 = (uint16_t)audio_convert_mix_sample_s16((int32_t)s1 >> 16, (int32_t)d1 >> 16, gain);
+            dst32[i / 2] = m0 | ((uint32_t)m1 << 16);
+            dst32[i / 2 + 1] = m2 | ((uint32_t)m3 << 16);
+        }
+    }
+
+    audio_convert_mix_s16_ref(src + i, dst + i, samples - i, gain);
+}
+
+void audio_convert_mix_s32_ref(const int32_t *src, int32_t *dst, size_t samples, int32_t gain)
+{
+    for (size_t i = 0; i < samples; i++) {
+        dst[i] = audio_convert_sat32((int64_t)dst[i] + (((int64_t)src[i] * gain) >> 15));
+    }
+}
+
+void audio_convert_mix_s32(const int32_t *src, int32_t *dst, size_t samples, int32_t gain)
+{
+    size_t i = 0;
+
+    if (gain == 0) {
+        return;
+    }
+
+    /* At unity gain the 64-bit products are skipped, (src * 2^15) >> 15 is src */
+    if (gain == AUDIO_CONVERT_GAIN_UNITY) {
+        for (; i + AUDIO_CONVERT_UNROLL <= samples; i += AUDIO_CONVERT_UNROLL) {
+            dst[i] = audio_convert_sat32((int64_t)dst[i] + src[i]);
+            dst[i + 1] = audio_convert_sat32((int64_t)dst[i + 1] + src[i + 1]);
+            dst[i + 2] = audio_convert_sat32((int64_t)dst[i + 2] + src[i + 2]);
+            dst[i + 3] = audio_convert_sat32((int64_t)dst[i + 3] + src[i + 3]);
+        }
+    } else {
+        for (; i + AUDIO_CONVERT_UNROLL <= samples; i += AUDIO_CONVERT_UNROLL) {
+            for (int k = 0; k < AUDIO_CONVERT_UNROLL; k++) {
+                dst[i + k] = audio_convert_sat32((int64_t)dst[i + k] + (((int64_t)src[i + k] * gain) >> 15));
+            }
+        }
+    }
+
+    audio_convert_mix_s32_ref(src + i, dst + i, samples - i, gain);
+}
+
+void audio_convert_resampler_reset(audio_convert_resampler_t *resampler)
+{
+    memset(resampler->history, 0, sizeof(resampler->history));
+}
+
+size_t audio_convert_downsample_2x(audio_convert_resampler_t *resampler, const int16_t *src, int16_t *dst, size_t frames)
+{
+    const size_t history_len = AUDIO_CONVERT_HALFBAND_TAPS - 1;
+    frames &= ~(size_t)1;
+
+    /* The first outputs reach into the history, run them on a joined copy */
+    int16_t edge[2 * (AUDIO_CONVERT_HALFBAND_TAPS - 1)];
+    size_t edge_frames = (frames < history_len) ? frames : history_len;
+    memcpy(edge, resampler->history, history_len * sizeof(int16_t));
+    memcpy(edge + history_len, src, edge_frames * sizeof(int16_t));
+    audio_convert_decimate_block(edge + 1, dst, edge_frames / 2);
+
+    /* The rest straight from the input */
+    if (frames > edge_frames) {
+        audio_convert_decimate_block(src + edge_frames - history_len + 1, dst + edge_frames / 2, (frames - edge_frames) / 2);
+    }
+
+    audio_convert_update_history(resampler->history, history_len, src, frames);
+    return frames / 2;
+}
+
+size_t audio_convert_upsample_2x(audio_convert_resampler_t *resampler, const int16_t *src, int16_t *dst, size_t frames)
+{
+    const size_t history_len = (AUDIO_CONVERT_HALFBAND_TAPS - 1) / 2;
+
+    int16_t edge[2 * ((AUDIO_CONVERT_HALFBAND_TAPS - 1) / 2)];
+    size_t edge_frames = (frames < history_len) ? frames : history_len;
+    memcpy(edge, resampler->history, history_len * sizeof(int16_t));
+    memcpy(edge + history_len, src, edge_frames * sizeof(int16_t));
+    audio_convert_interpolate_block(edge, dst, edge_frames);
+
+    if (frames > edge_frames) {
+        audio_convert_interpolate_block(src + edge_frames - history_len, dst + 2 * edge_frames, frames - edge_frames);
+    }
+
+    audio_convert_update_history(resampler->history, history_len, src, frames);
+    return 2 * frames;
+}
+
+/* Full 31-tap convolution over the history followed by src, for checking the polyphase versions */
+static int32_t audio_convert_halfband_tap(int n)
+{
+    int offset = n - (AUDIO_CONVERT_HALFBAND_TAPS - 1) / 2;
+    if (offset == 0) {
+        return 1 << 14;
+    } else if ((offset & 1) == 0) {
+        return 0;
+    }
+    return audio_convert_halfband[(abs(offset) - 1) / 2];
+}
+
+size_t audio_convert_downsample_2x_ref(audio_convert_resampler_t *resampler, const int16_t *src, int16_t *dst, size_t frames)
+{
+    const int history_len = AUDIO_CONVERT_HALFBAND_TAPS - 1;
+    frames &= ~(size_t)1;
+
+    for (size_t k = 0; k < frames / 2; k++) {
+        int newest = 2 * (int)k + 1;
+        int32_t acc = 0;
+        for (int n = 0; n < AUDIO_CONVERT_HALFBAND_TAPS; n++) {
+            int index = newest - n;
+            int16_t sample = (index < 0) ? resampler->history[history_len + index] : src[index];
+            acc += audio_convert_halfband_tap(n) * sample;
+        }
+        dst[k] = audio_convert_sat16((acc + (1 << 14)) >> 15);
+    }
+
+    audio_convert_update_history(resampler->history, history_len, src, frames);
+    return frames / 2;
+}
+
+size_t audio_convert_upsample_2x_ref(audio_convert_resampler_t *resampler, const int16_t *src, int16_t *dst, size_t frames)
+{
+    const int history_len = (AUDIO_CONVERT_HALFBAND_TAPS - 1) / 2;
+
+    /* Zero stuffed input u[2i] = x[i], filtered with 2 * h */
+    for (int out = 0; out < 2 * (int)frames; out++) {
+        int32_t acc = 0;
+        for (int n = 0; n < AUDIO_CONVERT_HALFBAND_TAPS; n++) {
+            int u_index = out - n;
+            if (u_index & 1) {
+                continue;
+            }
+            int index = u_index / 2;
+            int16_t sample = (index < 0) ? resampler->history[history_len + index] : src[index];
+            acc += audio_convert_halfband_tap(n) * sample;
+        }
+        dst[out] = audio_convert_sat16((acc + (1 << 13)) >> 14);
+    }
+
+    audio_convert_update_history(resampler->history, history_len, src, frames);
+    return 2 * frames;
+}
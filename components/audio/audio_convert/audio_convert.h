@@ -0,0 +1,137 @@
+/**
+ * SPDX-FileCopyrightText: 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef __AUDIO_CONVERT_H__
+#define __AUDIO_CONVERT_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Input samples kept between calls by a resampler */
+#define AUDIO_CONVERT_RESAMPLER_HISTORY 30
+
+/* Gain of the mix kernels that leaves the input unchanged, Q15 */
+#define AUDIO_CONVERT_GAIN_UNITY 32768
+
+/**
+ * @brief State of a 2x resampler
+ *
+ * One instance per stream and direction. Zero initialized or reset with audio_convert_resampler_reset().
+ */
+typedef struct {
+    int16_t history[AUDIO_CONVERT_RESAMPLER_HISTORY];
+} audio_convert_resampler_t;
+
+/*
+ * Expansion of the 16-bit mono audio of the pipelines to the interleaved stereo the
+ * output device is opened with, 2x sample rate conversion (e.g. 16 kHz <-> 8 kHz),
+ * and saturating mixing of streams.
+ *
+ * Each kernel has an unrolled version, processing several frames per iteration with
+ * word-sized loads and stores, and a scalar reference version (_ref) with the exact
+ * same output. The unrolled versions fall back to the scalar code for the tail.
+ * src and dst must not overlap.
+ */
+
+/**
+ * @brief Expand 16-bit mono to interleaved 32-bit stereo
+ *
+ * Each input sample is copied to both channels, in the upper 16 bits.
+ *
+ * @param src Mono input, frames samples
+ * @param dst Interleaved stereo output, 2 * frames samples
+ * @param frames Number of frames
+ */
+void audio_convert_s16_mono_to_s32_stereo(const int16_t *src, int32_t *dst, size_t frames);
+
+void audio_convert_s16_mono_to_s32_stereo_ref(const int16_t *src, int32_t *dst, size_t frames);
+
+/**
+ * @brief Expand 16-bit mono to interleaved 16-bit stereo
+ *
+ * @param src Mono input, frames samples
+ * @param dst Interleaved stereo output, 2 * frames samples
+ * @param frames Number of frames
+ */
+void audio_convert_s16_mono_to_s16_stereo(const int16_t *src, int16_t *dst, size_t frames);
+
+void audio_convert_s16_mono_to_s16_stereo_ref(const int16_t *src, int16_t *dst, size_t frames);
+
+/**
+ * @brief Add src, scaled by gain, to dst with saturation
+ *
+ * Used to mix several streams of the same format into one buffer. Every sample is
+ * (src * gain) >> 15, added to dst and clamped to the 16-bit range.
+ *
+ * @param src Input, samples samples
+ * @param dst Accumulated output, samples samples
+ * @param samples Number of samples across all channels
+ * @param gain Gain in Q15, 0 to AUDIO_CONVERT_GAIN_UNITY
+ */
+void audio_convert_mix_s16(const int16_t *src, int16_t *dst, size_t samples, int32_t gain);
+
+void audio_convert_mix_s16_ref(const int16_t *src, int16_t *dst, size_t samples, int32_t gain);
+
+/**
+ * @brief Add src, scaled by gain, to dst with saturation, for 32-bit samples
+ *
+ * @param src Input, samples samples
+ * @param dst Accumulated output, samples samples
+ * @param samples Number of samples across all channels
+ * @param gain Gain in Q15, 0 to AUDIO_CONVERT_GAIN_UNITY
+ */
+void audio_convert_mix_s32(const int32_t *src, int32_t *dst, size_t samples, int32_t gain);
+
+void audio_convert_mix_s32_ref(const int32_t *src, int32_t *dst, size_t samples, int32_t gain);
+
+/**
+ * @brief Clear the history of a resampler, e.g. at the start of a new stream
+ *
+ * @param resampler The resampler
+ */
+void audio_convert_resampler_reset(audio_convert_resampler_t *resampler);
+
+/**
+ * @brief Halve the sample rate of 16-bit mono audio
+ *
+ * Polyphase 31-tap half-band FIR: flat to 0.2 fs (-0.3 dB), -70 dB from 0.35 fs,
+ * 15 input samples of delay. Only the odd taps are multiplied, each coefficient once.
+ *
+ * @param resampler Resampler state
+ * @param src Input, frames samples
+ * @param dst Output, frames / 2 samples
+ * @param frames Number of input samples, must be even
+ * @return Number of output samples
+ */
+size_t audio_convert_downsample_2x(audio_convert_resampler_t *resampler, const int16_t *src, int16_t *dst, size_t frames);
+
+size_t audio_convert_downsample_2x_ref(audio_convert_resampler_t *resampler, const int16_t *src, int16_t *dst, size_t frames);
+
+/**
+ * @brief Double the sample rate of 16-bit mono audio
+ *
+ * Same half-band filter as audio_convert_downsample_2x(). Every other output sample is
+ * an input sample, the ones in between are interpolated by a 16-tap polyphase branch.
+ *
+ * @param resampler Resampler state
+ * @param src Input, frames samples
+ * @param dst Output, 2 * frames samples
+ * @param frames Number of input samples
+ * @return Number of output samples
+ */
+size_t audio_convert_upsample_2x(audio_convert_resampler_t *resampler, const int16_t *src, int16_t *dst, size_t frames);
+
+size_t audio_convert_upsample_2x_ref(audio_convert_resampler_t *resampler, const int16_t *src, int16_t *dst, size_t frames);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __AUDIO_CONVERT_H__ */
@@ -0,0 +1,484 @@
+/**
+ * SPDX-FileCopyrightText: 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+
+#include "audio_jitter_buffer.h"
+
+static const char *TAG = "audio_jitter_buffer";
+
+/* Packets buffered at once */
+#define JITTER_BUFFER_SLOTS 64
+
+/* The target depth is one packet plus this many times the jitter */
+#define JITTER_BUFFER_TARGET_JITTER_FACTOR 3
+
+/* The underrun boost fades by 1/64 per packet played */
+#define JITTER_BUFFER_BOOST_DECAY_SHIFT 6
+
+/* Frames concealed in a row while starved before playout waits for the target depth again */
+#define JITTER_BUFFER_MAX_CONCEAL_RUN 3
+
+typedef enum {
+    JITTER_BUFFER_STATE_BUFFERING,
+    JITTER_BUFFER_STATE_PLAYING,
+} jitter_buffer_state_t;
+
+typedef struct {
+    uint8_t *data;
+    size_t len;
+    audio_playback_free_cb_t free_cb;
+    void *free_ctx;
+    uint32_t duration_us;
+    bool used;
+    bool is_last;
+    bool is_mark;
+} jitter_buffer_slot_t;
+
+struct audio_jitter_buffer {
+    SemaphoreHandle_t lock;
+    SemaphoreHandle_t data_sem;         /* Given on every put */
+    SemaphoreHandle_t space_sem;        /* Given on every get */
+    jitter_buffer_slot_t slots[JITTER_BUFFER_SLOTS];    /* Ring in write order */
+    jitter_buffer_state_t state;
+    uint32_t next_get;                  /* Number of the next packet to play */
+    uint32_t next_put;                  /* Number of the next packet written */
+    uint16_t count;
+    size_t filled_bytes;
+    uint32_t filled_us;
+    uint32_t min_latency_us;
+    uint32_t max_latency_us;
+    int64_t spurt_start_us;             /* Arrival of the first packet buffered for playout */
+    int64_t starved_us;                 /* Time the buffer ran dry while playing, 0 if it did not */
+    int64_t due_us;                     /* Time the next packet is due at the output while playing */
+    uint16_t conceal_run;               /* Frames concealed since the last packet was taken */
+    bool have_last_arrival;
+    int64_t last_arrival_us;
+    uint32_t duration_us;               /* Duration of the last packet added */
+    uint32_t jitter_us;                 /* Smoothed lateness of arrivals, RFC 3550 style */
+    uint32_t boost_us;                  /* Extra depth after underruns */
+    audio_playback_jitter_stats_t stats;
+};
+
+static uint32_t jitter_buffer_target_us(struct audio_jitter_buffer *jb, uint32_t duration_us)
+{
+    uint32_t target = duration_us + JITTER_BUFFER_TARGET_JITTER_FACTOR * jb->jitter_us + jb->boost_us;
+    if (target < jb->min_latency_us) {
+        target = jb->min_latency_us;
+    }
+    if (target > jb->max_latency_us) {
+        target = jb->max_latency_us;
+    }
+    return target;
+}
+
+/* Update the jitter from the arrival of a packet, called with the lock held */
+static void jitter_buffer_track_arrival(struct audio_jitter_buffer *jb, uint32_t duration_us, int64_t now)
+{
+    if (jb->have_last_arrival) {
+        int64_t late_us = (now - jb->last_arrival_us) - duration_us;
+        /* Only late arrivals count: servers send speech in bursts ahead of real time, which needs no extra depth */
+        if (late_us < 0) {
+            late_us = 0;
+        }
+        if (late_us > jb->max_latency_us) {
+            late_us = jb->max_latency_us;
+        }
+        jb->jitter_us += ((int32_t)late_us - (int32_t)jb->jitter_us) / 16;
+    }
+    jb->have_last_arrival = true;
+    jb->last_arrival_us = now;
+}
+
+static inline bool jitter_buffer_full(struct audio_jitter_buffer *jb, uint32_t duration_us)
+{
+    return jb->filled_us + duration_us > jb->max_latency_us || jb->count >= JITTER_BUFFER_SLOTS;
+}
+
+/* A packet of duration_us was handed to the output, which runs dry at due_us unless fed in time */
+static void jitter_buffer_advance_due(struct audio_jitter_buffer *jb, uint32_t duration_us)
+{
+    int64_t now = esp_timer_get_time();
+    jb->due_us = ((jb->due_us > now) ? jb->due_us : now) + duration_us;
+}
+
+/* Wait for a semaphore with the lock released */
+static bool jitter_buffer_wait(struct audio_jitter_buffer *jb, SemaphoreHandle_t sem, TickType_t ticks)
+{
+    xSemaphoreGive(jb->lock);
+    bool signaled = xSemaphoreTake(sem, ticks) == pdTRUE;
+    xSemaphoreTake(jb->lock, portMAX_DELAY);
+    return signaled;
+}
+
+static void jitter_buffer_free_data(uint8_t *data, audio_playback_free_cb_t free_cb, void *free_ctx)
+{
+    if (free_cb) {
+        free_cb(data, free_ctx);
+    } else {
+        free(data);
+    }
+}
+
+/*
+ * Queue a packet. With copy set the data is copied, otherwise the buffer is owned from here on
+ * and handed to free_cb once played or dropped.
+ */
+static esp_err_t jitter_buffer_insert(struct audio_jitter_buffer *jb, uint8_t *data, size_t len, bool copy,
+                                      audio_playback_free_cb_t free_cb, void *free_ctx, uint32_t duration_us,
+                                      bool is_last, bool is_mark, TickType_t timeout)
+{
+    bool is_audio = !is_last && !is_mark;
+    TickType_t start = xTaskGetTickCount();
+    int64_t now = esp_timer_get_time();
+    esp_err_t err = ESP_OK;
+
+    xSemaphoreTake(jb->lock, portMAX_DELAY);
+
+    if (jb->state == JITTER_BUFFER_STATE_BUFFERING && jb->count == 0) {
+        /* New talkspurt */
+        if (jb->starved_us && is_audio) {
+            uint32_t gap_us = (uint32_t)(now - jb->starved_us);
+            if (gap_us <= jb->max_latency_us) {
+                /* The stream went on, more depth would have covered the gap */
+                jb->stats.underruns++;
+                jb->boost_us += gap_us;
+                if (jb->boost_us > jb->max_latency_us) {
+                    jb->boost_us = jb->max_latency_us;
+                }
+            }
+            jb->starved_us = 0;
+        }
+        jb->spurt_start_us = now;
+    }
+
+    if (!is_audio) {
+        /* The silence until the next talkspurt is no lateness */
+        jb->have_last_arrival = false;
+    } else {
+        jitter_buffer_track_arrival(jb, duration_us, now);
+        jb->duration_us = duration_us;
+    }
+
+    /* Block while the maximum latency or all slots are used up */
+    while (jb->count > 0 && jitter_buffer_full(jb, duration_us)) {
+        TickType_t elapsed = xTaskGetTickCount() - start;
+        if (elapsed >= timeout) {
+            jb->stats.discarded++;
+            err = ESP_ERR_TIMEOUT;
+            goto drop;
+        }
+        jitter_buffer_wait(jb, jb->space_sem, timeout - elapsed);
+    }
+
+    if (copy && len > 0) {
+        uint8_t *data_copy = (uint8_t *)malloc(len);
+        if (data_copy == NULL) {
+            xSemaphoreGive(jb->lock);
+            ESP_LOGE(TAG, "Failed to allocate %d bytes packet", len);
+            return ESP_ERR_NO_MEM;
+        }
+        memcpy(data_copy, data, len);
+        data = data_copy;
+        free_cb = NULL;
+        free_ctx = NULL;
+    }
+
+    jb->slots[jb->next_put % JITTER_BUFFER_SLOTS] = (jitter_buffer_slot_t) {
+        .data = data,
+        .len = len,
+        .free_cb = free_cb,
+        .free_ctx = free_ctx,
+        .duration_us = duration_us,
+        .used = true,
+        .is_last = is_last,
+        .is_mark = is_mark,
+    };
+    jb->count++;
+    jb->filled_bytes += len;
+    jb->filled_us += duration_us;
+    jb->next_put++;
+
+    xSemaphoreGive(jb->lock);
+    xSemaphoreGive(jb->data_sem);
+    return ESP_OK;
+
+drop:
+    xSemaphoreGive(jb->lock);
+    if (!copy && data) {
+        jitter_buffer_free_data(data, free_cb, free_ctx);
+    }
+    return err;
+}
+
+esp_err_t audio_jitter_buffer_put(audio_jitter_buffer_handle_t jb, const uint8_t *data, size_t len, uint32_t duration_us,
+                                  TickType_t timeout)
+{
+    if (jb == NULL || data == NULL || len == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return jitter_buffer_insert(jb, (uint8_t *)data, len, true, NULL, NULL, duration_us, false, false, timeout);
+}
+
+esp_err_t audio_jitter_buffer_put_ref(audio_jitter_buffer_handle_t jb, uint8_t *data, size_t len, uint32_t duration_us,
+                                      audio_playback_free_cb_t free_cb, void *free_ctx, TickType_t timeout)
+{
+    if (jb == NULL || data == NULL || len == 0) {
+        if (data) {
+            jitter_buffer_free_data(data, free_cb, free_ctx);
+        }
+        return ESP_ERR_INVALID_ARG;
+    }
+    return jitter_buffer_insert(jb, data, len, false, free_cb, free_ctx, duration_us, false, false, timeout);
+}
+
+esp_err_t audio_jitter_buffer_put_end(audio_jitter_buffer_handle_t jb, TickType_t timeout)
+{
+    if (jb == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return jitter_buffer_insert(jb, NULL, 0, true, NULL, NULL, 0, true, false, timeout);
+}
+
+esp_err_t audio_jitter_buffer_put_mark(audio_jitter_buffer_handle_t jb, TickType_t timeout)
+{
+    if (jb == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return jitter_buffer_insert(jb, NULL, 0, true, NULL, NULL, 0, false, true, timeout);
+}
+
+esp_err_t audio_jitter_buffer_get(audio_jitter_buffer_handle_t jb, audio_jitter_buffer_packet_t *packet, TickType_t timeout)
+{
+    if (jb == NULL || packet == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    TickType_t start = xTaskGetTickCount();
+    xSemaphoreTake(jb->lock, portMAX_DELAY);
+
+    while (true) {
+        TickType_t elapsed = xTaskGetTickCount() - start;
+        TickType_t wait = (elapsed < timeout) ? timeout - elapsed : 0;
+
+        if (jb->state == JITTER_BUFFER_STATE_BUFFERING && jb->count > 0) {
+            const jitter_buffer_slot_t *first = &jb->slots[jb->next_get % JITTER_BUFFER_SLOTS];
+            uint32_t target_us = jitter_buffer_target_us(jb, first->used ? first->duration_us : 0);
+            int64_t waited_us = esp_timer_get_time() - jb->spurt_start_us;
+            const jitter_buffer_slot_t *last = &jb->slots[(jb->next_put - 1) % JITTER_BUFFER_SLOTS];
+            bool end_queued = last->used && (last->is_last || last->is_mark);
+            if (jb->filled_us >= target_us || waited_us >= target_us || end_queued) {
+                jb->state = JITTER_BUFFER_STATE_PLAYING;
+                jb->due_us = esp_timer_get_time();
+                ESP_LOGD(TAG, "Playout started: %" PRIu32 " ms buffered, target %" PRIu32 " ms",
+                         jb->filled_us / 1000, target_us / 1000);
+            } else {
+                /* Woken early by new packets, which may fill the target first */
+                TickType_t deadline = pdMS_TO_TICKS((target_us - waited_us + 999) / 1000);
+                wait = (deadline == 0) ? 1 : (deadline < wait ? deadline : wait);
+            }
+        }
+
+        if (jb->state == JITTER_BUFFER_STATE_PLAYING) {
+            jitter_buffer_slot_t *slot = &jb->slots[jb->next_get % JITTER_BUFFER_SLOTS];
+            if (jb->count > 0) {
+                *packet = (audio_jitter_buffer_packet_t) {
+                    .data = slot->data,
+                    .len = slot->len,
+                    .free_cb = slot->free_cb,
+                    .free_ctx = slot->free_ctx,
+                    .is_last = slot->is_last,
+                    .is_mark = slot->is_mark,
+                };
+                uint32_t slot_duration_us = slot->duration_us;
+                jb->count--;
+                jb->filled_bytes -= slot->len;
+                jb->filled_us -= slot->duration_us;
+                jb->next_get++;
+                *slot = (jitter_buffer_slot_t) {0};
+                if (packet->is_last || packet->is_mark) {
+                    /* Expected end, not an underrun */
+                    jb->state = JITTER_BUFFER_STATE_BUFFERING;
+                    jb->starved_us = 0;
+                } else {
+                    if (jb->conceal_run > 0) {
+                        jb->stats.late++;
+                    }
+                    jitter_buffer_advance_due(jb, slot_duration_us);
+                    jb->stats.packets++;
+                    jb->boost_us -= jb->boost_us >> JITTER_BUFFER_BOOST_DECAY_SHIFT;
+                }
+                jb->conceal_run = 0;
+                xSemaphoreGive(jb->lock);
+                xSemaphoreGive(jb->space_sem);
+                return ESP_OK;
+            }
+
+            /*
+             * Nothing to play. Over the websocket a packet is never lost, only late, so the
+             * output is kept going with a concealed frame once it holds less than a frame, and
+             * the late packets play in full when they come. This delays the rest of the
+             * talkspurt by the concealed frames. A stream that stays dry for longer is an
+             * underrun: playout waits for the target depth again, which the late arrivals raised.
+             */
+            int64_t now = esp_timer_get_time();
+            if (jb->conceal_run < JITTER_BUFFER_MAX_CONCEAL_RUN) {
+                int64_t left_us = jb->due_us - jb->duration_us - now;
+                if (left_us <= 0) {
+                    *packet = (audio_jitter_buffer_packet_t) {
+                        .is_gap = true,
+                    };
+                    jitter_buffer_advance_due(jb, jb->duration_us);
+                    jb->conceal_run++;
+                    xSemaphoreGive(jb->lock);
+                    return ESP_OK;
+                }
+                TickType_t deadline = pdMS_TO_TICKS((left_us + 999) / 1000);
+                wait = (deadline == 0) ? 1 : (deadline < wait ? deadline : wait);
+            } else {
+                jb->state = JITTER_BUFFER_STATE_BUFFERING;
+                jb->starved_us = now;
+                jb->conceal_run = 0;
+            }
+        }
+
+        if (wait == 0) {
+            break;
+        }
+        jitter_buffer_wait(jb, jb->data_sem, wait);
+    }
+
+    xSemaphoreGive(jb->lock);
+    return ESP_ERR_TIMEOUT;
+}
+
+void audio_jitter_buffer_release(audio_jitter_buffer_handle_t jb, audio_jitter_buffer_packet_t *packet)
+{
+    if (packet) {
+        if (packet->data) {
+            jitter_buffer_free_data(packet->data, packet->free_cb, packet->free_ctx);
+        }
+        packet->data = NULL;
+        packet->len = 0;
+    }
+}
+
+void audio_jitter_buffer_flush(audio_jitter_buffer_handle_t jb)
+{
+    /* Markers are kept in order, 1 for end of stream and 2 for a mark */
+    uint8_t markers[JITTER_BUFFER_SLOTS];
+    uint16_t num_markers = 0;
+
+    xSemaphoreTake(jb->lock, portMAX_DELAY);
+    for (uint32_t n = jb->next_get; jb->count > 0 && n != jb->next_put; n++) {
+        const jitter_buffer_slot_t *slot = &jb->slots[n % JITTER_BUFFER_SLOTS];
+        if (slot->is_last || slot->is_mark) {
+            markers[num_markers++] = slot->is_last ? 1 : 2;
+        }
+    }
+    for (int i = 0; i < JITTER_BUFFER_SLOTS; i++) {
+        jitter_buffer_slot_t *slot = &jb->slots[i];
+        if (slot->data) {
+            jitter_buffer_free_data(slot->data, slot->free_cb, slot->free_ctx);
+        }
+        *slot = (jitter_buffer_slot_t) {0};
+    }
+    for (uint16_t i = 0; i < num_markers; i++) {
+        uint32_t n = jb->next_get + i;
+        jb->slots[n % JITTER_BUFFER_SLOTS] = (jitter_buffer_slot_t) {
+            .used = true,
+            .is_last = markers[i] == 1,
+            .is_mark = markers[i] == 2,
+        };
+    }
+    jb->next_put = jb->next_get + num_markers;
+    jb->count = num_markers;
+    jb->filled_bytes = 0;
+    jb->filled_us = 0;
+    /* The next packet starts a new talkspurt, the gap is not an underrun */
+    jb->state = JITTER_BUFFER_STATE_BUFFERING;
+    jb->starved_us = 0;
+    jb->conceal_run = 0;
+    jb->have_last_arrival = false;
+    xSemaphoreGive(jb->lock);
+    xSemaphoreGive(jb->space_sem);
+    if (num_markers > 0) {
+        xSemaphoreGive(jb->data_sem);
+    }
+}
+
+size_t audio_jitter_buffer_filled_bytes(audio_jitter_buffer_handle_t jb)
+{
+    xSemaphoreTake(jb->lock, portMAX_DELAY);
+    size_t filled = jb->filled_bytes;
+    xSemaphoreGive(jb->lock);
+    return filled;
+}
+
+void audio_jitter_buffer_get_stats(audio_jitter_buffer_handle_t jb, audio_playback_jitter_stats_t *stats)
+{
+    xSemaphoreTake(jb->lock, portMAX_DELAY);
+    *stats = jb->stats;
+    stats->jitter_ms = jb->jitter_us / 1000;
+    stats->depth_ms = jb->filled_us / 1000;
+    stats->target_ms = jitter_buffer_target_us(jb, jb->duration_us) / 1000;
+    xSemaphoreGive(jb->lock);
+}
+
+esp_err_t audio_jitter_buffer_create(uint32_t min_latency_ms, uint32_t max_latency_ms, audio_jitter_buffer_handle_t *handle)
+{
+    if (handle == NULL || min_latency_ms > max_latency_ms) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    struct audio_jitter_buffer *jb = (struct audio_jitter_buffer *)calloc(1, sizeof(struct audio_jitter_buffer));
+    if (jb == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    jb->lock = xSemaphoreCreateMutex();
+    jb->data_sem = xSemaphoreCreateBinary();
+    jb->space_sem = xSemaphoreCreateBinary();
+    if (jb->lock == NULL || jb->data_sem == NULL || jb->space_sem == NULL) {
+        audio_jitter_buffer_destroy(jb);
+        return ESP_ERR_NO_MEM;
+    }
+
+    jb->state = JITTER_BUFFER_STATE_BUFFERING;
+    jb->min_latency_us = min_latency_ms * 1000;
+    jb->max_latency_us = max_latency_ms * 1000;
+
+    *handle = jb;
+    return ESP_OK;
+}
+
+void audio_jitter_buffer_destroy(audio_jitter_buffer_handle_t jb)
+{
+    if (jb == NULL) {
+        return;
+    }
+
+    for (int i = 0; i < JITTER_BUFFER_SLOTS; i++) {
+        if (jb->slots[i].data) {
+            jitter_buffer_free_data(jb->slots[i].data, jb->slots[i].free_cb, jb->slots[i].free_ctx);
+        }
+    }
+    if (jb->lock) {
+        vSemaphoreDelete(jb->lock);
+    }
+    if (jb->data_sem) {
+        vSemaphoreDelete(jb->data_sem);
+    }
+    if (jb->space_sem) {
+        vSemaphoreDelete(jb->space_sem);
+    }
+    free(jb);
+}
@@ -0,0 +1,515 @@
+/**
+ * SPDX-FileCopyrightText: 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+
+#include "audio_convert.h"
+#include "audio_mixer.h"
+
+static const char *TAG = "audio_mixer";
+
+/* A gain change is spread over this many steps of one period */
+#define MIXER_RAMP_STEPS 8
+
+#define MIXER_TASK_STACK_SIZE (1024 * 4)
+
+struct audio_mixer_source {
+    struct audio_mixer *mixer;
+    const char *name;
+    uint8_t *buf;                       /* Ring of queued audio */
+    size_t size;
+    size_t read_pos;
+    size_t filled;
+    size_t last_filled;                 /* filled when the mixer last looked at a source that is not playing */
+    uint32_t flush_count;               /* Incremented by every flush, ends writes in progress */
+    size_t flushed;                     /* Bytes queued before the last flush, faded out and skipped by the mixer */
+    bool flushing;                      /* A flush waits for the next period */
+    bool flush_done;                    /* Faded out this period, flushed_cb is due once it is written */
+    bool in_period;                     /* Has audio in the period being written */
+    int64_t end_us;                     /* Time the last audio of the source written to the device has played */
+    audio_mixer_flushed_cb_t flushed_cb;
+    void *flushed_ctx;
+    SemaphoreHandle_t space_sem;        /* Given when the mixer takes audio or the source is flushed */
+    volatile int32_t gain;              /* Q15 */
+    int32_t applied_gain;               /* Gain the last period ended with, Q15 */
+    bool ducks_others;
+    bool playing;                       /* Gave a full period last time, a source starting or running dry waits for one */
+    bool ready;
+};
+
+struct audio_mixer {
+    SemaphoreHandle_t lock;
+    SemaphoreHandle_t data_sem;         /* Given on every write */
+    SemaphoreHandle_t done_sem;         /* Given by the mixer task when it exits */
+    TaskHandle_t task;
+    volatile bool running;
+    esp_codec_dev_handle_t out_dev_handle;
+    uint32_t sample_rate;
+    uint8_t bits_per_sample;
+    size_t frame_bytes;
+    uint16_t period_ms;
+    int64_t period_us;
+    int64_t dev_buffer_us;
+    int64_t dev_end_us;                 /* Time the audio written to the device has played */
+    bool writing;                       /* A mixed period is being written */
+    TickType_t period_ticks;
+    size_t period_bytes;
+    int32_t duck_gain;                  /* Q15 */
+    uint8_t *mix_buf;                   /* One period in the device format */
+    uint8_t *src_buf;                   /* One period taken from a source */
+    struct audio_mixer_source sources[AUDIO_MIXER_MAX_SOURCES];
+    uint8_t source_count;
+};
+
+static inline int32_t mixer_gain_q15(uint8_t percent)
+{
+    if (percent > 100) {
+        percent = 100;
+    }
+    return (int32_t)percent * AUDIO_CONVERT_GAIN_UNITY / 100;
+}
+
+/* Whether a source plays this period. Called with the lock held */
+static bool mixer_source_ready(struct audio_mixer *mixer, struct audio_mixer_source *src, bool *waiting)
+{
+    if (src->filled == 0) {
+        src->playing = false;
+        return false;
+    }
+    if (src->playing || src->filled >= mixer->period_bytes) {
+        return true;
+    }
+    /* Less than a period after a start or an underrun: wait for more unless the writer has stopped */
+    if (src->filled != src->last_filled) {
+        src->last_filled = src->filled;
+        *waiting = true;
+        return false;
+    }
+    return true;
+}
+
+/* Drop len bytes of whole frames. Called with the lock held */
+static void mixer_source_skip(struct audio_mixer *mixer, struct audio_mixer_source *src, size_t len)
+{
+    len -= len % mixer->frame_bytes;
+    src->read_pos = (src->read_pos + len) % src->size;
+    src->filled -= len;
+    src->last_filled = src->filled;
+}
+
+/* Take up to len bytes of whole frames. Called with the lock held */
+static size_t mixer_source_read(struct audio_mixer *mixer, struct audio_mixer_source *src, uint8_t *dst, size_t len)
+{
+    if (len > src->filled) {
+        len = src->filled;
+    }
+    len -= len % mixer->frame_bytes;
+
+    size_t first = src->size - src->read_pos;
+    if (first > len) {
+        first = len;
+    }
+    memcpy(dst, src->buf + src->read_pos, first);
+    memcpy(dst + first, src->buf, len - first);
+    src->read_pos = (src->read_pos + len) % src->size;
+    src->filled -= len;
+    src->last_filled = src->filled;
+    return len;
+}
+
+static void mixer_mix_samples(struct audio_mixer *mixer, const uint8_t *src, size_t offset, size_t samples, int32_t gain)
+{
+    if (mixer->bits_per_sample == 32) {
+        audio_convert_mix_s32((const int32_t *)src + offset, (int32_t *)mixer->mix_buf + offset, samples, gain);
+    } else {
+        audio_convert_mix_s16((const int16_t *)src + offset, (int16_t *)mixer->mix_buf + offset, samples, gain);
+    }
+}
+
+/* Add len bytes of a source to the mix, its gain going from one value to another in steps */
+static void mixer_mix(struct audio_mixer *mixer, const uint8_t *src, size_t len, int32_t from_gain, int32_t to_gain)
+{
+    size_t channels = mixer->frame_bytes / (mixer->bits_per_sample / 8);
+    size_t frames = len / mixer->frame_bytes;
+
+    if (from_gain == to_gain) {
+        mixer_mix_samples(mixer, src, 0, frames * channels, to_gain);
+        return;
+    }
+    for (int step = 0; step < MIXER_RAMP_STEPS; step++) {
+        size_t start = frames * step / MIXER_RAMP_STEPS * channels;
+        size_t end = frames * (step + 1) / MIXER_RAMP_STEPS * channels;
+        int32_t gain = from_gain + (to_gain - from_gain) * (step + 1) / MIXER_RAMP_STEPS;
+        mixer_mix_samples(mixer, src, start, end - start, gain);
+    }
+}
+
+/*
+ * Mix one period into mix_buf. Returns false when no source had audio, with waiting set if a
+ * source has some but less than a period and the writer may still be adding to it.
+ */
+static bool mixer_mix_period(struct audio_mixer *mixer, bool *waiting)
+{
+    bool ducking = false;
+    bool mixed = false;
+
+    memset(mixer->mix_buf, 0, mixer->period_bytes);
+
+    xSemaphoreTake(mixer->lock, portMAX_DELAY);
+    uint8_t count = mixer->source_count;
+    for (uint8_t i = 0; i < count; i++) {
+        struct audio_mixer_source *src = &mixer->sources[i];
+        src->ready = src->flushing || mixer_source_ready(mixer, src, waiting);
+        if (src->ready && src->ducks_others) {
+            ducking = true;
+        }
+    }
+    xSemaphoreGive(mixer->lock);
+
+    for (uint8_t i = 0; i < count; i++) {
+        struct audio_mixer_source *src = &mixer->sources[i];
+        int32_t gain = src->gain;
+        if (ducking && !src->ducks_others) {
+            gain = (gain * mixer->duck_gain) >> 15;
+        }
+
+        size_t len = 0;
+        bool fade_out = false;
+        if (src->ready) {
+            xSemaphoreTake(mixer->lock, portMAX_DELAY);
+            if (src->flushing) {
+                /* One period of the flushed audio fades out, the rest is skipped; writes since the flush stay */
+                size_t flushed = src->flushed;
+                size_t fade = flushed < mixer->period_bytes ? flushed : mixer->period_bytes;
+                len = mixer_source_read(mixer, src, mixer->src_buf, fade);
+                mixer_source_skip(mixer, src, flushed - len);
+                src->flushed = 0;
+                src->flushing = false;
+                src->playing = false;
+                src->flush_done = true;
+                fade_out = true;
+            } else {
+                len = mixer_source_read(mixer, src, mixer->src_buf, mixer->period_bytes);
+                src->playing = len == mixer->period_bytes;
+            }
+            src->in_period = len > 0;
+            mixer->writing |= len > 0;
+            xSemaphoreGive(mixer->lock);
+            xSemaphoreGive(src->space_sem);
+        }
+        if (len > 0) {
+            mixer_mix(mixer, mixer->src_buf, len, src->applied_gain, fade_out ? 0 : gain);
+            mixed = true;
+        }
+        /* A source coming in starts at its level, without a ramp from the previous one */
+        src->applied_gain = gain;
+    }
+    return mixed;
+}
+
+/*
+ * Move the playout position past the period just written. The period plays once the DMA
+ * buffers in front of it have, which is never later than a full device buffer from now.
+ */
+static void mixer_update_played(struct audio_mixer *mixer, bool written)
+{
+    xSemaphoreTake(mixer->lock, portMAX_DELAY);
+    if (written) {
+        int64_t end_us = esp_timer_get_time() + mixer->dev_buffer_us;
+        if (mixer->dev_end_us + mixer->period_us > end_us) {
+            end_us = mixer->dev_end_us + mixer->period_us;
+        }
+        mixer->dev_end_us = end_us;
+    }
+    for (uint8_t i = 0; i < mixer->source_count; i++) {
+        struct audio_mixer_source *src = &mixer->sources[i];
+        if (src->in_period) {
+            src->in_period = false;
+            src->end_us = mixer->dev_end_us;
+        }
+    }
+    mixer->writing = false;
+    xSemaphoreGive(mixer->lock);
+}
+
+/* Report the flushes completed by the period just written */
+static void mixer_report_flushed(struct audio_mixer *mixer)
+{
+    for (uint8_t i = 0; i < mixer->source_count; i++) {
+        struct audio_mixer_source *src = &mixer->sources[i];
+        if (src->flush_done) {
+            src->flush_done = false;
+            if (src->flushed_cb) {
+                src->flushed_cb(src->flushed_ctx);
+            }
+        }
+    }
+}
+
+static void mixer_task(void *arg)
+{
+    struct audio_mixer *mixer = (struct audio_mixer *)arg;
+
+    while (mixer->running) {
+        bool waiting = false;
+        bool mixed = mixer_mix_period(mixer, &waiting);
+        if (mixed) {
+            /* Paced by the device: returns once the DMA buffers have room for the period */
+            esp_codec_dev_write(mixer->out_dev_handle, mixer->mix_buf, mixer->period_bytes);
+        }
+        mixer_update_played(mixer, mixed);
+        mixer_report_flushed(mixer);
+        if (!mixed) {
+            xSemaphoreTake(mixer->data_sem, waiting ? mixer->period_ticks : portMAX_DELAY);
+        }
+    }
+
+    xSemaphoreGive(mixer->done_sem);
+    vTaskDelete(NULL);
+}
+
+esp_err_t audio_mixer_create(const audio_mixer_config_t *config, audio_mixer_handle_t *handle)
+{
+    if (config == NULL || handle == NULL || config->out_dev_handle == NULL || config->out_codec_info.sample_rate == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    const esp_codec_dev_sample_info_t *info = &config->out_codec_info;
+    if (!(info->bits_per_sample == 16 && info->channel >= 1 && info->channel <= 2) &&
+            !(info->bits_per_sample == 32 && info->channel == 2)) {
+        ESP_LOGE(TAG, "Unsupported format: %d bits, %d channels", info->bits_per_sample, info->channel);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    struct audio_mixer *mixer = (struct audio_mixer *)calloc(1, sizeof(struct audio_mixer));
+    if (mixer == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    mixer->out_dev_handle = config->out_dev_handle;
+    mixer->sample_rate = info->sample_rate;
+    mixer->bits_per_sample = info->bits_per_sample;
+    mixer->frame_bytes = info->bits_per_sample / 8 * info->channel;
+    mixer->period_ms = config->period_ms ? config->period_ms : AUDIO_MIXER_PERIOD_MS_DEFAULT;
+    mixer->period_bytes = (size_t)mixer->sample_rate * mixer->period_ms / 1000 * mixer->frame_bytes;
+    mixer->period_us = (int64_t)mixer->period_ms * 1000;
+    mixer->dev_buffer_us = (int64_t)config->dev_buffer_ms * 1000;
+    mixer->period_ticks = pdMS_TO_TICKS(mixer->period_ms) ? pdMS_TO_TICKS(mixer->period_ms) : 1;
+    mixer->duck_gain = mixer_gain_q15(config->duck_percent);
+
+    mixer->lock = xSemaphoreCreateMutex();
+    mixer->data_sem = xSemaphoreCreateBinary();
+    mixer->done_sem = xSemaphoreCreateBinary();
+    mixer->mix_buf = (uint8_t *)malloc(mixer->period_bytes);
+    mixer->src_buf = (uint8_t *)malloc(mixer->period_bytes);
+    if (mixer->lock == NULL || mixer->data_sem == NULL || mixer->done_sem == NULL ||
+            mixer->mix_buf == NULL || mixer->src_buf == NULL) {
+        audio_mixer_destroy(mixer);
+        return ESP_ERR_NO_MEM;
+    }
+
+    mixer->running = true;
+    if (xTaskCreate(mixer_task, "audio_mixer", MIXER_TASK_STACK_SIZE, mixer, config->task_prio, &mixer->task) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create mixer task");
+        mixer->running = false;
+        mixer->task = NULL;
+        audio_mixer_destroy(mixer);
+        return ESP_ERR_NO_MEM;
+    }
+
+    ESP_LOGI(TAG, "Mixer started: %" PRIu32 " Hz, %d bits, %d channels, %d ms periods",
+             mixer->sample_rate, info->bits_per_sample, info->channel, mixer->period_ms);
+    *handle = mixer;
+    return ESP_OK;
+}
+
+void audio_mixer_destroy(audio_mixer_handle_t mixer)
+{
+    if (mixer == NULL) {
+        return;
+    }
+
+    if (mixer->task) {
+        mixer->running = false;
+        xSemaphoreGive(mixer->data_sem);
+        xSemaphoreTake(mixer->done_sem, portMAX_DELAY);
+        mixer->task = NULL;
+    }
+
+    for (uint8_t i = 0; i < mixer->source_count; i++) {
+        struct audio_mixer_source *src = &mixer->sources[i];
+        free(src->buf);
+        if (src->space_sem) {
+            vSemaphoreDelete(src->space_sem);
+        }
+    }
+    if (mixer->lock) {
+        vSemaphoreDelete(mixer->lock);
+    }
+    if (mixer->data_sem) {
+        vSemaphoreDelete(mixer->data_sem);
+    }
+    if (mixer->done_sem) {
+        vSemaphoreDelete(mixer->done_sem);
+    }
+    free(mixer->mix_buf);
+    free(mixer->src_buf);
+    free(mixer);
+}
+
+esp_err_t audio_mixer_add_source(audio_mixer_handle_t mixer, const audio_mixer_source_config_t *config,
+                                 audio_mixer_source_handle_t *source)
+{
+    if (mixer == NULL || config == NULL || source == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    size_t size = (size_t)mixer->sample_rate * config->buffer_ms / 1000 * mixer->frame_bytes;
+    if (size < mixer->period_bytes) {
+        size = mixer->period_bytes;
+    }
+    uint8_t *buf = (uint8_t *)malloc(size);
+    SemaphoreHandle_t space_sem = xSemaphoreCreateBinary();
+    if (buf == NULL || space_sem == NULL) {
+        free(buf);
+        if (space_sem) {
+            vSemaphoreDelete(space_sem);
+        }
+        return ESP_ERR_NO_MEM;
+    }
+
+    xSemaphoreTake(mixer->lock, portMAX_DELAY);
+    if (mixer->source_count == AUDIO_MIXER_MAX_SOURCES) {
+        xSemaphoreGive(mixer->lock);
+        ESP_LOGE(TAG, "No room for source %s", config->name ? config->name : "");
+        free(buf);
+        vSemaphoreDelete(space_sem);
+        return ESP_ERR_NO_MEM;
+    }
+    struct audio_mixer_source *src = &mixer->sources[mixer->source_count];
+    *src = (struct audio_mixer_source) {
+        .mixer = mixer,
+        .name = config->name,
+        .buf = buf,
+        .size = size,
+        .space_sem = space_sem,
+        .gain = mixer_gain_q15(config->gain_percent),
+        .applied_gain = mixer_gain_q15(config->gain_percent),
+        .ducks_others = config->ducks_others,
+        .flushed_cb = config->flushed_cb,
+        .flushed_ctx = config->flushed_ctx,
+    };
+    mixer->source_count++;
+    xSemaphoreGive(mixer->lock);
+
+    ESP_LOGI(TAG, "Source %s added: %d bytes buffer, %d%% gain%s", config->name ? config->name : "", size,
+             config->gain_percent, config->ducks_others ? ", ducks the others" : "");
+    *source = src;
+    return ESP_OK;
+}
+
+/* Wait for a semaphore with the lock released */
+static bool mixer_wait(struct audio_mixer *mixer, SemaphoreHandle_t sem, TickType_t ticks)
+{
+    xSemaphoreGive(mixer->lock);
+    bool signaled = xSemaphoreTake(sem, ticks) == pdTRUE;
+    xSemaphoreTake(mixer->lock, portMAX_DELAY);
+    return signaled;
+}
+
+esp_err_t audio_mixer_source_write(audio_mixer_source_handle_t source, const void *data, size_t len, TickType_t timeout)
+{
+    if (source == NULL || (data == NULL && len > 0)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    struct audio_mixer_source *src = source;
+    struct audio_mixer *mixer = src->mixer;
+    const uint8_t *in = (const uint8_t *)data;
+
+    xSemaphoreTake(mixer->lock, portMAX_DELAY);
+    uint32_t flush_count = src->flush_count;
+    while (len > 0 && src->flush_count == flush_count) {
+        size_t room = src->size - src->filled;
+        if (room == 0) {
+            if (!mixer_wait(mixer, src->space_sem, timeout)) {
+                xSemaphoreGive(mixer->lock);
+                return ESP_ERR_TIMEOUT;
+            }
+            continue;
+        }
+
+        size_t n = len < room ? len : room;
+        size_t write_pos = (src->read_pos + src->filled) % src->size;
+        size_t first = src->size - write_pos;
+        if (first > n) {
+            first = n;
+        }
+        memcpy(src->buf + write_pos, in, first);
+        memcpy(src->buf, in + first, n - first);
+        src->filled += n;
+        in += n;
+        len -= n;
+        xSemaphoreGive(mixer->data_sem);
+    }
+    xSemaphoreGive(mixer->lock);
+    return ESP_OK;
+}
+
+void audio_mixer_source_flush(audio_mixer_source_handle_t source)
+{
+    if (source == NULL) {
+        return;
+    }
+
+    struct audio_mixer_source *src = source;
+    struct audio_mixer *mixer = src->mixer;
+
+    /* The mixer fades the queued audio out over its next period and skips the rest, cutting it would click */
+    xSemaphoreTake(mixer->lock, portMAX_DELAY);
+    src->flushed = src->filled;
+    src->flushing = true;
+    src->flush_count++;
+    xSemaphoreGive(mixer->lock);
+    xSemaphoreGive(src->space_sem);
+    xSemaphoreGive(mixer->data_sem);
+}
+
+int64_t audio_mixer_source_played_at(audio_mixer_source_handle_t source)
+{
+    if (source == NULL) {
+        return 0;
+    }
+
+    struct audio_mixer_source *src = source;
+    struct audio_mixer *mixer = src->mixer;
+    int64_t now = esp_timer_get_time();
+
+    xSemaphoreTake(mixer->lock, portMAX_DELAY);
+    int64_t played_us = src->end_us;
+    if (src->filled > 0 || src->in_period) {
+        /* Queued audio goes out behind what the device still has, or a full device buffer once it ran dry */
+        played_us = mixer->dev_end_us > now ? mixer->dev_end_us : now + mixer->dev_buffer_us;
+        if (mixer->writing) {
+            played_us += mixer->period_us;
+        }
+        played_us += (int64_t)(src->filled / mixer->frame_bytes) * 1000000 / mixer->sample_rate;
+    }
+    xSemaphoreGive(mixer->lock);
+    return played_us;
+}
+
+void audio_mixer_source_set_gain(audio_mixer_source_handle_t source, uint8_t gain_percent)
+{
+    if (source) {
+        source->gain = mixer_gain_q15(gain_percent);
+    }
+}
@@ -8,61 +8,269 @@
 
 #include <string.h>
 #include <esp_log.h>
+#include <esp_check.h>
+#include <esp_timer.h>
 
 #include <esp_gmf_pool.h>
 #include <esp_gmf_pipeline.h>
 #include <esp_gmf_data_bus.h>
-#include <esp_gmf_new_databus.h>
 #include <esp_gmf_io_embed_flash.h>
 #include <esp_audio_simple_player.h>
 #include <esp_audio_simple_player_advance.h>
 
 #include <esp_gmf_rate_cvt.h>
-#include <esp_gmf_bit_cvt.h>
-#include <esp_gmf_ch_cvt.h>
-#include <esp_gmf_audio_dec.h>
+#include <esp_audio_dec.h>
 #include <esp_opus_dec.h>
 
 #include "audio_common.h"
+#include "audio_convert.h"
+#include "audio_jitter_buffer.h"
+#include "audio_mixer.h"
 #include "audio_playback.h"
 
 static const char *TAG = "audio_playback";
 
-#define AUDIO_PLAYBACK_FIFO_BLOCK_COUNT 5
-#define AUDIO_PLAYBACK_FIFO_BLOCK_SIZE 512  // Block size for OPUS data
+/* Time a write waits for room in the jitter buffer before the packet is dropped */
+#define AUDIO_PLAYBACK_WRITE_TIMEOUT_MS 100
+
+/* Audio queued in the mixer ahead of the device, per source. Speech is kept short, the jitter buffer holds the rest */
+#define AUDIO_PLAYBACK_MIXER_SPEECH_MS 40
+#define AUDIO_PLAYBACK_MIXER_MEDIA_MS 100
+
+/* Above the pipeline task, so the device is written as soon as a source has audio */
+#define AUDIO_PLAYBACK_MIXER_TASK_PRIO 7
 
 typedef struct audio_playback_s {
     esp_gmf_pipeline_handle_t pipeline_handle;
     esp_gmf_task_handle_t task_handle;
     esp_codec_dev_handle_t out_dev_handle;
-    esp_gmf_db_handle_t fifo;
+    audio_mixer_handle_t mixer;             /* Only writer of the output device */
+    audio_mixer_source_handle_t speech_source;
+    audio_mixer_source_handle_t media_source;
+    audio_jitter_buffer_handle_t jitter_buffer;
+    audio_jitter_buffer_packet_t in_pkt;    /* Packet being handed to the pipeline */
+    const uint8_t *in_data;                 /* PCM of in_pkt, the packet itself or its decoded audio */
+    size_t in_len;
+    size_t in_offset;
+    bool in_held;
+    esp_audio_dec_handle_t decoder;         /* Opus decoder, PCM streams bypass it */
+    uint8_t *pcm_buf;                       /* Decoded frame */
+    size_t pcm_buf_size;
+    uint32_t concealed;
+    bool upsample;                          /* Double the rate in the output port instead of aud_rate_cvt */
+    audio_convert_resampler_t resampler;
+    int16_t *rs_buf;
+    size_t rs_buf_size;
+    uint8_t *out_buf;                       /* Output in the device sample format */
+    size_t out_buf_size;
+    size_t out_frame_bytes;                 /* Bytes per frame of the output device */
     audio_playback_audio_info_t audio_in_info;
     esp_codec_dev_sample_info_t out_codec_info;
     const uint8_t *asp_embed_data;
     size_t asp_embed_data_len;
     esp_asp_handle_t asp_handle;
     bool started;
+    volatile bool flush_pending;            /* Set by audio_playback_flush(), handled by the pipeline task */
+    esp_timer_handle_t drained_timer;
+    audio_playback_drained_cb_t drained_cb;
+    void *drained_ctx;
+    audio_playback_flushed_cb_t flushed_cb;
+    void *flushed_ctx;
+    volatile bool reconfig_pending;         /* The pipeline restarts with pending_info once it has finished */
+    audio_playback_audio_info_t pending_info;
 } audio_playback_t;
 
+static uint32_t playback_frame_duration_us(const audio_playback_audio_info_t *info)
+{
+    return info->frame_duration_us ? info->frame_duration_us : info->frame_duration_ms * 1000;
+}
+
+static esp_opus_dec_frame_duration_t playback_opus_frame_duration(uint32_t frame_duration_us)
+{
+    switch (frame_duration_us) {
+    case 2500:
+        return ESP_OPUS_DEC_FRAME_DURATION_2_5_MS;
+    case 5000:
+        return ESP_OPUS_DEC_FRAME_DURATION_5_MS;
+    case 10000:
+        return ESP_OPUS_DEC_FRAME_DURATION_10_MS;
+    case 20000:
+        return ESP_OPUS_DEC_FRAME_DURATION_20_MS;
+    case 40000:
+        return ESP_OPUS_DEC_FRAME_DURATION_40_MS;
+    case 60000:
+        return ESP_OPUS_DEC_FRAME_DURATION_60_MS;
+    case 80000:
+        return ESP_OPUS_DEC_FRAME_DURATION_80_MS;
+    case 100000:
+        return ESP_OPUS_DEC_FRAME_DURATION_100_MS;
+    case 120000:
+        return ESP_OPUS_DEC_FRAME_DURATION_120_MS;
+    default:
+        return ESP_OPUS_DEC_FRAME_DURATION_INVALID;
+    }
+}
+
+static bool playback_sample_rate_is_valid(uint32_t sample_rate)
+{
+    switch (sample_rate) {
+    case 8000:
+    case 12000:
+    case 16000:
+    case 24000:
+    case 48000:
+        return true;
+    default:
+        return false;
+    }
+}
+
+/* Decode an Opus packet into buf, or conceal a frame for a gap from the previous frames. Falls back to pcm_buf if buf is too small */
+static esp_err_t playback_decode(audio_playback_t *playback, const audio_jitter_buffer_packet_t *pkt, uint8_t *buf, size_t size,
+                                 const uint8_t **pcm, size_t *pcm_len)
+{
+    esp_audio_dec_in_raw_t raw = {
+        .buffer = pkt->data,
+        .len = pkt->len,
+        .frame_recover = pkt->is_gap ? ESP_AUDIO_DEC_RECOVERY_PLC : ESP_AUDIO_DEC_RECOVERY_NONE,
+    };
+    esp_audio_dec_out_frame_t out = {
+        .buffer = buf,
+        .len = size,
+    };
+
+    esp_audio_err_t ret = esp_audio_dec_process(playback->decoder, &raw, &out);
+    if (ret == ESP_AUDIO_ERR_BUFF_NOT_ENOUGH) {
+        /* Packets longer than the configured frame duration */
+        if (out.needed_size > playback->pcm_buf_size) {
+            uint8_t *pcm_buf = (uint8_t *)realloc(playback->pcm_buf, out.needed_size);
+            if (pcm_buf == NULL) {
+                ESP_LOGE(TAG, "Failed to allocate %" PRIu32 " bytes decode buffer", out.needed_size);
+                return ESP_ERR_NO_MEM;
+            }
+            playback->pcm_buf = pcm_buf;
+            playback->pcm_buf_size = out.needed_size;
+        }
+        out.buffer = playback->pcm_buf;
+        out.len = playback->pcm_buf_size;
+        ret = esp_audio_dec_process(playback->decoder, &raw, &out);
+    }
+    if (ret != ESP_AUDIO_ERR_OK) {
+        ESP_LOGW(TAG, "Failed to %s %d bytes packet: %d", pkt->is_gap ? "conceal" : "decode", pkt->len, ret);
+        return ESP_FAIL;
+    }
+
+    *pcm = out.buffer;
+    *pcm_len = out.decoded_size;
+    return ESP_OK;
+}
+
+static esp_gmf_err_t playback_decoder_open(audio_playback_t *playback);
+
+/* Forget the audio of a flush still in the pipeline, called from the pipeline task */
+static void playback_apply_flush(audio_playback_t *playback)
+{
+    playback->flush_pending = false;
+    if (playback->in_held) {
+        audio_jitter_buffer_release(playback->jitter_buffer, &playback->in_pkt);
+        playback->in_held = false;
+    }
+    /* The decoder and resampler history belongs to the dropped speech */
+    if (playback->decoder) {
+        esp_audio_dec_close(playback->decoder);
+        playback->decoder = NULL;
+        playback_decoder_open(playback);
+    }
+    audio_convert_resampler_reset(&playback->resampler);
+}
+
+static void playback_drained_timer_cb(void *arg)
+{
+    audio_playback_t *playback = (audio_playback_t *)arg;
+    ESP_LOGD(TAG, "Playback drained");
+    if (playback->drained_cb) {
+        playback->drained_cb(playback->drained_ctx);
+    }
+}
+
+/* The mixer has faded out the speech of a flush */
+static void playback_speech_flushed(void *ctx)
+{
+    audio_playback_t *playback = (audio_playback_t *)ctx;
+    if (playback->flushed_cb) {
+        playback->flushed_cb(playback->flushed_ctx);
+    }
+}
+
+/* A write_end marker reached the pipeline: everything before it was handed to the device */
+static void playback_schedule_drained(audio_playback_t *playback)
+{
+    int64_t left_us = audio_mixer_source_played_at(playback->speech_source) - esp_timer_get_time();
+    esp_timer_stop(playback->drained_timer);
+    esp_timer_start_once(playback->drained_timer, left_us > 0 ? left_us : 1);
+}
+
 static esp_gmf_err_io_t playback_inport_acquire_read(void *handle, esp_gmf_data_bus_block_t *blk, int wanted_size, int block_ticks)
 {
-    esp_gmf_data_bus_block_t _blk = {0};
     audio_playback_t *playback = (audio_playback_t *)handle;
 
-    esp_gmf_err_io_t err = esp_gmf_db_acquire_read(playback->fifo, &_blk, wanted_size, block_ticks);
-    if (err != ESP_GMF_IO_OK) {
-        blk->valid_size = 0;
-        return ESP_GMF_IO_OK;
+    if (playback->flush_pending) {
+        playback_apply_flush(playback);
     }
 
-    memcpy(blk->buf, _blk.buf, _blk.valid_size);
-    blk->valid_size = _blk.valid_size;
-    blk->is_last = _blk.is_last;
+    if (!playback->in_held) {
+        if (audio_jitter_buffer_get(playback->jitter_buffer, &playback->in_pkt, block_ticks) != ESP_OK) {
+            blk->valid_size = 0;
+            return ESP_GMF_IO_OK;
+        }
+        /* A flush while the get waited: the packet comes after it, decode it with a fresh decoder */
+        if (playback->flush_pending) {
+            playback_apply_flush(playback);
+        }
+        if (playback->in_pkt.is_mark) {
+            playback_schedule_drained(playback);
+            audio_jitter_buffer_release(playback->jitter_buffer, &playback->in_pkt);
+            blk->valid_size = 0;
+            return ESP_GMF_IO_OK;
+        }
+        playback->in_held = true;
+        playback->in_offset = 0;
+        playback->in_data = playback->in_pkt.data;
+        playback->in_len = playback->in_pkt.len;
+
+        /*
+         * A gap in a PCM stream is skipped, in an Opus stream the decoder conceals a frame.
+         * Frames are decoded straight into the pipeline's block when they fit.
+         */
+        if (playback->audio_in_info.codec == AUDIO_PLAYBACK_CODEC_OPUS && !playback->in_pkt.is_last) {
+            const uint8_t *pcm = NULL;
+            size_t pcm_len = 0;
+            if (playback->decoder &&
+                    playback_decode(playback, &playback->in_pkt, blk->buf, wanted_size, &pcm, &pcm_len) == ESP_OK &&
+                    playback->in_pkt.is_gap) {
+                playback->concealed++;
+            }
+            playback->in_data = pcm;
+            playback->in_len = pcm_len;
+        }
+    }
 
-    err = esp_gmf_db_release_read(playback->fifo, &_blk, block_ticks);
-    if (err != ESP_GMF_IO_OK) {
-        ESP_LOGW(TAG, "Failed to release ESP-GMF data bus read: %x", err);
+    /* Decoded frames and PCM writes can be larger than the port buffer and are handed over in pieces */
+    size_t left = playback->in_len - playback->in_offset;
+    size_t copy_len = (left < (size_t)wanted_size) ? left : (size_t)wanted_size;
+    if (copy_len > 0 && playback->in_data + playback->in_offset != blk->buf) {
+        memcpy(blk->buf, playback->in_data + playback->in_offset, copy_len);
     }
+    blk->valid_size = copy_len;
+    blk->is_last = false;
+    playback->in_offset += copy_len;
+    if (playback->in_offset < playback->in_len) {
+        return ESP_GMF_IO_OK;
+    }
+
+    blk->is_last = playback->in_pkt.is_last;
+    playback->in_held = false;
+    audio_jitter_buffer_release(playback->jitter_buffer, &playback->in_pkt);
 
     return ESP_GMF_IO_OK;
 }
@@ -80,77 +288,139 @@ static esp_gmf_err_io_t playback_outport_acquire_write(void *handle, esp_gmf_dat
 static esp_gmf_err_io_t playback_outport_release_write(void *handle, esp_gmf_data_bus_block_t *blk, int block_ticks)
 {
     audio_playback_t *playback = (audio_playback_t *)handle;
+    uint8_t *out = blk->buf;
+    size_t out_len = blk->valid_size;
+
+    if (playback->flush_pending) {
+        /* Decoded before the flush */
+        return ESP_GMF_IO_OK;
+    }
+
+    if (playback->upsample) {
+        size_t samples = blk->valid_size / sizeof(int16_t);
+        if (2 * samples > playback->rs_buf_size) {
+            int16_t *rs_buf = (int16_t *)realloc(playback->rs_buf, 2 * samples * sizeof(int16_t));
+            if (rs_buf == NULL) {
+                ESP_LOGE(TAG, "Failed to allocate resampler buffer");
+                return ESP_GMF_IO_FAIL;
+            }
+            playback->rs_buf = rs_buf;
+            playback->rs_buf_size = 2 * samples;
+        }
+        out_len = audio_convert_upsample_2x(&playback->resampler, (const int16_t *)blk->buf, playback->rs_buf, samples) * sizeof(int16_t);
+        out = (uint8_t *)playback->rs_buf;
+    }
+
+    /* The pipeline outputs 16-bit mono, expand it to the device format */
+    if (playback->out_frame_bytes != sizeof(int16_t)) {
+        const int16_t *mono = (const int16_t *)out;
+        size_t frames = out_len / sizeof(int16_t);
+        out_len = frames * playback->out_frame_bytes;
+        if (out_len > playback->out_buf_size) {
+            uint8_t *out_buf = (uint8_t *)realloc(playback->out_buf, out_len);
+            if (out_buf == NULL) {
+                ESP_LOGE(TAG, "Failed to allocate %d bytes output buffer", out_len);
+                return ESP_GMF_IO_FAIL;
+            }
+            playback->out_buf = out_buf;
+            playback->out_buf_size = out_len;
+        }
+        out = playback->out_buf;
+        if (playback->out_codec_info.bits_per_sample == 32) {
+            audio_convert_s16_mono_to_s32_stereo(mono, (int32_t *)out, frames);
+        } else {
+            audio_convert_s16_mono_to_s16_stereo(mono, (int16_t *)out, frames);
+        }
+    }
 
-    ESP_LOGD(TAG, "Writing audio data to codec device: %d", blk->valid_size);
-    esp_codec_dev_write(playback->out_dev_handle, blk->buf, blk->valid_size);
+    ESP_LOGD(TAG, "Writing audio data to the mixer: %d", out_len);
+    audio_mixer_source_write(playback->speech_source, out, out_len, portMAX_DELAY);
 
     return ESP_GMF_IO_OK;
 }
 
+/* Decoded in the input port, which knows about gaps, rather than by aud_dec */
+static esp_gmf_err_t playback_decoder_open(audio_playback_t *playback)
+{
+    uint32_t frame_duration_us = playback_frame_duration_us(&playback->audio_in_info);
+    esp_opus_dec_frame_duration_t frame_duration = playback_opus_frame_duration(frame_duration_us);
+    if (frame_duration == ESP_OPUS_DEC_FRAME_DURATION_INVALID) {
+        ESP_LOGE(TAG, "Invalid frame duration: %" PRIu32 " us", frame_duration_us);
+        return ESP_GMF_ERR_INVALID_ARG;
+    }
+
+    esp_opus_dec_cfg_t opus_dec_cfg = {
+        .channel = ESP_AUDIO_MONO,
+        .frame_duration = frame_duration,
+        .self_delimited = false,
+        .sample_rate = playback->audio_in_info.sample_rate,
+    };
+    esp_audio_dec_cfg_t dec_cfg = {
+        .type = ESP_AUDIO_TYPE_OPUS,
+        .cfg = &opus_dec_cfg,
+        .cfg_sz = sizeof(opus_dec_cfg),
+    };
+    esp_audio_err_t dec_err = esp_audio_dec_open(&dec_cfg, &playback->decoder);
+    if (dec_err != ESP_AUDIO_ERR_OK) {
+        ESP_LOGE(TAG, "Failed to open OPUS decoder: %d", dec_err);
+        playback->decoder = NULL;
+        return ESP_GMF_ERR_FAIL;
+    }
+
+    size_t frame_bytes = (uint64_t)playback->audio_in_info.sample_rate * frame_duration_us / 1000000 * sizeof(int16_t);
+    if (frame_bytes > playback->pcm_buf_size) {
+        uint8_t *pcm_buf = (uint8_t *)realloc(playback->pcm_buf, frame_bytes);
+        if (pcm_buf == NULL) {
+            ESP_LOGE(TAG, "Failed to allocate %d bytes decode buffer", frame_bytes);
+            return ESP_GMF_ERR_MEMORY_LACK;
+        }
+        playback->pcm_buf = pcm_buf;
+        playback->pcm_buf_size = frame_bytes;
+    }
+
+    ESP_LOGI(TAG, "Configured OPUS decoder: %d Hz, %" PRIu32 " us frames",
+             playback->audio_in_info.sample_rate, frame_duration_us);
+    return ESP_GMF_ERR_OK;
+}
+
 static esp_gmf_err_t pipeline_setup_elements(esp_gmf_pipeline_handle_t pipeline_handle, audio_playback_t *playback)
 {
     esp_gmf_err_t err = ESP_GMF_ERR_OK;
     esp_gmf_element_handle_t ele = NULL;
 
+    /* The 2x case is cheaper with the half-band kernel than with the generic converter */
+    playback->upsample = (playback->audio_in_info.sample_rate * 2 == playback->out_codec_info.sample_rate);
+    audio_convert_resampler_reset(&playback->resampler);
+
     err = esp_gmf_pipeline_get_el_by_name(pipeline_handle, "aud_rate_cvt", &ele);
     if (err != ESP_GMF_ERR_OK) {
         ESP_LOGE(TAG, "Failed to get rate cvt element: %x", err);
     } else {
-        esp_gmf_rate_cvt_set_dest_rate(ele, playback->out_codec_info.sample_rate);
+        esp_gmf_rate_cvt_set_dest_rate(ele, playback->upsample ? playback->audio_in_info.sample_rate
+                                                               : playback->out_codec_info.sample_rate);
     }
 
-    err = esp_gmf_pipeline_get_el_by_name(pipeline_handle, "aud_bit_cvt", &ele);
-    if (err != ESP_GMF_ERR_OK) {
-        ESP_LOGE(TAG, "Failed to get bit cvt element: %x", err);
-    } else {
-        esp_gmf_bit_cvt_set_dest_bits(ele, playback->out_codec_info.bits_per_sample);
+    if (!playback_sample_rate_is_valid(playback->audio_in_info.sample_rate)) {
+        ESP_LOGE(TAG, "Invalid sample rate: %d", playback->audio_in_info.sample_rate);
+        return ESP_GMF_ERR_INVALID_ARG;
     }
 
-    err = esp_gmf_pipeline_get_el_by_name(pipeline_handle, "aud_ch_cvt", &ele);
-    if (err != ESP_GMF_ERR_OK) {
-        ESP_LOGE(TAG, "Failed to get ch cvt element: %x", err);
-    } else {
-        esp_gmf_ch_cvt_set_dest_channel(ele, playback->out_codec_info.channel);
+    if (playback->decoder) {
+        esp_audio_dec_close(playback->decoder);
+        playback->decoder = NULL;
     }
 
-    // Get the OPUS decoder element - it will automatically decode OPUS format
-    err = esp_gmf_pipeline_get_el_by_name(pipeline_handle, "aud_dec", &ele);
-    if (err != ESP_GMF_ERR_OK) {
-        ESP_LOGE(TAG, "Failed to get audio decoder element: %x", err);
-    } else {
-        esp_opus_dec_frame_duration_t frame_duration = ESP_OPUS_DEC_FRAME_DURATION_INVALID;
-        if (playback->audio_in_info.frame_duration_ms == 20) {
-            frame_duration = ESP_OPUS_DEC_FRAME_DURATION_20_MS;
-        } else if (playback->audio_in_info.frame_duration_ms == 60) {
-            frame_duration = ESP_OPUS_DEC_FRAME_DURATION_60_MS;
-        } else {
-            ESP_LOGE(TAG, "Invalid frame duration: %d", playback->audio_in_info.frame_duration_ms);
-            return ESP_GMF_ERR_INVALID_ARG;
-        }
-        esp_opus_dec_cfg_t opus_dec_cfg = {
-            .channel = ESP_AUDIO_MONO,
-            .frame_duration = frame_duration,
-            .self_delimited = false,
-            .sample_rate = playback->audio_in_info.sample_rate,
-        };
-        esp_audio_simple_dec_cfg_t audio_dec_cfg = {
-            .dec_type = ESP_AUDIO_TYPE_OPUS,
-            .dec_cfg = &opus_dec_cfg,
-            .cfg_size = sizeof(opus_dec_cfg),
-        };
-        err = esp_gmf_audio_dec_reconfig(ele, &audio_dec_cfg);
-        if (err != ESP_GMF_ERR_OK) {
-            ESP_LOGE(TAG, "Failed to configure OPUS decoder: %x", err);
-        }
-
-        ESP_LOGI(TAG, "Configured OPUS decoder pipeline");
+    if (playback->audio_in_info.codec == AUDIO_PLAYBACK_CODEC_PCM) {
+        ESP_LOGI(TAG, "Configured PCM pipeline: %d Hz", playback->audio_in_info.sample_rate);
+    } else if ((err = playback_decoder_open(playback)) != ESP_GMF_ERR_OK) {
+        return err;
     }
 
     esp_gmf_info_sound_t in_info = {
         .sample_rates = playback->audio_in_info.sample_rate,
         .bits = 16,
         .channels = 1,
-        .format_id = ESP_AUDIO_TYPE_OPUS,
+        .format_id = ESP_AUDIO_TYPE_PCM,
     };
     esp_gmf_pipeline_report_info(pipeline_handle, ESP_GMF_INFO_SOUND, &in_info, sizeof(in_info));
 
@@ -189,11 +459,9 @@ static esp_gmf_err_t pipeline_setup_ports(esp_gmf_pipeline_handle_t pipeline_han
 static esp_gmf_pipeline_handle_t pipeline_init(esp_gmf_pool_handle_t pool, audio_playback_t *playback)
 {
     esp_gmf_pipeline_handle_t pipeline_handle = NULL;
+    /* The input port decodes and the output port converts to the device sample format */
     const char *el_names[] = {
-        "aud_dec",
         "aud_rate_cvt",
-        "aud_bit_cvt",
-        "aud_ch_cvt",
     };
     size_t num_el = sizeof(el_names) / sizeof(el_names[0]);
     esp_gmf_err_t err = esp_gmf_pool_new_pipeline(pool, NULL, el_names, num_el, NULL, &pipeline_handle);
@@ -214,8 +482,9 @@ err:
 
 static int out_data_callback(uint8_t *data, int data_size, void *ctx)
 {
-    esp_codec_dev_handle_t dev = (esp_codec_dev_handle_t)ctx;
-    esp_codec_dev_write(dev, data, data_size);
+    audio_playback_t *playback = (audio_playback_t *)ctx;
+    /* Mixed over the speech, which is ducked meanwhile */
+    audio_mixer_source_write(playback->media_source, data, data_size, portMAX_DELAY);
     return 0;
 }
 
@@ -248,7 +517,7 @@ static esp_err_t media_playback_init(audio_playback_t *playback)
         },
         .out = {
             .cb = out_data_callback,
-            .user_ctx = playback->out_dev_handle,
+            .user_ctx = playback,
         },
         .prev = embed_flash_io_set,
         .prev_ctx = playback,
@@ -261,6 +530,39 @@ static esp_err_t media_playback_init(audio_playback_t *playback)
     return err;
 }
 
+static esp_err_t playback_mixer_init(audio_playback_t *playback, const audio_playback_config_t *config)
+{
+    audio_mixer_config_t mixer_cfg = {
+        .out_dev_handle = config->out_dev_handle,
+        .out_codec_info = config->out_codec_info,
+        .duck_percent = config->speech_duck_percent ? config->speech_duck_percent : AUDIO_PLAYBACK_SPEECH_DUCK_PERCENT_DEFAULT,
+        .dev_buffer_ms = config->out_buffer_ms ? config->out_buffer_ms : AUDIO_PLAYBACK_OUT_BUFFER_MS_DEFAULT,
+        .task_prio = AUDIO_PLAYBACK_MIXER_TASK_PRIO,
+    };
+    ESP_RETURN_ON_ERROR(audio_mixer_create(&mixer_cfg, &playback->mixer), TAG, "Failed to start mixer");
+
+    audio_mixer_source_config_t speech_cfg = {
+        .name = "speech",
+        .buffer_ms = AUDIO_PLAYBACK_MIXER_SPEECH_MS,
+        .gain_percent = 100,
+        .flushed_cb = playback_speech_flushed,
+        .flushed_ctx = playback,
+    };
+    ESP_RETURN_ON_ERROR(audio_mixer_add_source(playback->mixer, &speech_cfg, &playback->speech_source), TAG,
+                        "Failed to add speech source");
+
+    /* Chimes and prompts play over the speech instead of waiting for it */
+    audio_mixer_source_config_t media_cfg = {
+        .name = "media",
+        .buffer_ms = AUDIO_PLAYBACK_MIXER_MEDIA_MS,
+        .gain_percent = 100,
+        .ducks_others = true,
+    };
+    ESP_RETURN_ON_ERROR(audio_mixer_add_source(playback->mixer, &media_cfg, &playback->media_source), TAG,
+                        "Failed to add media source");
+    return ESP_OK;
+}
+
 static esp_gmf_task_handle_t pipeline_task_bind_run(esp_gmf_pipeline_handle_t pipeline_handle)
 {
     esp_gmf_err_t err = ESP_GMF_ERR_OK;
@@ -318,6 +620,29 @@ void audio_playback_pipeline_restart(void *arg)
     vTaskDelete(NULL);
 }
 
+static void audio_playback_pipeline_reconfigure(void *arg)
+{
+    audio_playback_t *playback = (audio_playback_t *)arg;
+
+    playback->audio_in_info = playback->pending_info;
+    esp_gmf_err_t err = esp_gmf_pipeline_reset(playback->pipeline_handle);
+    if (err == ESP_GMF_ERR_OK) {
+        err = pipeline_setup_elements(playback->pipeline_handle, playback);
+    }
+    if (err == ESP_GMF_ERR_OK) {
+        err = esp_gmf_pipeline_run(playback->pipeline_handle);
+    }
+    playback->reconfig_pending = false;
+
+    if (err != ESP_GMF_ERR_OK) {
+        ESP_LOGE(TAG, "Failed to restart pipeline with the new format: %x", err);
+    } else {
+        ESP_LOGI(TAG, "Pipeline restarted with the new format");
+    }
+
+    vTaskDelete(NULL);
+}
+
 static esp_gmf_err_t audio_playback_event_handler(esp_gmf_event_pkt_t *pkt, void *ctx)
 {
     audio_playback_t *playback = (audio_playback_t *)ctx;
@@ -331,8 +656,12 @@ static esp_gmf_err_t audio_playback_event_handler(esp_gmf_event_pkt_t *pkt, void
         esp_gmf_event_state_t state = (esp_gmf_event_state_t)pkt->sub;
         ESP_LOGD(TAG, "Pipeline event: state change to %s", esp_gmf_event_get_state_str(state));
 
+        // The end of stream marker of a reconfiguration was decoded
+        if (state == ESP_GMF_EVENT_STATE_FINISHED && playback->reconfig_pending) {
+            playback->started = false;
+            xTaskCreate(audio_playback_pipeline_reconfigure, "audio_playback_pipeline_reconfig", 1024 * 4, playback, 6, NULL);
         // Detect pipeline errors or stops and trigger restart
-        if (state == ESP_GMF_EVENT_STATE_ERROR || state == ESP_GMF_EVENT_STATE_STOPPED) {
+        } else if (state == ESP_GMF_EVENT_STATE_ERROR || state == ESP_GMF_EVENT_STATE_STOPPED) {
             if (playback->started) {
                 playback->started = false;
                 ESP_LOGW(TAG, "Pipeline entered error/stopped state, triggering restart");
@@ -367,6 +696,14 @@ audio_playback_handle_t audio_playback_init(const audio_playback_config_t *confi
     playback->out_codec_info = config->out_codec_info;
     playback->started = false;
 
+    playback->out_frame_bytes = config->out_codec_info.bits_per_sample / 8 * config->out_codec_info.channel;
+    if (!(config->out_codec_info.bits_per_sample == 16 && config->out_codec_info.channel <= 2) &&
+            !(config->out_codec_info.bits_per_sample == 32 && config->out_codec_info.channel == 2)) {
+        ESP_LOGE(TAG, "Unsupported output format: %d bits, %d channels",
+                 config->out_codec_info.bits_per_sample, config->out_codec_info.channel);
+        goto err;
+    }
+
     esp_gmf_err_t err = audio_pool_setup();
     if (err != ESP_GMF_ERR_OK) {
         ESP_LOGE(TAG, "Failed to setup shared pool: %x", err);
@@ -379,9 +716,28 @@ audio_playback_handle_t audio_playback_init(const audio_playback_config_t *confi
         goto err;
     }
 
-    esp_gmf_err_t fifo_err = esp_gmf_db_new_fifo(AUDIO_PLAYBACK_FIFO_BLOCK_COUNT, 1, &playback->fifo);
-    if (fifo_err != ESP_GMF_ERR_OK) {
-        ESP_LOGE(TAG, "Failed to create ESP-GMF fifo: %x", fifo_err);
+    esp_timer_create_args_t timer_args = {
+        .callback = playback_drained_timer_cb,
+        .arg = playback,
+        .name = "playback_drained",
+    };
+    if (esp_timer_create(&timer_args, &playback->drained_timer) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create drained timer");
+        goto err;
+    }
+
+    esp_err_t mixer_err = playback_mixer_init(playback, config);
+    if (mixer_err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create mixer: %s", esp_err_to_name(mixer_err));
+        goto err;
+    }
+
+    uint32_t min_latency_ms = config->jitter_min_ms ? config->jitter_min_ms : AUDIO_PLAYBACK_JITTER_MIN_MS_DEFAULT;
+    uint32_t max_latency_ms = config->jitter_max_ms ? config->jitter_max_ms : AUDIO_PLAYBACK_JITTER_MAX_MS_DEFAULT;
+    esp_err_t jb_err = audio_jitter_buffer_create(min_latency_ms, max_latency_ms, &playback->jitter_buffer);
+    if (jb_err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create jitter buffer (%" PRIu32 "-%" PRIu32 " ms): %s",
+                 min_latency_ms, max_latency_ms, esp_err_to_name(jb_err));
         goto err;
     }
 
@@ -445,11 +801,32 @@ esp_err_t audio_playback_deinit(audio_playback_handle_t *handle)
         playback->pipeline_handle = NULL;
     }
 
-    if (playback->fifo) {
-        esp_gmf_db_deinit(playback->fifo);
-        playback->fifo = NULL;
+    if (playback->mixer) {
+        audio_mixer_destroy(playback->mixer);
+        playback->mixer = NULL;
     }
 
+    if (playback->in_held) {
+        audio_jitter_buffer_release(playback->jitter_buffer, &playback->in_pkt);
+        playback->in_held = false;
+    }
+    if (playback->jitter_buffer) {
+        audio_jitter_buffer_destroy(playback->jitter_buffer);
+        playback->jitter_buffer = NULL;
+    }
+    if (playback->decoder) {
+        esp_audio_dec_close(playback->decoder);
+        playback->decoder = NULL;
+    }
+    if (playback->drained_timer) {
+        esp_timer_stop(playback->drained_timer);
+        esp_timer_delete(playback->drained_timer);
+        playback->drained_timer = NULL;
+    }
+    free(playback->pcm_buf);
+    free(playback->out_buf);
+    free(playback->rs_buf);
+
     free(playback);
 
     ESP_LOGI(TAG, "Audio playback deinitialized");
@@ -482,6 +859,15 @@ esp_err_t audio_playback_start(audio_playback_handle_t *handle)
     return ESP_OK;
 }
 
+/* Audio duration of one written packet */
+static uint32_t playback_packet_duration_us(audio_playback_t *playback, size_t len)
+{
+    if (playback->audio_in_info.codec == AUDIO_PLAYBACK_CODEC_PCM) {
+        return (uint32_t)((uint64_t)len / sizeof(int16_t) * 1000000 / playback->audio_in_info.sample_rate);
+    }
+    return playback_frame_duration_us(&playback->audio_in_info);
+}
+
 esp_err_t audio_playback_write(audio_playback_handle_t *handle, const uint8_t *data, size_t len)
 {
     if (handle == NULL || data == NULL || len == 0) {
@@ -495,25 +881,162 @@ esp_err_t audio_playback_write(audio_playback_handle_t *handle, const uint8_t *d
         return ESP_ERR_INVALID_STATE;
     }
 
-    esp_gmf_data_bus_block_t blk = {0};
+    esp_err_t err = audio_jitter_buffer_put(playback->jitter_buffer, data, len, playback_packet_duration_us(playback, len),
+                                            pdMS_TO_TICKS(AUDIO_PLAYBACK_WRITE_TIMEOUT_MS));
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to queue %d bytes of speech: %s", len, esp_err_to_name(err));
+        return err;
+    }
 
-    esp_gmf_err_io_t err = esp_gmf_db_acquire_write(playback->fifo, &blk, len, pdMS_TO_TICKS(100));
-    if (err != ESP_GMF_IO_OK) {
-        ESP_LOGW(TAG, "Failed to acquire write to ESP-GMF fifo: %x", err);
-        return ESP_ERR_TIMEOUT;
+    ESP_LOGD(TAG, "Queued %d bytes", len);
+    return ESP_OK;
+}
+
+esp_err_t audio_playback_write_nocopy(audio_playback_handle_t *handle, uint8_t *data, size_t len,
+                                      audio_playback_free_cb_t free_cb, void *free_ctx)
+{
+    audio_playback_t *playback = (audio_playback_t *)handle;
+    esp_err_t err = ESP_OK;
+
+    if (playback == NULL || data == NULL || len == 0) {
+        err = ESP_ERR_INVALID_ARG;
+    } else if (!playback->started) {
+        err = ESP_ERR_INVALID_STATE;
+    }
+    if (err != ESP_OK) {
+        /* The buffer is ours either way */
+        if (data && free_cb) {
+            free_cb(data, free_ctx);
+        } else {
+            free(data);
+        }
+        return err;
+    }
+
+    err = audio_jitter_buffer_put_ref(playback->jitter_buffer, data, len, playback_packet_duration_us(playback, len),
+                                      free_cb, free_ctx, pdMS_TO_TICKS(AUDIO_PLAYBACK_WRITE_TIMEOUT_MS));
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to queue %d bytes of speech: %s", len, esp_err_to_name(err));
+        return err;
+    }
+
+    ESP_LOGD(TAG, "Queued %d bytes by reference", len);
+    return ESP_OK;
+}
+
+esp_err_t audio_playback_get_jitter_stats(audio_playback_handle_t *handle, audio_playback_jitter_stats_t *stats)
+{
+    if (handle == NULL || stats == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    audio_playback_t *playback = (audio_playback_t *)handle;
+    audio_jitter_buffer_get_stats(playback->jitter_buffer, stats);
+    stats->concealed = playback->concealed;
+    return ESP_OK;
+}
+
+esp_err_t audio_playback_reconfigure(audio_playback_handle_t *handle, const audio_playback_audio_info_t *audio_in_info)
+{
+    if (handle == NULL || audio_in_info == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    audio_playback_t *playback = (audio_playback_t *)handle;
+    uint32_t frame_duration_us = playback_frame_duration_us(audio_in_info);
+    bool duration_valid = (audio_in_info->codec == AUDIO_PLAYBACK_CODEC_PCM) ||
+                          playback_opus_frame_duration(frame_duration_us) != ESP_OPUS_DEC_FRAME_DURATION_INVALID;
+    if (!duration_valid || !playback_sample_rate_is_valid(audio_in_info->sample_rate)) {
+        ESP_LOGE(TAG, "Unsupported format: %d Hz, %" PRIu32 " us", audio_in_info->sample_rate, frame_duration_us);
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    if (audio_in_info->codec != playback->audio_in_info.codec) {
+        ESP_LOGE(TAG, "Changing the codec requires a new playback");
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    if (playback->reconfig_pending) {
+        return ESP_ERR_INVALID_STATE;
     }
 
-    size_t copy_size = len < blk.buf_length ? len : blk.buf_length;
-    memcpy(blk.buf, data, copy_size);
-    blk.valid_size = copy_size;
+    if (!playback->started) {
+        /* The pipeline task of a stopped or restarting pipeline still runs with the old format */
+        if (playback->task_handle != NULL) {
+            return ESP_ERR_INVALID_STATE;
+        }
+        /* Never started: configure the elements now, audio_playback_start() runs them */
+        playback->audio_in_info = *audio_in_info;
+        return pipeline_setup_elements(playback->pipeline_handle, playback) == ESP_GMF_ERR_OK ? ESP_OK : ESP_FAIL;
+    }
 
-    err = esp_gmf_db_release_write(playback->fifo, &blk, pdMS_TO_TICKS(50));
-    if (err != ESP_GMF_IO_OK) {
-        ESP_LOGW(TAG, "Failed to release write to ESP-GMF fifo: %x", err);
+    playback->pending_info = *audio_in_info;
+    playback->reconfig_pending = true;
+
+    /* End of stream marker, makes the pipeline finish after the data already written */
+    esp_err_t err = audio_jitter_buffer_put_end(playback->jitter_buffer, pdMS_TO_TICKS(AUDIO_PLAYBACK_WRITE_TIMEOUT_MS));
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to queue the end of stream marker: %s", esp_err_to_name(err));
+        playback->reconfig_pending = false;
         return ESP_ERR_TIMEOUT;
     }
 
-    ESP_LOGD(TAG, "Sent %d bytes to ESP-GMF speaker data buffer", len);
+    ESP_LOGI(TAG, "Reconfiguring to %d Hz, %" PRIu32 " us frames", audio_in_info->sample_rate, frame_duration_us);
+    return ESP_OK;
+}
+
+esp_err_t audio_playback_flush(audio_playback_handle_t *handle)
+{
+    if (handle == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    audio_playback_t *playback = (audio_playback_t *)handle;
+
+    playback->flush_pending = true;
+    audio_jitter_buffer_flush(playback->jitter_buffer);
+
+    /* Media goes on, only the speech waiting in the mixer is dropped */
+    audio_mixer_source_flush(playback->speech_source);
+
+    ESP_LOGI(TAG, "Playback flushed");
+    return ESP_OK;
+}
+
+esp_err_t audio_playback_set_flushed_cb(audio_playback_handle_t *handle, audio_playback_flushed_cb_t cb, void *ctx)
+{
+    if (handle == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    audio_playback_t *playback = (audio_playback_t *)handle;
+    playback->flushed_ctx = ctx;
+    playback->flushed_cb = cb;
+    return ESP_OK;
+}
+
+esp_err_t audio_playback_write_end(audio_playback_handle_t *handle)
+{
+    if (handle == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    audio_playback_t *playback = (audio_playback_t *)handle;
+
+    esp_err_t err = audio_jitter_buffer_put_mark(playback->jitter_buffer, pdMS_TO_TICKS(AUDIO_PLAYBACK_WRITE_TIMEOUT_MS));
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to queue the end of the speech: %s", esp_err_to_name(err));
+    }
+    return err;
+}
+
+esp_err_t audio_playback_set_drained_cb(audio_playback_handle_t *handle, audio_playback_drained_cb_t cb, void *ctx)
+{
+    if (handle == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    audio_playback_t *playback = (audio_playback_t *)handle;
+    playback->drained_ctx = ctx;
+    playback->drained_cb = cb;
     return ESP_OK;
 }
 
@@ -524,11 +1047,10 @@ esp_err_t audio_playback_remaining_bytes(audio_playback_handle_t *handle, size_t
     }
 
     audio_playback_t *playback = (audio_playback_t *)handle;
-    uint32_t filled_size = 0;
-
-    esp_gmf_db_get_filled_size(playback->fifo, &filled_size);
 
-    *remaining_bytes = filled_size;
+    /* The packet being decoded counts too, it is released once fully handed over */
+    size_t held = playback->in_held ? playback->in_pkt.len : 0;
+    *remaining_bytes = audio_jitter_buffer_filled_bytes(playback->jitter_buffer) + held;
     return ESP_OK;
 }
 
@@ -16,31 +16,229 @@
 
 typedef void* audio_playback_handle_t;
 
+/**
+ * @brief Frees a buffer passed to audio_playback_write_nocopy()
+ *
+ * @param data The buffer
+ * @param ctx The free_ctx given with it
+ */
+typedef void (*audio_playback_free_cb_t)(void *data, void *ctx);
+
+/**
+ * @brief Called once the speech before audio_playback_write_end() has been played
+ *
+ * Runs in the esp_timer task and should not block.
+ *
+ * @param ctx The ctx given to audio_playback_set_drained_cb()
+ */
+typedef void (*audio_playback_drained_cb_t)(void *ctx);
+
+/**
+ * @brief Called once the speech dropped by audio_playback_flush() has stopped being mixed
+ *
+ * Only the audio already in the device DMA buffers plays after it. Runs in the mixer task
+ * and should not block.
+ *
+ * @param ctx The ctx given to audio_playback_set_flushed_cb()
+ */
+typedef void (*audio_playback_flushed_cb_t)(void *ctx);
+
+/** Jitter buffer latency bounds used when audio_playback_config_t leaves them at 0 */
+#define AUDIO_PLAYBACK_JITTER_MIN_MS_DEFAULT 60
+#define AUDIO_PLAYBACK_JITTER_MAX_MS_DEFAULT 600
+
+/** Output device buffering used when audio_playback_config_t leaves it at 0: 6 DMA buffers of 240 frames at 16 kHz */
+#define AUDIO_PLAYBACK_OUT_BUFFER_MS_DEFAULT 90
+
+/** Speech level while media plays, used when audio_playback_config_t leaves it at 0 */
+#define AUDIO_PLAYBACK_SPEECH_DUCK_PERCENT_DEFAULT 30
+
+typedef enum {
+    AUDIO_PLAYBACK_CODEC_OPUS,      /*!< Opus packets, one per write */
+    AUDIO_PLAYBACK_CODEC_PCM,       /*!< Raw 16-bit mono little endian PCM, any length per write */
+} audio_playback_codec_t;
+
+/**
+ * @brief Format of the stream written to the playback
+ *
+ * @param frame_duration_ms Frame duration in milliseconds
+ * @param sample_rate Sample rate in Hz: 8000, 12000, 16000, 24000 or 48000
+ * @param frame_duration_us Frame duration in microseconds, takes precedence over frame_duration_ms when non-zero.
+ *                          Opus supports 2500, 5000, 10000, 20000, 40000, 60000, 80000, 100000 and 120000
+ * @param codec Codec of the stream, Opus by default
+ */
 typedef struct {
     uint16_t frame_duration_ms;
     uint16_t sample_rate;
+    uint32_t frame_duration_us;
+    audio_playback_codec_t codec;
 } audio_playback_audio_info_t;
 
+/**
+ * @brief Playback configuration
+ *
+ * @param audio_in_info Format of the written stream
+ * @param out_codec_info Format the output device was opened with. 16-bit mono, 16-bit stereo
+ *                       and 32-bit stereo are supported, the sample rate is converted as needed
+ * @param out_dev_handle Handle to the output device
+ * @param jitter_min_ms Lowest jitter buffer depth before playout starts, 0 for AUDIO_PLAYBACK_JITTER_MIN_MS_DEFAULT
+ * @param jitter_max_ms Highest jitter buffer depth, and most audio buffered before writes block,
+ *                      0 for AUDIO_PLAYBACK_JITTER_MAX_MS_DEFAULT
+ * @param speech_duck_percent Speech level in percent while media plays over it,
+ *                            0 for AUDIO_PLAYBACK_SPEECH_DUCK_PERCENT_DEFAULT
+ * @param out_buffer_ms Audio the output device buffers in its DMA buffers, for the timing of the drained
+ *                      callback, 0 for AUDIO_PLAYBACK_OUT_BUFFER_MS_DEFAULT
+ */
+
 typedef struct {
     audio_playback_audio_info_t audio_in_info;
     esp_codec_dev_sample_info_t out_codec_info;
     esp_codec_dev_handle_t out_dev_handle;
+    uint16_t jitter_min_ms;
+    uint16_t jitter_max_ms;
+    uint8_t speech_duck_percent;
+    uint16_t out_buffer_ms;
 } audio_playback_config_t;
 
+/**
+ * @brief Jitter buffer statistics
+ *
+ * @param packets Packets played
+ * @param underruns Times playout ran dry for longer than concealment covers while the stream went on
+ * @param late Packets that arrived after the output had to conceal a frame for them, played all the same
+ * @param concealed Opus frames filled in by the decoder's packet loss concealment while the buffer was dry
+ * @param discarded Packets dropped because the buffer stayed full
+ * @param jitter_ms Smoothed lateness of packet arrivals
+ * @param target_ms Current depth reached before playout starts
+ * @param depth_ms Audio currently buffered
+ */
+typedef struct {
+    uint32_t packets;
+    uint32_t underruns;
+    uint32_t late;
+    uint32_t concealed;
+    uint32_t discarded;
+    uint32_t jitter_ms;
+    uint32_t target_ms;
+    uint32_t depth_ms;
+} audio_playback_jitter_stats_t;
+
 audio_playback_handle_t audio_playback_init(const audio_playback_config_t *config);
 
 esp_err_t audio_playback_deinit(audio_playback_handle_t *handle);
 
 esp_err_t audio_playback_start(audio_playback_handle_t *handle);
 
+/**
+ * @brief Queue one packet of the stream
+ *
+ * Opus packets are written one per call, PCM in chunks of any length. The data is copied.
+ * Packets are played in the order they are written: the websocket downlink arrives in
+ * order and has no sequence numbers, so there is no reordering.
+ *
+ * @param handle The audio playback handle
+ * @param data The packet
+ * @param len The length of the packet
+ * @return ESP_OK on success, ESP_ERR_TIMEOUT if the jitter buffer stayed full and the packet was dropped,
+ *         ESP_ERR_INVALID_STATE if the playback is not running, otherwise an error code
+ */
 esp_err_t audio_playback_write(audio_playback_handle_t *handle, const uint8_t *data, size_t len);
 
+/**
+ * @brief Queue one packet of the stream without copying it
+ *
+ * Same as audio_playback_write(), except that the playback takes the buffer over and
+ * decodes from it directly. It owns the buffer from this call on, also when the call
+ * fails, and passes it to free_cb once the packet was played or dropped.
+ *
+ * @param handle The audio playback handle
+ * @param data The packet
+ * @param len The length of the packet
+ * @param free_cb Frees data from the playback task, NULL for free()
+ * @param free_ctx Context passed to free_cb
+ * @return Same as audio_playback_write()
+ */
+esp_err_t audio_playback_write_nocopy(audio_playback_handle_t *handle, uint8_t *data, size_t len,
+                                      audio_playback_free_cb_t free_cb, void *free_ctx);
+
+/**
+ * @brief Get the jitter buffer statistics, cumulative since init
+ *
+ * @param handle The audio playback handle
+ * @param stats Filled with the statistics
+ * @return ESP_OK on success, otherwise an error code
+ */
+esp_err_t audio_playback_get_jitter_stats(audio_playback_handle_t *handle, audio_playback_jitter_stats_t *stats);
+
 esp_err_t audio_playback_remaining_bytes(audio_playback_handle_t *handle, size_t *remaining_bytes);
 
+/**
+ * @brief Mark the end of the speech written so far
+ *
+ * The drained callback is called when the last sample written before the mark has left
+ * the output device. The mixer estimates this from the speech still in its buffer, the
+ * period it is writing and out_buffer_ms of device buffering, erring late rather than early.
+ * The mark also starts the playout of a short response at once instead of waiting for
+ * the jitter buffer target, and survives audio_playback_flush().
+ *
+ * @param handle The audio playback handle
+ * @return ESP_OK on success, ESP_ERR_TIMEOUT if the jitter buffer stayed full, otherwise an error code
+ */
+esp_err_t audio_playback_write_end(audio_playback_handle_t *handle);
+
+/**
+ * @brief Set the callback for the end of the speech marked by audio_playback_write_end()
+ *
+ * @param handle The audio playback handle
+ * @param cb The callback, NULL to remove it
+ * @param ctx Context passed to the callback
+ * @return ESP_OK on success, otherwise an error code
+ */
+esp_err_t audio_playback_set_drained_cb(audio_playback_handle_t *handle, audio_playback_drained_cb_t cb, void *ctx);
+
+/**
+ * @brief Drop the speech written so far, for a barge-in
+ *
+ * Queued packets are dropped at once and the speech waiting in the mixer fades out over
+ * one mixer period, media playing over it goes on. Speech already in the device DMA
+ * buffers still plays. The decoder state and the block in flight in the pipeline are
+ * dropped before the next packet.
+ *
+ * @param handle The audio playback handle
+ * @return ESP_OK on success, otherwise an error code
+ */
+esp_err_t audio_playback_flush(audio_playback_handle_t *handle);
+
+/**
+ * @brief Set the callback for the speech of audio_playback_flush() going silent
+ *
+ * @param handle The audio playback handle
+ * @param cb The callback, NULL to remove it
+ * @param ctx Context passed to the callback
+ * @return ESP_OK on success, otherwise an error code
+ */
+esp_err_t audio_playback_set_flushed_cb(audio_playback_handle_t *handle, audio_playback_flushed_cb_t cb, void *ctx);
+
+/**
+ * @brief Change the format of the Opus stream
+ *
+ * Data already written is still decoded with the old format. The pipeline then
+ * finishes and restarts with the new decoder configuration, during which
+ * audio_playback_write() returns ESP_ERR_INVALID_STATE.
+ *
+ * @param handle The audio playback handle
+ * @param audio_in_info The new stream format
+ * @return ESP_OK on success, ESP_ERR_NOT_SUPPORTED for a format Opus does not support or a codec change,
+ *         ESP_ERR_INVALID_STATE if a reconfiguration is already in progress or the pipeline is restarting,
+ *         otherwise an error code. The format is left unchanged on failure
+ */
+esp_err_t audio_playback_reconfigure(audio_playback_handle_t *handle, const audio_playback_audio_info_t *audio_in_info);
+
 /**
  * @brief Play media data using ESP-GMF audio simple player
  *
- * Blocks until playback completion.
+ * Blocks until playback completion. Media is mixed over any speech playing, which is
+ * lowered to speech_duck_percent meanwhile.
  *
  * @param handle The audio playback handle
  * @param media_url The media URL
@@ -54,7 +252,8 @@ esp_err_t audio_playback_play_media_sync(audio_playback_handle_t *handle, const
 /**
  * @brief Play media data using ESP-GMF audio simple player asynchronously
  *
- * Without blocking for playback completion.
+ * Without blocking for playback completion. Mixed over the speech like
+ * audio_playback_play_media_sync().
  *
  * @param handle The audio playback handle
  * @param media_url The media URL
@@ -0,0 +1,168 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <esp_log.h>
+#include <esp_heap_caps.h>
+
+#include "audio_preroll.h"
+
+static const char *TAG = "audio_preroll";
+
+esp_err_t audio_preroll_init(audio_preroll_t *preroll, uint16_t slot_count, size_t slot_size, uint32_t frame_duration_us)
+{
+    preroll->slot_count = slot_count;
+    preroll->slot_size = slot_size;
+    preroll->frame_duration_us = frame_duration_us;
+    preroll->head = 0;
+    preroll->count = 0;
+
+    preroll->data = (uint8_t *)heap_caps_calloc(slot_count, slot_size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (preroll->data == NULL) {
+        /* No PSRAM on the board, or it is used up */
+        ESP_LOGI(TAG, "No PSRAM for the pre-roll, trying internal RAM");
+        preroll->data = (uint8_t *)heap_caps_calloc(slot_count, slot_size, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    }
+    preroll->frames = (audio_recorder_frame_t *)calloc(slot_count, sizeof(audio_recorder_frame_t));
+    if (preroll->data == NULL || preroll->frames == NULL) {
+        audio_preroll_deinit(preroll);
+        return ESP_ERR_NO_MEM;
+    }
+    for (int i = 0; i < slot_count; i++) {
+        preroll->frames[i].data = preroll->data + i * slot_size;
+    }
+
+    ESP_LOGI(TAG, "Pre-roll: %d frames, %d bytes", slot_count, (int)(slot_count * slot_size));
+    return ESP_OK;
+}
+
+void audio_preroll_deinit(audio_preroll_t *preroll)
+{
+    heap_caps_free(preroll->data);
+    free(preroll->frames);
+    preroll->data = NULL;
+    preroll->frames = NULL;
+    preroll->slot_count = 0;
+    preroll->head = 0;
+    preroll->count = 0;
+}
+
+void audio_preroll_arm(audio_preroll_t *preroll, bool arm)
+{
+    preroll->request = arm ? AUDIO_PREROLL_REQUEST_ARM : AUDIO_PREROLL_REQUEST_DISARM;
+}
+
+void audio_preroll_set_command(audio_preroll_t *preroll, audio_preroll_command_t command)
+{
+    if (command == AUDIO_PREROLL_COMMAND_OPEN) {
+        preroll->command_matched = false;
+    } else if (command == AUDIO_PREROLL_COMMAND_MATCHED) {
+        preroll->command_matched = true;
+    }
+    preroll->command = command;
+}
+
+/* Apply an arm or disarm request from another task */
+static void preroll_sync(audio_preroll_t *preroll)
+{
+    audio_preroll_request_t request = preroll->request;
+    if (request == AUDIO_PREROLL_REQUEST_NONE) {
+        return;
+    }
+    preroll->request = AUDIO_PREROLL_REQUEST_NONE;
+    preroll->armed = (request == AUDIO_PREROLL_REQUEST_ARM);
+    preroll->count = 0;
+}
+
+audio_recorder_hold_t audio_preroll_hold(audio_preroll_t *preroll)
+{
+    audio_preroll_command_t command = preroll->command;
+    if (command == AUDIO_PREROLL_COMMAND_OPEN) {
+        if (!preroll->holding) {
+            ESP_LOGD(TAG, "Holding the uplink while listening for a command");
+            preroll->holding = true;
+        }
+        return AUDIO_RECORDER_HOLD_HELD;
+    }
+
+    bool released = false;
+    if (preroll->holding) {
+        preroll->holding = false;
+        if (preroll->command_matched) {
+            /* The held frames carry the command */
+            ESP_LOGI(TAG, "Dropped %d held frames of the command", preroll->count);
+            preroll->armed = false;
+            preroll->count = 0;
+        } else {
+            released = true;
+        }
+    }
+    /* The rest of the turn belongs to the command too, until the recorder goes back to idle */
+    if (command == AUDIO_PREROLL_COMMAND_MATCHED) {
+        return AUDIO_RECORDER_HOLD_HELD;
+    }
+    return released ? AUDIO_RECORDER_HOLD_RELEASED : AUDIO_RECORDER_HOLD_NONE;
+}
+
+void audio_preroll_store(audio_preroll_t *preroll, const audio_recorder_frame_t *frame)
+{
+    preroll_sync(preroll);
+    if (preroll->slot_count == 0 || !preroll->armed || frame->len > preroll->slot_size) {
+        return;
+    }
+
+    audio_recorder_frame_t *slot = &preroll->frames[preroll->head];
+    memcpy((uint8_t *)slot->data, frame->data, frame->len);
+    slot->len = frame->len;
+    slot->seq = frame->seq;
+    slot->timestamp_us = frame->timestamp_us;
+
+    preroll->head = (preroll->head + 1) % preroll->slot_count;
+    if (preroll->count < preroll->slot_count) {
+        preroll->count++;
+    } else {
+        preroll->stats.frames_overwritten++;
+    }
+}
+
+esp_err_t audio_preroll_flush(audio_preroll_t *preroll, uint32_t max_ms, audio_recorder_frame_cb_t cb, void *user_data)
+{
+    preroll_sync(preroll);
+    if (preroll->slot_count == 0) {
+        return ESP_OK;
+    }
+
+    uint16_t count = preroll->count;
+    if (max_ms > 0) {
+        uint32_t max_frames = (max_ms * 1000 + preroll->frame_duration_us - 1) / preroll->frame_duration_us;
+        count = (count < max_frames) ? count : max_frames;
+    }
+
+    /* Oldest first, skipping the frames beyond max_ms */
+    esp_err_t err = ESP_OK;
+    uint16_t delivered = 0;
+    uint16_t index = (preroll->head + preroll->slot_count - count) % preroll->slot_count;
+    for (; delivered < count && cb; delivered++) {
+        err = cb(&preroll->frames[index], user_data);
+        if (err != ESP_OK) {
+            break;
+        }
+        index = (index + 1) % preroll->slot_count;
+    }
+
+    if (delivered > 0) {
+        preroll->stats.flushes++;
+        preroll->stats.frames_salvaged += delivered;
+        uint32_t delivered_ms = delivered * preroll->frame_duration_us / 1000;
+        preroll->stats.ms_salvaged += delivered_ms;
+        ESP_LOGI(TAG, "Pre-roll flushed %d frames (%" PRIu32 " ms)", delivered, delivered_ms);
+    }
+
+    preroll->armed = false;
+    preroll->count = 0;
+    return err;
+}
@@ -8,6 +8,7 @@
 #include "esp_opus_enc.h"
 #include <esp_check.h>
 #include <esp_log.h>
+#include <esp_timer.h>
 
 #include <esp_gmf_pool.h>
 #include <esp_gmf_pipeline.h>
@@ -16,8 +17,8 @@
 #include <esp_afe_config.h>
 #include <esp_gmf_afe.h>
 #include <esp_gmf_afe_manager.h>
+#include <esp_mn_speech_commands.h>
 
-#include <esp_gmf_audio_enc.h>
 #include <esp_gmf_rate_cvt.h>
 #include <esp_gmf_ch_cvt.h>
 #include <esp_gmf_bit_cvt.h>
@@ -25,23 +26,108 @@
 #include <esp_gmf_fifo.h>
 
 #include <audio_common.h>
+#include <audio_convert.h>
 #include <audio_recorder.h>
+#include <audio_preroll.h>
 
 static const char *TAG = "audio_recorder";
 
 #define AUDIO_RECORDER_FIFO_BLOCK_COUNT 8
+#define AUDIO_RECORDER_AFE_SAMPLE_RATE 16000
+
+/* Per-block metadata, written and read in the same order as the FIFO blocks */
+typedef struct {
+    uint32_t seq;
+    int64_t timestamp_us;
+} audio_recorder_frame_meta_t;
 
 typedef struct {
     esp_gmf_pipeline_handle_t pipeline_handle;
     esp_codec_dev_handle_t in_dev_handle;
     esp_gmf_task_handle_t task_handle;
     esp_gmf_fifo_handle_t fifo_handle;
-    uint16_t sample_rate;
-    uint8_t frame_duration_ms;
+    esp_audio_enc_handle_t encoder;
+    bool downsample;            /* Halve the AFE rate in the output port instead of aud_rate_cvt */
+    audio_convert_resampler_t resampler;
+    int16_t *rs_buf;
+    size_t rs_buf_size;
+    uint8_t *pcm_buf;           /* Partial PCM frame carried over between AFE outputs */
+    size_t pcm_filled;
+    size_t pcm_frame_size;      /* PCM bytes consumed by the encoder per frame */
+    size_t enc_frame_size;      /* Upper bound of one encoded frame */
+    esp_gmf_data_bus_block_t held_blk;
+    audio_recorder_frame_t held_frame;
+    bool frame_held;
+    audio_recorder_frame_meta_t meta[AUDIO_RECORDER_FIFO_BLOCK_COUNT];
+    uint32_t meta_write;
+    uint32_t meta_read;
+    uint32_t next_seq;
+    int64_t frame_start_us;         /* AFE output time of the next frame, from the first input sample */
+    size_t in_sample_bytes;         /* Bytes per sample across all input channels */
+    portMUX_TYPE clock_lock;
+    uint64_t in_samples;            /* Input samples read so far */
+    int64_t in_time_us;             /* Time at which in_samples was reached */
+    uint16_t preroll_ms;
+    audio_preroll_t preroll;
+    int64_t last_read_us;
+    audio_recorder_perf_stats_t perf;
+    uint8_t silence_frame[2];       /* Empty Opus packet matching the encoder config */
+    uint8_t silence_len;
+    audio_recorder_codec_t codec;
+    uint32_t sample_rate;
+    uint32_t frame_duration_us;
+    bool reconfig_pending;          /* Guarded by clock_lock with the two pending values */
+    uint32_t pending_sample_rate;
+    uint32_t pending_frame_duration_us;
+    volatile bool preroll_resize;   /* Set by the recorder task once the encoder was reopened */
+    volatile bool idle;             /* Only the wake word path runs, the AFE output is dropped */
     audio_recorder_event_cb_t event_cb;
     void *cb_user_data;
+    const audio_recorder_command_t *commands;   /* Owned by the caller, NULL if command detection is disabled */
+    size_t num_commands;
+    bool commands_applied;          /* Only touched by the AFE task, which also runs MultiNet */
+    int64_t wakeup_us;
+    audio_recorder_command_cb_t command_cb;
+    void *command_cb_user_data;
 } audio_recorder_t;
 
+/* Replace the phrases MultiNet was created with. Runs in the AFE task, once MultiNet exists. */
+static void recorder_apply_commands(audio_recorder_t *recorder)
+{
+    recorder->commands_applied = true;
+
+    esp_mn_commands_clear();
+    for (size_t i = 0; i < recorder->num_commands; i++) {
+        if (esp_mn_commands_add(recorder->commands[i].id, recorder->commands[i].phrase) != ESP_OK) {
+            ESP_LOGW(TAG, "Failed to add command %d: %s", recorder->commands[i].id, recorder->commands[i].phrase);
+        }
+    }
+    esp_mn_error_t *mn_err = esp_mn_commands_update();
+    if (mn_err) {
+        ESP_LOGW(TAG, "%d command phrases were rejected by MultiNet", mn_err->num);
+    }
+    ESP_LOGI(TAG, "%d voice commands enabled", (int)recorder->num_commands);
+}
+
+static void recorder_command_detected(audio_recorder_t *recorder, esp_gmf_afe_evt_t *event)
+{
+    const esp_gmf_afe_vcmd_info_t *info = (const esp_gmf_afe_vcmd_info_t *)event->event_data;
+    audio_recorder_command_result_t result = {
+        .id = event->type,
+        .prob = info ? info->prob : 0.0f,
+        .wakeup_us = recorder->wakeup_us,
+        .detect_us = esp_timer_get_time(),
+    };
+
+    ESP_LOGI(TAG, "Command %d detected (%s, prob %.2f), %" PRId64 " ms after the wake word",
+             result.id, info ? info->str : "", result.prob, (result.detect_us - result.wakeup_us) / 1000);
+    /* Before the callback, so the frames of the command are dropped by the time the turn ends */
+    audio_preroll_set_command(&recorder->preroll, AUDIO_PREROLL_COMMAND_MATCHED);
+    if (recorder->command_cb) {
+        recorder->command_cb((audio_recorder_handle_t)recorder, &result, recorder->command_cb_user_data);
+    }
+}
+
 static void esp_gmf_afe_event_cb(esp_gmf_obj_handle_t obj, esp_gmf_afe_evt_t *event, void *user_data)
 {
     audio_recorder_event_t recorder_event = AUDIO_RECORDER_EVENT_MAX;
@@ -51,11 +137,29 @@ static void esp_gmf_afe_event_cb(esp_gmf_obj_handle_t obj, esp_gmf_afe_evt_t *ev
     case ESP_GMF_AFE_EVT_WAKEUP_START: {
         recorder_event = AUDIO_RECORDER_EVENT_WAKEUP_START;
         ESP_LOGI(TAG, "Wakeup start");
+        if (recorder) {
+            /* Same task as the output port, so the audio right after the wake word is already encoded */
+            recorder->idle = false;
+        }
+        if (recorder && recorder->commands) {
+            recorder->wakeup_us = esp_timer_get_time();
+            if (!recorder->commands_applied) {
+                /* MultiNet is created when the AFE element opens, before the first wake word */
+                recorder_apply_commands(recorder);
+            }
+            /* Hold the uplink back until MultiNet knows whether a command follows */
+            audio_preroll_set_command(&recorder->preroll, AUDIO_PREROLL_COMMAND_OPEN);
+        }
+        /* Keep what the user says right after the wake word until the conversation starts */
+        audio_recorder_preroll_arm((audio_recorder_handle_t)recorder);
         break;
     }
     case ESP_GMF_AFE_EVT_WAKEUP_END:
         recorder_event = AUDIO_RECORDER_EVENT_WAKEUP_END;
         ESP_LOGI(TAG, "Wakeup end");
+        if (recorder) {
+            audio_preroll_arm(&recorder->preroll, false);
+        }
         break;
     case ESP_GMF_AFE_EVT_VAD_START:
         recorder_event = AUDIO_RECORDER_EVENT_VAD_START;
@@ -65,7 +169,18 @@ static void esp_gmf_afe_event_cb(esp_gmf_obj_handle_t obj, esp_gmf_afe_evt_t *ev
         recorder_event = AUDIO_RECORDER_EVENT_VAD_END;
         // ESP_LOGI(TAG, "VAD_END");
         break;
+    case ESP_GMF_AFE_EVT_VCMD_DECT_TIMEOUT:
+        ESP_LOGD(TAG, "No command after the wake word");
+        if (recorder && recorder->commands) {
+            audio_preroll_set_command(&recorder->preroll, AUDIO_PREROLL_COMMAND_TIMEOUT);
+        }
+        return;
     default:
+        /* Detected commands are reported with their id as the event type */
+        if (event->type >= 0 && recorder && recorder->commands) {
+            recorder_command_detected(recorder, event);
+            return;
+        }
         ESP_LOGW(TAG, "Unknown event: %d", event->type);
         break;
     }
@@ -80,25 +195,157 @@ static esp_gmf_err_io_t recorder_outport_acquire_write(void *handle, esp_gmf_dat
     return ESP_GMF_ERR_OK;
 }
 
-static esp_gmf_err_io_t recorder_outport_release_write(void *handle, esp_gmf_data_bus_block_t *blk, int block_ticks)
+/* Capture time of the first sample of the next frame */
+static int64_t recorder_frame_capture_time(audio_recorder_t *recorder)
 {
-    audio_recorder_t *recorder = (audio_recorder_t *)handle;
-    esp_gmf_data_bus_block_t _blk = {0};
-    int ret = esp_gmf_fifo_acquire_write(recorder->fifo_handle, &_blk, blk->valid_size, block_ticks);
+    portENTER_CRITICAL(&recorder->clock_lock);
+    uint64_t in_samples = recorder->in_samples;
+    int64_t in_time_us = recorder->in_time_us;
+    portEXIT_CRITICAL(&recorder->clock_lock);
+
+    /* The AFE emits one output sample per input sample, so the difference also covers its processing delay */
+    int64_t in_audio_us = (int64_t)(in_samples * 1000000 / AUDIO_RECORDER_AFE_SAMPLE_RATE);
+    return in_time_us - (in_audio_us - recorder->frame_start_us);
+}
+
+/* Encode one PCM frame straight into a FIFO block */
+static esp_gmf_err_io_t recorder_encode_frame(audio_recorder_t *recorder, uint8_t *pcm, int block_ticks)
+{
+    audio_recorder_frame_meta_t meta = {
+        .seq = recorder->next_seq++,
+        .timestamp_us = recorder_frame_capture_time(recorder),
+    };
+    recorder->frame_start_us += recorder->frame_duration_us;
+
+    esp_gmf_data_bus_block_t blk = {0};
+    int ret = esp_gmf_fifo_acquire_write(recorder->fifo_handle, &blk, recorder->enc_frame_size, 0);
+    if (ret < 0) {
+        /* Full, the AFE output now waits for the consumer */
+        recorder->perf.fetch_overruns++;
+        ret = esp_gmf_fifo_acquire_write(recorder->fifo_handle, &blk, recorder->enc_frame_size, block_ticks);
+    }
     if (ret < 0) {
+        /* The frame is lost, which shows up as a gap in the sequence numbers */
         ESP_LOGE(TAG, "%s|%d, Fifo acquire write failed, ret: %d", __func__, __LINE__, ret);
-        return ESP_FAIL;
+        recorder->perf.frames_dropped++;
+        return ESP_GMF_IO_FAIL;
+    }
+    recorder->meta[recorder->meta_write++ % AUDIO_RECORDER_FIFO_BLOCK_COUNT] = meta;
+
+    if (recorder->codec == AUDIO_RECORDER_CODEC_PCM) {
+        memcpy(blk.buf, pcm, recorder->pcm_frame_size);
+        blk.valid_size = recorder->pcm_frame_size;
+        recorder->perf.frames_encoded++;
+        esp_gmf_fifo_release_write(recorder->fifo_handle, &blk, block_ticks);
+        return ESP_GMF_IO_OK;
+    }
+
+    esp_audio_enc_in_frame_t in_frame = {
+        .buffer = pcm,
+        .len = recorder->pcm_frame_size,
+    };
+    esp_audio_enc_out_frame_t out_frame = {
+        .buffer = blk.buf,
+        .len = recorder->enc_frame_size,
+    };
+    int64_t encode_start_us = esp_timer_get_time();
+    esp_audio_err_t enc_err = esp_audio_enc_process(recorder->encoder, &in_frame, &out_frame);
+    recorder->perf.encode_time_us += esp_timer_get_time() - encode_start_us;
+    if (enc_err != ESP_AUDIO_ERR_OK) {
+        /* Empty blocks are skipped by the reader */
+        ESP_LOGW(TAG, "Failed to encode frame: %d", enc_err);
+        out_frame.encoded_bytes = 0;
+        recorder->perf.frames_dropped++;
+    } else {
+        recorder->perf.frames_encoded++;
     }
-    memcpy(_blk.buf, blk->buf, blk->valid_size);
 
-    _blk.valid_size = blk->valid_size;
-    ret = esp_gmf_fifo_release_write(recorder->fifo_handle, &_blk, block_ticks);
+    blk.valid_size = out_frame.encoded_bytes;
+    ret = esp_gmf_fifo_release_write(recorder->fifo_handle, &blk, block_ticks);
     if (ret != ESP_GMF_ERR_OK) {
         ESP_LOGE(TAG, "Fifo release write failed");
     }
     return ESP_GMF_IO_OK;
 }
 
+static void recorder_apply_reconfig(audio_recorder_t *recorder);
+
+/* Drop an AFE output in idle mode, keeping the frame timestamps in step with the audio */
+static void recorder_skip_output(audio_recorder_t *recorder, size_t len)
+{
+    uint32_t rate = recorder->downsample ? AUDIO_RECORDER_AFE_SAMPLE_RATE : recorder->sample_rate;
+    int64_t skipped_us = (int64_t)(len / sizeof(int16_t)) * 1000000 / rate;
+
+    /* The partial frame is dropped too, the next one starts after this output */
+    recorder->frame_start_us += (int64_t)(recorder->pcm_filled / sizeof(int16_t)) * 1000000 / recorder->sample_rate + skipped_us;
+    recorder->pcm_filled = 0;
+    audio_convert_resampler_reset(&recorder->resampler);
+    recorder->perf.idle_audio_us += skipped_us;
+}
+
+static esp_gmf_err_io_t recorder_outport_release_write(void *handle, esp_gmf_data_bus_block_t *blk, int block_ticks)
+{
+    audio_recorder_t *recorder = (audio_recorder_t *)handle;
+    uint8_t *src = blk->buf;
+    size_t left = blk->valid_size;
+    size_t frame_size = recorder->pcm_frame_size;
+
+    if (recorder->idle) {
+        recorder_skip_output(recorder, blk->valid_size);
+        if (recorder->reconfig_pending) {
+            recorder_apply_reconfig(recorder);
+        }
+        return ESP_GMF_IO_OK;
+    }
+
+    if (recorder->downsample) {
+        size_t samples = blk->valid_size / sizeof(int16_t);
+        if (samples / 2 > recorder->rs_buf_size) {
+            int16_t *rs_buf = (int16_t *)realloc(recorder->rs_buf, samples / 2 * sizeof(int16_t));
+            if (rs_buf == NULL) {
+                ESP_LOGE(TAG, "Failed to allocate resampler buffer");
+                return ESP_GMF_IO_FAIL;
+            }
+            recorder->rs_buf = rs_buf;
+            recorder->rs_buf_size = samples / 2;
+        }
+        left = audio_convert_downsample_2x(&recorder->resampler, (const int16_t *)blk->buf, recorder->rs_buf, samples) * sizeof(int16_t);
+        src = (uint8_t *)recorder->rs_buf;
+    }
+
+    /* Complete the frame left over from the previous AFE output first */
+    if (recorder->pcm_filled > 0) {
+        size_t copy_len = frame_size - recorder->pcm_filled;
+        copy_len = (left < copy_len) ? left : copy_len;
+        memcpy(recorder->pcm_buf + recorder->pcm_filled, src, copy_len);
+        recorder->pcm_filled += copy_len;
+        src += copy_len;
+        left -= copy_len;
+        if (recorder->pcm_filled < frame_size) {
+            return ESP_GMF_IO_OK;
+        }
+        recorder->pcm_filled = 0;
+        recorder_encode_frame(recorder, recorder->pcm_buf, block_ticks);
+    }
+
+    /* Whole frames are encoded in place from the AFE output */
+    while (left >= frame_size) {
+        recorder_encode_frame(recorder, src, block_ticks);
+        src += frame_size;
+        left -= frame_size;
+    }
+
+    if (left > 0) {
+        memcpy(recorder->pcm_buf, src, left);
+        recorder->pcm_filled = left;
+    }
+
+    if (recorder->reconfig_pending) {
+        recorder_apply_reconfig(recorder);
+    }
+    return ESP_GMF_IO_OK;
+}
+
 static esp_gmf_err_io_t recorder_inport_acquire_read(void *handle, esp_gmf_data_bus_block_t *blk, int wanted_size, int block_ticks)
 {
     audio_recorder_t *recorder = (audio_recorder_t *)handle;
@@ -106,6 +353,19 @@ static esp_gmf_err_io_t recorder_inport_acquire_read(void *handle, esp_gmf_data_
     esp_codec_dev_read(recorder->in_dev_handle, blk->buf, wanted_size);
     blk->valid_size = wanted_size;
 
+    int64_t now = esp_timer_get_time();
+    size_t samples = wanted_size / recorder->in_sample_bytes;
+    int64_t chunk_us = (int64_t)samples * 1000000 / AUDIO_RECORDER_AFE_SAMPLE_RATE;
+    if (recorder->last_read_us > 0 && now - recorder->last_read_us > 2 * chunk_us) {
+        recorder->perf.feed_overruns++;
+    }
+    recorder->last_read_us = now;
+
+    portENTER_CRITICAL(&recorder->clock_lock);
+    recorder->in_samples += samples;
+    recorder->in_time_us = now;
+    portEXIT_CRITICAL(&recorder->clock_lock);
+
     return ESP_GMF_IO_OK;
 }
 
@@ -115,27 +375,114 @@ static esp_gmf_err_io_t recorder_inport_release_read(void *handle, esp_gmf_data_
 }
 
 
-static esp_gmf_err_t pipeline_setup_elements(esp_gmf_pipeline_handle_t pipeline_handle, audio_recorder_handle_t recorder_handle)
+static bool recorder_sample_rate_is_valid(uint32_t sample_rate)
 {
-    esp_gmf_err_t err = ESP_GMF_ERR_OK;
-    esp_gmf_element_handle_t ele = NULL;
-    audio_recorder_t *recorder = (audio_recorder_t *)recorder_handle;
+    switch (sample_rate) {
+    case 8000:
+    case 12000:
+    case 16000:
+    case 24000:
+    case 48000:
+        return true;
+    default:
+        return false;
+    }
+}
 
-    err = esp_gmf_pipeline_get_el_by_name(pipeline_handle, "aud_enc", &ele);
-    if (err != ESP_GMF_ERR_OK) {
-        ESP_LOGE(TAG, "Failed to get audio enc element: %x", err);
-        return err;
+static esp_opus_enc_frame_duration_t recorder_opus_frame_duration(uint32_t frame_duration_us)
+{
+    switch (frame_duration_us) {
+    case 2500:
+        return ESP_OPUS_ENC_FRAME_DURATION_2_5_MS;
+    case 5000:
+        return ESP_OPUS_ENC_FRAME_DURATION_5_MS;
+    case 10000:
+        return ESP_OPUS_ENC_FRAME_DURATION_10_MS;
+    case 20000:
+        return ESP_OPUS_ENC_FRAME_DURATION_20_MS;
+    case 40000:
+        return ESP_OPUS_ENC_FRAME_DURATION_40_MS;
+    case 60000:
+        return ESP_OPUS_ENC_FRAME_DURATION_60_MS;
+    case 80000:
+        return ESP_OPUS_ENC_FRAME_DURATION_80_MS;
+    case 100000:
+        return ESP_OPUS_ENC_FRAME_DURATION_100_MS;
+    case 120000:
+        return ESP_OPUS_ENC_FRAME_DURATION_120_MS;
+    default:
+        return ESP_OPUS_ENC_FRAME_DURATION_ARG;
+    }
+}
+
+static bool recorder_config_is_valid(audio_recorder_codec_t codec, uint32_t sample_rate, uint32_t frame_duration_us)
+{
+    if (!recorder_sample_rate_is_valid(sample_rate)) {
+        return false;
     }
+    if (codec == AUDIO_RECORDER_CODEC_PCM) {
+        return frame_duration_us > 0 && ((uint64_t)sample_rate * frame_duration_us) % 1000000 == 0;
+    }
+    return recorder_opus_frame_duration(frame_duration_us) != ESP_OPUS_ENC_FRAME_DURATION_ARG;
+}
 
-    esp_opus_enc_frame_duration_t frame_duration = ESP_OPUS_ENC_FRAME_DURATION_ARG;
-    if (recorder->frame_duration_ms == 20) {
-        frame_duration = ESP_OPUS_ENC_FRAME_DURATION_20_MS;
-    } else if (recorder->frame_duration_ms == 60) {
-        frame_duration = ESP_OPUS_ENC_FRAME_DURATION_60_MS;
+/*
+ * A packet whose frames all have zero length carries no audio, which Opus decoders treat as DTX.
+ * Its TOC (RFC 6716, 3.1) uses the encoder bandwidth and duration: SILK-only for 10 to 60 ms,
+ * CELT-only below 10 ms, and a code 3 packet of several 20, 40 or 60 ms frames above 60 ms.
+ */
+static void recorder_opus_silence_frame(audio_recorder_t *recorder)
+{
+    uint32_t frame_duration_us = recorder->frame_duration_us;
+    uint32_t sample_rate = recorder->sample_rate;
+    uint8_t config;
+    uint8_t frame_count = 1;
+
+    if (frame_duration_us < 10000) {
+        config = (sample_rate <= 8000) ? 16 : 20;       /* CELT NB or WB */
+        config += (frame_duration_us == 2500) ? 0 : 1;
     } else {
-        ESP_LOGE(TAG, "Invalid frame duration: %d", recorder->frame_duration_ms);
-        return ESP_GMF_ERR_INVALID_ARG;
+        config = 8;                                     /* SILK WB */
+        if (sample_rate <= 8000) {
+            config = 0;                                 /* SILK NB */
+        } else if (sample_rate <= 12000) {
+            config = 4;                                 /* SILK MB */
+        }
+
+        uint32_t code_us = frame_duration_us;
+        if (frame_duration_us == 100000) {
+            code_us = 20000;
+        } else if (frame_duration_us > 60000) {
+            code_us = frame_duration_us / 2;
+        }
+        frame_count = frame_duration_us / code_us;
+        config += (code_us == 10000) ? 0 : (code_us == 20000) ? 1 : (code_us == 40000) ? 2 : 3;
+    }
+
+    /* Mono, one frame (code 0) or a CBR code 3 packet of empty frames */
+    recorder->silence_frame[0] = (config << 3) | (frame_count > 1 ? 3 : 0);
+    recorder->silence_frame[1] = frame_count;
+    recorder->silence_len = (frame_count > 1) ? 2 : 1;
+}
+
+static esp_err_t recorder_encoder_open(audio_recorder_t *recorder)
+{
+    if (!recorder_config_is_valid(recorder->codec, recorder->sample_rate, recorder->frame_duration_us)) {
+        ESP_LOGE(TAG, "Invalid config: %" PRIu32 " Hz, %" PRIu32 " us", recorder->sample_rate, recorder->frame_duration_us);
+        return ESP_ERR_INVALID_ARG;
     }
+
+    if (recorder->codec == AUDIO_RECORDER_CODEC_PCM) {
+        /* Frames are copied as they come out of the resampler */
+        recorder->pcm_frame_size = (uint64_t)recorder->sample_rate * recorder->frame_duration_us / 1000000 * sizeof(int16_t);
+        recorder->enc_frame_size = recorder->pcm_frame_size;
+        recorder->silence_len = 0;
+        goto alloc;
+    }
+
+    esp_opus_enc_frame_duration_t frame_duration = recorder_opus_frame_duration(recorder->frame_duration_us);
+    recorder_opus_silence_frame(recorder);
+
     esp_opus_enc_config_t opus_enc_cfg = ESP_OPUS_ENC_CONFIG_DEFAULT();
     opus_enc_cfg.application_mode = ESP_OPUS_ENC_APPLICATION_VOIP;
     opus_enc_cfg.frame_duration = frame_duration;
@@ -149,11 +496,127 @@ static esp_gmf_err_t pipeline_setup_elements(esp_gmf_pipeline_handle_t pipeline_
         .cfg = &opus_enc_cfg,
         .cfg_sz = sizeof(esp_opus_enc_config_t),
     };
-    err = esp_gmf_audio_enc_reconfig(ele, &enc_config);
-    if (err != ESP_GMF_ERR_OK) {
-        ESP_LOGE(TAG, "Failed to initialize audio enc: %x", err);
-        return err;
+    esp_audio_err_t err = esp_audio_enc_open(&enc_config, &recorder->encoder);
+    if (err != ESP_AUDIO_ERR_OK) {
+        ESP_LOGE(TAG, "Failed to open audio enc: %d", err);
+        return ESP_FAIL;
+    }
+
+    int in_size = 0;
+    int out_size = 0;
+    err = esp_audio_enc_get_frame_size(recorder->encoder, &in_size, &out_size);
+    if (err != ESP_AUDIO_ERR_OK || in_size <= 0 || out_size <= 0) {
+        ESP_LOGE(TAG, "Failed to get audio enc frame size: %d", err);
+        return ESP_FAIL;
+    }
+    recorder->pcm_frame_size = in_size;
+    recorder->enc_frame_size = out_size;
+
+alloc:
+    /* The 2x case is cheaper with the half-band kernel than with the generic converter */
+    recorder->downsample = (recorder->sample_rate * 2 == AUDIO_RECORDER_AFE_SAMPLE_RATE);
+    audio_convert_resampler_reset(&recorder->resampler);
+
+    recorder->pcm_buf = (uint8_t *)malloc(recorder->pcm_frame_size);
+    if (recorder->pcm_buf == NULL) {
+        ESP_LOGE(TAG, "Failed to allocate PCM frame buffer");
+        return ESP_ERR_NO_MEM;
+    }
+    recorder->pcm_filled = 0;
+    return ESP_OK;
+}
+
+static uint32_t recorder_rate_cvt_dest(audio_recorder_t *recorder)
+{
+    return recorder->downsample ? AUDIO_RECORDER_AFE_SAMPLE_RATE : recorder->sample_rate;
+}
+
+static void recorder_encoder_close(audio_recorder_t *recorder)
+{
+    if (recorder->encoder) {
+        esp_audio_enc_close(recorder->encoder);
+        recorder->encoder = NULL;
+    }
+    free(recorder->pcm_buf);
+    recorder->pcm_buf = NULL;
+    recorder->pcm_filled = 0;
+}
+
+/* Switch to the pending configuration, called by the recorder task between two AFE outputs */
+static void recorder_apply_reconfig(audio_recorder_t *recorder)
+{
+    portENTER_CRITICAL(&recorder->clock_lock);
+    uint32_t sample_rate = recorder->pending_sample_rate;
+    uint32_t frame_duration_us = recorder->pending_frame_duration_us;
+    recorder->reconfig_pending = false;
+    portEXIT_CRITICAL(&recorder->clock_lock);
+
+    /* The incomplete frame cannot be encoded with the new settings, skip its audio */
+    recorder->frame_start_us += (int64_t)(recorder->pcm_filled / sizeof(int16_t)) * 1000000 / recorder->sample_rate;
+
+    uint32_t old_sample_rate = recorder->sample_rate;
+    uint32_t old_frame_duration_us = recorder->frame_duration_us;
+    recorder_encoder_close(recorder);
+    recorder->sample_rate = sample_rate;
+    recorder->frame_duration_us = frame_duration_us;
+    if (recorder_encoder_open(recorder) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to reconfigure encoder, keeping %" PRIu32 " Hz %" PRIu32 " us", old_sample_rate, old_frame_duration_us);
+        recorder_encoder_close(recorder);
+        recorder->sample_rate = old_sample_rate;
+        recorder->frame_duration_us = old_frame_duration_us;
+        if (recorder_encoder_open(recorder) != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to reopen encoder");
+            return;
+        }
+    }
+
+    /* Takes effect from the next AFE output */
+    esp_gmf_element_handle_t rate_cvt = NULL;
+    if (esp_gmf_pipeline_get_el_by_name(recorder->pipeline_handle, "aud_rate_cvt", &rate_cvt) == ESP_GMF_ERR_OK) {
+        esp_gmf_rate_cvt_set_dest_rate(rate_cvt, recorder_rate_cvt_dest(recorder));
+    }
+    /* A recorder without a pre-roll, configured or fallen back to, stays without one */
+    recorder->preroll_resize = recorder->preroll.slot_count > 0;
+    ESP_LOGI(TAG, "Encoder reconfigured: %" PRIu32 " Hz, %" PRIu32 " us frames", recorder->sample_rate, recorder->frame_duration_us);
+}
+
+static esp_err_t recorder_preroll_init(audio_recorder_t *recorder)
+{
+    uint32_t slot_count = ((uint32_t)recorder->preroll_ms * 1000 + recorder->frame_duration_us - 1) / recorder->frame_duration_us;
+    if (recorder->commands) {
+        /* The whole command window is held, plus the frames still in the FIFO once it closes */
+        uint32_t window_slots = ((uint32_t)AUDIO_RECORDER_COMMAND_WINDOW_MS * 1000 + recorder->frame_duration_us - 1) / recorder->frame_duration_us;
+        window_slots += AUDIO_RECORDER_FIFO_BLOCK_COUNT;
+        slot_count = (slot_count > window_slots) ? slot_count : window_slots;
+    }
+
+    esp_err_t err = audio_preroll_init(&recorder->preroll, slot_count, recorder->enc_frame_size, recorder->frame_duration_us);
+    if (err != ESP_OK) {
+        /* The recorder runs without a pre-roll, as if none was configured */
+        if (recorder->commands) {
+            ESP_LOGW(TAG, "No memory for a %" PRIu32 " frame pre-roll, speech in the command window is dropped", slot_count);
+        } else {
+            ESP_LOGW(TAG, "No memory for a %d ms pre-roll, running without it", recorder->preroll_ms);
+        }
+    }
+    return err;
+}
+
+/* Apply a new frame size from the recorder task, called by the consuming task */
+static void recorder_preroll_sync(audio_recorder_t *recorder)
+{
+    if (recorder->preroll_resize) {
+        recorder->preroll_resize = false;
+        audio_preroll_deinit(&recorder->preroll);
+        recorder_preroll_init(recorder);
     }
+}
+
+static esp_gmf_err_t pipeline_setup_elements(esp_gmf_pipeline_handle_t pipeline_handle, audio_recorder_handle_t recorder_handle)
+{
+    esp_gmf_err_t err = ESP_GMF_ERR_OK;
+    esp_gmf_element_handle_t ele = NULL;
+    audio_recorder_t *recorder = (audio_recorder_t *)recorder_handle;
 
     err = esp_gmf_pipeline_get_el_by_name(pipeline_handle, "ai_afe", &ele);
     if (err != ESP_GMF_ERR_OK) {
@@ -166,8 +629,15 @@ static esp_gmf_err_t pipeline_setup_elements(esp_gmf_pipeline_handle_t pipeline_
         return err;
     }
 
+    err = esp_gmf_pipeline_get_el_by_name(pipeline_handle, "aud_rate_cvt", &ele);
+    if (err != ESP_GMF_ERR_OK) {
+        ESP_LOGE(TAG, "Failed to get rate cvt element: %x", err);
+        return err;
+    }
+    esp_gmf_rate_cvt_set_dest_rate(ele, recorder_rate_cvt_dest(recorder));
+
     esp_gmf_info_sound_t in_info = {
-        .sample_rates = recorder->sample_rate,
+        .sample_rates = AUDIO_RECORDER_AFE_SAMPLE_RATE,
         .bits = 16,
         .channels = 2,
     };
@@ -253,9 +723,10 @@ static esp_gmf_err_t pipeline_setup_ports(esp_gmf_pipeline_handle_t pipeline_han
 esp_gmf_pipeline_handle_t pipeline_init(esp_gmf_pool_handle_t pool, audio_recorder_handle_t recorder_handle)
 {
     esp_gmf_pipeline_handle_t pipeline_handle = NULL;
+    /* Encoding happens in the output port, straight into the FIFO blocks */
     const char *el_names[] = {
         "ai_afe",
-        "aud_enc",
+        "aud_rate_cvt",
     };
     size_t num_el = sizeof(el_names) / sizeof(el_names[0]);
     esp_gmf_err_t err = esp_gmf_pool_new_pipeline(pool,NULL, el_names, num_el, NULL, &pipeline_handle);
@@ -274,6 +745,58 @@ err:
     return NULL;
 }
 
+esp_err_t audio_recorder_get_afe_profile(audio_recorder_afe_preset_t preset, audio_recorder_afe_profile_t *profile)
+{
+    if (profile == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    switch (preset) {
+    case AUDIO_RECORDER_AFE_PRESET_HIGH_QUALITY:
+        *profile = (audio_recorder_afe_profile_t) {
+            .high_perf = true,
+            .prefer_psram = true,
+            .se_enable = false,
+            .agc_enable = true,
+            .vad_mode = 3,
+            .feed_core = 1,
+            .feed_prio = 6,
+            .fetch_core = 0,
+            .fetch_prio = 6,
+        };
+        break;
+    case AUDIO_RECORDER_AFE_PRESET_BALANCED:
+        *profile = (audio_recorder_afe_profile_t) {
+            .high_perf = false,
+            .prefer_psram = false,
+            .se_enable = false,
+            .agc_enable = true,
+            .vad_mode = 3,
+            .feed_core = 1,
+            .feed_prio = 6,
+            .fetch_core = 0,
+            .fetch_prio = 6,
+        };
+        break;
+    case AUDIO_RECORDER_AFE_PRESET_LOW_POWER:
+        *profile = (audio_recorder_afe_profile_t) {
+            .high_perf = false,
+            .prefer_psram = false,
+            .se_enable = false,
+            .agc_enable = false,
+            .vad_mode = 3,
+            .feed_core = 1,
+            .feed_prio = 5,
+            .fetch_core = 1,
+            .fetch_prio = 5,
+        };
+        break;
+    default:
+        return ESP_ERR_INVALID_ARG;
+    }
+    return ESP_OK;
+}
+
 audio_recorder_handle_t audio_recorder_init(const audio_recorder_config_t *config)
 {
     if (config == NULL || config->format == NULL || config->in_dev_handle == NULL) {
@@ -290,7 +813,15 @@ audio_recorder_handle_t audio_recorder_init(const audio_recorder_config_t *confi
     // Store codec device handle
     recorder->in_dev_handle = config->in_dev_handle;
     recorder->sample_rate = config->sample_rate;
-    recorder->frame_duration_ms = config->frame_duration_ms;
+    recorder->frame_duration_us = config->frame_duration_us ? config->frame_duration_us : config->frame_duration_ms * 1000;
+    recorder->codec = config->codec;
+    recorder->in_sample_bytes = strlen(config->format) * sizeof(int16_t);
+    recorder->clock_lock = (portMUX_TYPE)portMUX_INITIALIZER_UNLOCKED;
+    recorder->preroll_ms = config->preroll_ms;
+    if (config->commands && config->num_commands) {
+        recorder->commands = config->commands;
+        recorder->num_commands = config->num_commands;
+    }
 
     esp_gmf_err_t err = audio_pool_setup();
     if (err != ESP_GMF_ERR_OK) {
@@ -303,7 +834,15 @@ audio_recorder_handle_t audio_recorder_init(const audio_recorder_config_t *confi
         goto err;
     }
 
-    esp_gmf_afe_manager_handle_t gmf_afe_manager = (esp_gmf_afe_manager_handle_t)audio_pool_register_afe(config->format);
+    audio_recorder_afe_profile_t afe_profile;
+    if (config->afe_profile) {
+        afe_profile = *config->afe_profile;
+    } else {
+        audio_recorder_get_afe_profile(AUDIO_RECORDER_AFE_PRESET_HIGH_QUALITY, &afe_profile);
+    }
+
+    esp_gmf_afe_manager_handle_t gmf_afe_manager = (esp_gmf_afe_manager_handle_t)audio_pool_register_afe(
+        config->format, &afe_profile, recorder->commands ? (config->command_language ? config->command_language : "en") : NULL);
     if (gmf_afe_manager == NULL) {
         ESP_LOGE(TAG, "Failed to register AFE to shared pool");
         goto err;
@@ -322,6 +861,14 @@ audio_recorder_handle_t audio_recorder_init(const audio_recorder_config_t *confi
         goto err;
     }
 
+    if (recorder_encoder_open(recorder) != ESP_OK) {
+        goto err;
+    }
+
+    if ((recorder->preroll_ms > 0 || recorder->commands) && recorder_preroll_init(recorder) != ESP_OK) {
+        recorder->preroll_ms = 0;
+    }
+
     err = pipeline_setup_elements(recorder->pipeline_handle, (audio_recorder_handle_t)recorder);
     if (err != ESP_GMF_ERR_OK) {
         ESP_LOGE(TAG, "Failed to setup elements: %x", err);
@@ -362,6 +909,10 @@ esp_err_t audio_recorder_deinit(audio_recorder_handle_t handle)
         recorder->fifo_handle = NULL;
     }
 
+    recorder_encoder_close(recorder);
+    free(recorder->rs_buf);
+    audio_preroll_deinit(&recorder->preroll);
+
     free(recorder);
 
     ESP_LOGI(TAG, "Audio recorder deinitialized");
@@ -380,29 +931,218 @@ esp_err_t audio_recorder_start(audio_recorder_handle_t handle)
     return ESP_OK;
 }
 
-esp_err_t audio_recorder_read(audio_recorder_handle_t handle, uint8_t *data, size_t len, size_t *read_len)
+esp_err_t audio_recorder_acquire_frame(audio_recorder_handle_t handle, audio_recorder_frame_t *frame, uint32_t timeout_ms)
 {
-    if (handle == NULL || data == NULL || len == 0) {
+    if (handle == NULL || frame == NULL) {
         return ESP_ERR_INVALID_ARG;
     }
 
-    esp_err_t err = ESP_OK;
+    audio_recorder_t *recorder = (audio_recorder_t *)handle;
+    if (recorder->frame_held) {
+        ESP_LOGE(TAG, "Previous frame not released");
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    int ticks = (timeout_ms == AUDIO_RECORDER_WAIT_FOREVER) ? portMAX_DELAY : pdMS_TO_TICKS(timeout_ms);
+    esp_gmf_data_bus_block_t blk = {0};
+    audio_recorder_frame_meta_t meta;
+    while (true) {
+        int ret = esp_gmf_fifo_acquire_read(recorder->fifo_handle, &blk, recorder->enc_frame_size, ticks);
+        if (ret == ESP_GMF_IO_TIMEOUT) {
+            return ESP_ERR_TIMEOUT;
+        } else if (ret != ESP_GMF_IO_OK) {
+            return ESP_FAIL;
+        }
+        meta = recorder->meta[recorder->meta_read++ % AUDIO_RECORDER_FIFO_BLOCK_COUNT];
+        if (blk.valid_size > 0) {
+            break;
+        }
+        /* Frame that failed to encode */
+        esp_gmf_fifo_release_read(recorder->fifo_handle, &blk, ticks);
+    }
+
+    recorder->held_blk = blk;
+    recorder->held_frame.data = blk.buf;
+    recorder->held_frame.len = blk.valid_size;
+    recorder->held_frame.seq = meta.seq;
+    recorder->held_frame.timestamp_us = meta.timestamp_us;
+    recorder->frame_held = true;
+    *frame = recorder->held_frame;
+    return ESP_OK;
+}
+
+esp_err_t audio_recorder_release_frame(audio_recorder_handle_t handle, audio_recorder_frame_t *frame)
+{
+    if (handle == NULL || frame == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    audio_recorder_t *recorder = (audio_recorder_t *)handle;
+    if (!recorder->frame_held || frame->data != recorder->held_blk.buf) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    if (recorder->preroll.slot_count > 0) {
+        recorder_preroll_sync(recorder);
+        audio_preroll_store(&recorder->preroll, &recorder->held_frame);
+    }
+
+    recorder->frame_held = false;
+    memset(frame, 0, sizeof(*frame));
+    esp_gmf_fifo_release_read(recorder->fifo_handle, &recorder->held_blk, portMAX_DELAY);
+    return ESP_OK;
+}
+
+esp_err_t audio_recorder_read_frame(audio_recorder_handle_t handle, uint8_t *data, size_t len, audio_recorder_frame_t *frame, uint32_t timeout_ms)
+{
+    if (handle == NULL || data == NULL || frame == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
 
     audio_recorder_t *recorder = (audio_recorder_t *)handle;
-    esp_gmf_data_bus_block_t blk;
 
-    err = esp_gmf_fifo_acquire_read(recorder->fifo_handle, &blk, len, portMAX_DELAY);
-    if (err != ESP_GMF_IO_OK) {
+    /* A frame left pending by a too small buffer is returned again */
+    if (!recorder->frame_held) {
+        esp_err_t err = audio_recorder_acquire_frame(handle, frame, timeout_ms);
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+
+    *frame = recorder->held_frame;
+    if (frame->len > len) {
+        ESP_LOGD(TAG, "Frame %" PRIu32 " needs %d bytes, buffer has %d", frame->seq, frame->len, len);
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    memcpy(data, recorder->held_frame.data, frame->len);
+    audio_recorder_frame_t held = recorder->held_frame;
+    audio_recorder_release_frame(handle, &held);
+    frame->data = data;
+    return ESP_OK;
+}
+
+esp_err_t audio_recorder_read(audio_recorder_handle_t handle, uint8_t *data, size_t len, size_t *read_len)
+{
+    if (handle == NULL || data == NULL || len == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    audio_recorder_frame_t frame;
+    esp_err_t err = audio_recorder_acquire_frame(handle, &frame, AUDIO_RECORDER_WAIT_FOREVER);
+    if (err != ESP_OK) {
         *read_len = 0;
         return err;
     }
 
-    size_t copy_len = (blk.valid_size < len) ? blk.valid_size : len;
-    memcpy(data, blk.buf, copy_len);
+    size_t copy_len = (frame.len < len) ? frame.len : len;
+    memcpy(data, frame.data, copy_len);
     *read_len = copy_len;
 
-    esp_gmf_fifo_release_read(recorder->fifo_handle, &blk, portMAX_DELAY);
+    return audio_recorder_release_frame(handle, &frame);
+}
+
+esp_err_t audio_recorder_reconfigure(audio_recorder_handle_t handle, uint32_t sample_rate, uint32_t frame_duration_us)
+{
+    if (handle == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    audio_recorder_t *recorder = (audio_recorder_t *)handle;
+    if (recorder->frame_held) {
+        ESP_LOGE(TAG, "Cannot reconfigure while a frame is held");
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (!recorder_config_is_valid(recorder->codec, sample_rate, frame_duration_us)) {
+        ESP_LOGE(TAG, "Unsupported config: %" PRIu32 " Hz, %" PRIu32 " us", sample_rate, frame_duration_us);
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    portENTER_CRITICAL(&recorder->clock_lock);
+    recorder->pending_sample_rate = sample_rate;
+    recorder->pending_frame_duration_us = frame_duration_us;
+    recorder->reconfig_pending = true;
+    portEXIT_CRITICAL(&recorder->clock_lock);
+    return ESP_OK;
+}
+
+esp_err_t audio_recorder_get_silence_frame(audio_recorder_handle_t handle, audio_recorder_frame_t *frame)
+{
+    if (handle == NULL || frame == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    audio_recorder_t *recorder = (audio_recorder_t *)handle;
+    if (recorder->codec == AUDIO_RECORDER_CODEC_PCM) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    memset(frame, 0, sizeof(*frame));
+    frame->data = recorder->silence_frame;
+    frame->len = recorder->silence_len;
+    frame->timestamp_us = esp_timer_get_time();
+    return ESP_OK;
+}
+
+esp_err_t audio_recorder_preroll_arm(audio_recorder_handle_t handle)
+{
+    if (handle == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    audio_recorder_t *recorder = (audio_recorder_t *)handle;
+    if (recorder->preroll.slot_count == 0) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    audio_preroll_arm(&recorder->preroll, true);
+    return ESP_OK;
+}
+
+esp_err_t audio_recorder_preroll_flush(audio_recorder_handle_t handle, uint32_t max_ms, audio_recorder_frame_cb_t cb, void *user_data)
+{
+    if (handle == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    audio_recorder_t *recorder = (audio_recorder_t *)handle;
+    if (recorder->preroll.slot_count == 0) {
+        return ESP_OK;
+    }
+
+    recorder_preroll_sync(recorder);
+    return audio_preroll_flush(&recorder->preroll, max_ms, cb, user_data);
+}
+
+audio_recorder_hold_t audio_recorder_command_hold(audio_recorder_handle_t handle)
+{
+    audio_recorder_t *recorder = (audio_recorder_t *)handle;
+    if (recorder == NULL || recorder->commands == NULL) {
+        return AUDIO_RECORDER_HOLD_NONE;
+    }
+
+    return audio_preroll_hold(&recorder->preroll);
+}
+
+esp_err_t audio_recorder_get_perf_stats(audio_recorder_handle_t handle, audio_recorder_perf_stats_t *stats)
+{
+    if (handle == NULL || stats == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    audio_recorder_t *recorder = (audio_recorder_t *)handle;
+    *stats = recorder->perf;
+    return ESP_OK;
+}
 
+esp_err_t audio_recorder_get_preroll_stats(audio_recorder_handle_t handle, audio_recorder_preroll_stats_t *stats)
+{
+    if (handle == NULL || stats == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    audio_recorder_t *recorder = (audio_recorder_t *)handle;
+    *stats = recorder->preroll.stats;
     return ESP_OK;
 }
 
@@ -420,6 +1160,54 @@ esp_err_t audio_recorder_add_event_cb(audio_recorder_handle_t handle, audio_reco
     return ESP_OK;
 }
 
+esp_err_t audio_recorder_set_idle(audio_recorder_handle_t handle, bool idle)
+{
+    if (handle == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    audio_recorder_t *recorder = (audio_recorder_t *)handle;
+    if (recorder->idle != idle) {
+        ESP_LOGD(TAG, "Idle mode %s", idle ? "entered" : "left");
+    }
+    if (recorder->commands) {
+        audio_preroll_command_t command = recorder->preroll.command;
+        if (idle && command == AUDIO_PREROLL_COMMAND_OPEN) {
+            /* The turn ended before MultiNet did, the held frames are left to the pre-roll */
+            audio_preroll_set_command(&recorder->preroll, AUDIO_PREROLL_COMMAND_TIMEOUT);
+        } else if (!idle && recorder->idle && command == AUDIO_PREROLL_COMMAND_MATCHED) {
+            /* A turn started without a wake word has no command to drop */
+            audio_preroll_set_command(&recorder->preroll, AUDIO_PREROLL_COMMAND_NONE);
+        }
+    }
+    recorder->idle = idle;
+
+    return ESP_OK;
+}
+
+bool audio_recorder_is_idle(audio_recorder_handle_t handle)
+{
+    audio_recorder_t *recorder = (audio_recorder_t *)handle;
+    return recorder ? recorder->idle : false;
+}
+
+esp_err_t audio_recorder_set_command_cb(audio_recorder_handle_t handle, audio_recorder_command_cb_t cb, void *user_data)
+{
+    if (!handle || !cb) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    audio_recorder_t *recorder = (audio_recorder_t *)handle;
+    if (recorder->commands == NULL) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    recorder->command_cb = cb;
+    recorder->command_cb_user_data = user_data;
+
+    return ESP_OK;
+}
+
 esp_err_t audio_recorder_stay_awake(audio_recorder_handle_t handle, bool awake)
 {
     if (handle == NULL) {
@@ -8,6 +8,8 @@
 #define __AUDIO_RECORDER_H__
 
 #include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
 #include <esp_err.h>
 
 #include <esp_codec_dev.h>
@@ -18,23 +20,115 @@ extern "C" {
 
 typedef void *audio_recorder_handle_t;
 
+/** Timeout value that makes audio_recorder_acquire_frame() block until a frame is available */
+#define AUDIO_RECORDER_WAIT_FOREVER UINT32_MAX
+
+/** How long MultiNet listens for a voice command after the wake word */
+#define AUDIO_RECORDER_COMMAND_WINDOW_MS 3000
+
+/**
+ * @brief AFE profile presets
+ */
+typedef enum {
+    AUDIO_RECORDER_AFE_PRESET_HIGH_QUALITY,     /*!< High performance AFE, AGC, buffers in PSRAM, feed and fetch on separate cores */
+    AUDIO_RECORDER_AFE_PRESET_BALANCED,         /*!< Low cost AFE, AGC, internal RAM preferred for hot buffers */
+    AUDIO_RECORDER_AFE_PRESET_LOW_POWER,        /*!< Low cost AFE without AGC, feed and fetch both on core 1 */
+} audio_recorder_afe_preset_t;
+
+/**
+ * @brief AFE performance profile
+ *
+ * @param high_perf Use AFE_MODE_HIGH_PERF instead of AFE_MODE_LOW_COST
+ * @param prefer_psram Place most AFE buffers in PSRAM (AFE_MEMORY_ALLOC_MORE_PSRAM),
+ *                     otherwise balance them between internal RAM and PSRAM
+ * @param se_enable Enable speech enhancement (beamforming)
+ * @param agc_enable Enable automatic gain control
+ * @param vad_mode VAD aggressiveness, 0 (least) to 4 (most)
+ * @param feed_core Core of the AFE feed task
+ * @param feed_prio Priority of the AFE feed task
+ * @param fetch_core Core of the AFE fetch task
+ * @param fetch_prio Priority of the AFE fetch task
+ */
+typedef struct {
+    bool high_perf;
+    bool prefer_psram;
+    bool se_enable;
+    bool agc_enable;
+    uint8_t vad_mode;
+    int8_t feed_core;
+    uint8_t feed_prio;
+    int8_t fetch_core;
+    uint8_t fetch_prio;
+} audio_recorder_afe_profile_t;
+
+/**
+ * @brief Codec of the recorded frames
+ */
+typedef enum {
+    AUDIO_RECORDER_CODEC_OPUS,      /*!< One Opus packet per frame */
+    AUDIO_RECORDER_CODEC_PCM,       /*!< Raw 16-bit mono little endian PCM, no encoding */
+} audio_recorder_codec_t;
+
+/**
+ * @brief On-device voice command
+ *
+ * @param id Id reported when the command is detected, 0 or more. Several phrases can share an id
+ * @param phrase Phrase in the MultiNet language, for English lower case words, e.g. "volume up"
+ */
+typedef struct {
+    int id;
+    const char *phrase;
+} audio_recorder_command_t;
+
 /**
  * @brief Audio recorder configuration
  *
  * @param format Channel configuration for AFE
  * @param in_dev_handle Handle to the input device
- * @param sample_rate Sample rate in Hz
+ * @param sample_rate Encoded sample rate in Hz: 8000, 12000, 16000, 24000 or 48000.
+ *                    The AFE output is resampled when it differs from 16000
  * @param frame_duration_ms Frame duration in milliseconds(for OPUS encoding only)
+ * @param frame_duration_us Frame duration in microseconds, takes precedence over frame_duration_ms when non-zero.
+ *                          Opus supports 2500, 5000, 10000, 20000, 40000, 60000, 80000, 100000 and 120000
+ * @param preroll_ms Length of the encoded pre-roll kept after a wake word, 0 to disable.
+ *                   The pre-roll is allocated in PSRAM, or internal RAM without it. The recorder
+ *                   runs without a pre-roll if neither has room. With commands, it is made long
+ *                   enough to hold the AUDIO_RECORDER_COMMAND_WINDOW_MS after the wake word
+ * @param afe_profile AFE performance profile, NULL for AUDIO_RECORDER_AFE_PRESET_HIGH_QUALITY
+ * @param codec Codec of the frames, Opus by default. PCM frames can have any duration
+ *              that is a whole number of samples
+ * @param commands Voice commands recognized on device after the wake word, NULL to disable.
+ *                 The table and its phrases must stay valid until the recorder is deinitialized.
+ *                 Requires a MultiNet model in the model partition
+ * @param num_commands Number of entries in commands
+ * @param command_language MultiNet language of the phrases, "en" if NULL
  *
- * @note: All of the channels should be 16-bit, and the sample rate should be 16000.
+ * @note: All of the input channels should be 16-bit, and the input sample rate should be 16000.
  */
 typedef struct {
     const char *format;
     esp_codec_dev_handle_t in_dev_handle;
     uint16_t sample_rate;
     uint8_t frame_duration_ms;
+    uint32_t frame_duration_us;
+    uint16_t preroll_ms;
+    const audio_recorder_afe_profile_t *afe_profile;
+    audio_recorder_codec_t codec;
+    const audio_recorder_command_t *commands;
+    size_t num_commands;
+    const char *command_language;
 } audio_recorder_config_t;
 
+/**
+ * @brief What to do with a frame while voice commands are listened for
+ */
+typedef enum {
+    AUDIO_RECORDER_HOLD_NONE,       /*!< Send the frame */
+    AUDIO_RECORDER_HOLD_HELD,       /*!< Do not send the frame: it is held in the pre-roll until MultiNet decides,
+                                         or it belongs to a recognised command and is dropped */
+    AUDIO_RECORDER_HOLD_RELEASED,   /*!< No command was recognised: send the pre-roll, then the frame */
+} audio_recorder_hold_t;
+
 typedef enum {
     AUDIO_RECORDER_EVENT_WAKEUP_START,
     AUDIO_RECORDER_EVENT_WAKEUP_END,
@@ -43,8 +137,104 @@ typedef enum {
     AUDIO_RECORDER_EVENT_MAX,
 } audio_recorder_event_t;
 
+/**
+ * @brief One encoded frame
+ *
+ * @param data Encoded frame data. Points into the recorder FIFO when acquired with
+ *             audio_recorder_acquire_frame() and is valid until audio_recorder_release_frame()
+ * @param len Length of the encoded frame in bytes
+ * @param seq Sequence number, incremented per encoded frame. A gap means frames were dropped
+ * @param timestamp_us Capture time of the first sample of the frame, in esp_timer_get_time() time base
+ */
+typedef struct {
+    const uint8_t *data;
+    size_t len;
+    uint32_t seq;
+    int64_t timestamp_us;
+} audio_recorder_frame_t;
+
 typedef void (*audio_recorder_event_cb_t)(audio_recorder_handle_t handle, audio_recorder_event_t event, void *user_data);
 
+/**
+ * @brief Detected voice command
+ *
+ * @param id Id of the matched command
+ * @param prob Detection probability, 0 to 1
+ * @param wakeup_us Time of the wake word that started the detection, in esp_timer_get_time() time base
+ * @param detect_us Time the command was detected, in esp_timer_get_time() time base
+ */
+typedef struct {
+    int id;
+    float prob;
+    int64_t wakeup_us;
+    int64_t detect_us;
+} audio_recorder_command_result_t;
+
+/**
+ * @brief Callback receiving detected voice commands
+ *
+ * Runs in the AFE task, so it should only hand the command over to another task.
+ *
+ * @param handle The handle to the audio recorder
+ * @param result The detected command, only valid during the callback
+ * @param user_data User data passed to audio_recorder_set_command_cb()
+ */
+typedef void (*audio_recorder_command_cb_t)(audio_recorder_handle_t handle, const audio_recorder_command_result_t *result, void *user_data);
+
+/**
+ * @brief Callback receiving frames flushed from the pre-roll
+ *
+ * @param frame The frame, only valid during the callback
+ * @param user_data User data passed to audio_recorder_preroll_flush()
+ * @return ESP_OK to continue, any other value stops the flush
+ */
+typedef esp_err_t (*audio_recorder_frame_cb_t)(const audio_recorder_frame_t *frame, void *user_data);
+
+/**
+ * @brief Recorder processing statistics, cumulative since init
+ *
+ * @param frames_encoded Frames encoded successfully
+ * @param frames_dropped Frames lost to encoder errors or a full FIFO
+ * @param encode_time_us Total time spent in the encoder
+ * @param feed_overruns Microphone reads that returned more than twice as late as the audio they carried,
+ *                      meaning the AFE feed task fell behind and the capture DMA likely overflowed
+ * @param fetch_overruns Times the encoded FIFO was full and the AFE output had to wait for the consumer
+ * @param idle_audio_us AFE output dropped unprocessed in idle mode
+ */
+typedef struct {
+    uint32_t frames_encoded;
+    uint32_t frames_dropped;
+    uint64_t encode_time_us;
+    uint32_t feed_overruns;
+    uint32_t fetch_overruns;
+    uint64_t idle_audio_us;
+} audio_recorder_perf_stats_t;
+
+/**
+ * @brief Pre-roll statistics
+ *
+ * @param flushes Number of flushes that delivered at least one frame
+ * @param frames_salvaged Total frames delivered from the pre-roll
+ * @param ms_salvaged Total audio delivered from the pre-roll, in milliseconds
+ * @param frames_overwritten Frames lost because the pre-roll was full
+ */
+typedef struct {
+    uint32_t flushes;
+    uint32_t frames_salvaged;
+    uint32_t ms_salvaged;
+    uint32_t frames_overwritten;
+} audio_recorder_preroll_stats_t;
+
+/* @brief Get an AFE profile preset
+ *
+ * The returned profile can be adjusted before passing it in audio_recorder_config_t.
+ *
+ * @param preset The preset
+ * @param profile Filled with the preset values
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG for an unknown preset
+ */
+esp_err_t audio_recorder_get_afe_profile(audio_recorder_afe_preset_t preset, audio_recorder_afe_profile_t *profile);
+
 /* @brief Initialize the audio recorder
  *
  * This function initializes the audio recorder with the given configuration.
@@ -65,12 +255,173 @@ audio_recorder_handle_t audio_recorder_init(const audio_recorder_config_t *confi
  */
 esp_err_t audio_recorder_start(audio_recorder_handle_t handle);
 
+/* @brief Acquire the next encoded frame without copying it
+ *
+ * The frame points directly into the recorder FIFO and must be handed back with
+ * audio_recorder_release_frame() before the next one can be acquired.
+ * The FIFO block stays occupied while the frame is held, so hold it only as long as needed.
+ *
+ * @param handle The handle to the audio recorder
+ * @param frame Filled with the frame data and length
+ * @param timeout_ms Time to wait for a frame, or AUDIO_RECORDER_WAIT_FOREVER
+ * @return ESP_OK on success, ESP_ERR_TIMEOUT if no frame was encoded in time,
+ *         ESP_ERR_INVALID_STATE if a frame is still held, otherwise an error code
+ */
+esp_err_t audio_recorder_acquire_frame(audio_recorder_handle_t handle, audio_recorder_frame_t *frame, uint32_t timeout_ms);
+
+/* @brief Release a frame acquired with audio_recorder_acquire_frame()
+ *
+ * @param handle The handle to the audio recorder
+ * @param frame The frame to release, cleared on return
+ * @return ESP_OK on success, ESP_ERR_INVALID_STATE if the frame is not held, otherwise an error code
+ */
+esp_err_t audio_recorder_release_frame(audio_recorder_handle_t handle, audio_recorder_frame_t *frame);
+
+/* @brief Copy exactly one encoded frame into a buffer
+ *
+ * If the buffer is too small, the frame stays pending, frame->len is set to the size needed
+ * and the next call returns the same frame again.
+ *
+ * @param handle The handle to the audio recorder
+ * @param data Destination buffer
+ * @param len Size of the destination buffer
+ * @param frame Filled with the frame information, frame->data points to data
+ * @param timeout_ms Time to wait for a frame, or AUDIO_RECORDER_WAIT_FOREVER
+ * @return ESP_OK on success, ESP_ERR_TIMEOUT if no frame was encoded in time,
+ *         ESP_ERR_INVALID_SIZE if the buffer is too small, otherwise an error code
+ */
+esp_err_t audio_recorder_read_frame(audio_recorder_handle_t handle, uint8_t *data, size_t len, audio_recorder_frame_t *frame, uint32_t timeout_ms);
+
+/* @brief Copy the next encoded frame into a buffer
+ *
+ * Blocks until a frame is available. A frame larger than len is truncated.
+ * Prefer audio_recorder_read_frame() or audio_recorder_acquire_frame().
+ *
+ * @param handle The handle to the audio recorder
+ * @param data Destination buffer
+ * @param len Size of the destination buffer
+ * @param read_len Number of bytes copied
+ * @return ESP_OK on success, otherwise an error code
+ */
 esp_err_t audio_recorder_read(audio_recorder_handle_t handle, uint8_t *data, size_t len, size_t *read_len);
 
 esp_err_t audio_recorder_deinit(audio_recorder_handle_t handle);
 
+/* @brief Change the encoded sample rate and frame duration
+ *
+ * The new configuration is validated immediately and applied by the recorder task
+ * after the AFE output it is currently processing. Frames already encoded are still
+ * returned with the old configuration, and the pre-roll is cleared.
+ * Must be called from the task that acquires and releases frames, with no frame held.
+ *
+ * @param handle The handle to the audio recorder
+ * @param sample_rate Encoded sample rate in Hz
+ * @param frame_duration_us Frame duration in microseconds
+ * @return ESP_OK on success, ESP_ERR_NOT_SUPPORTED for a configuration the codec does not support,
+ *         otherwise an error code
+ */
+esp_err_t audio_recorder_reconfigure(audio_recorder_handle_t handle, uint32_t sample_rate, uint32_t frame_duration_us);
+
+/* @brief Get an empty (DTX) Opus frame matching the encoder configuration
+ *
+ * The frame carries a TOC but no audio, which decoders treat as discontinued transmission.
+ * It is meant as a cheap keepalive while no speech is sent.
+ * It is not part of the encoded stream, so it has no sequence number.
+ *
+ * @param handle The handle to the audio recorder
+ * @param frame Filled with the frame, the data stays valid until the recorder is deinitialized
+ * @return ESP_OK on success, ESP_ERR_NOT_SUPPORTED in PCM mode, otherwise an error code
+ */
+esp_err_t audio_recorder_get_silence_frame(audio_recorder_handle_t handle, audio_recorder_frame_t *frame);
+
+/* @brief Start keeping released frames in the pre-roll
+ *
+ * This is done automatically on AUDIO_RECORDER_EVENT_WAKEUP_START and undone on
+ * AUDIO_RECORDER_EVENT_WAKEUP_END. While armed, every frame handed back with
+ * audio_recorder_release_frame() is also kept, up to the configured pre-roll length.
+ *
+ * @param handle The handle to the audio recorder
+ * @return ESP_OK on success, ESP_ERR_NOT_SUPPORTED if no pre-roll is configured
+ */
+esp_err_t audio_recorder_preroll_arm(audio_recorder_handle_t handle);
+
+/* @brief Deliver the pre-roll, oldest frame first, and disarm it
+ *
+ * Must be called from the task that acquires and releases frames, before sending live frames.
+ *
+ * @param handle The handle to the audio recorder
+ * @param max_ms Only deliver the most recent max_ms of audio, 0 for all of it
+ * @param cb Callback receiving the frames, NULL to drop them
+ * @param user_data User data passed to the callback
+ * @return ESP_OK on success, otherwise the error returned by the callback
+ */
+esp_err_t audio_recorder_preroll_flush(audio_recorder_handle_t handle, uint32_t max_ms, audio_recorder_frame_cb_t cb, void *user_data);
+
+/* @brief Check whether the frame just acquired must be held back from the uplink
+ *
+ * MultiNet only recognises a command once it was spoken, so the frames after the wake word
+ * are held in the pre-roll while it listens, for AUDIO_RECORDER_COMMAND_WINDOW_MS at most.
+ * When a command is recognised they are dropped, and so is the rest of the turn until the
+ * recorder goes idle, so the command never reaches the server. Otherwise they are released
+ * for audio_recorder_preroll_flush(). Without a pre-roll, the frames of the window are dropped.
+ * Must be called from the task that acquires and releases frames, before sending the frame.
+ *
+ * @param handle The handle to the audio recorder
+ * @return The action for the frame, always AUDIO_RECORDER_HOLD_NONE if no commands are configured
+ */
+audio_recorder_hold_t audio_recorder_command_hold(audio_recorder_handle_t handle);
+
+/* @brief Get the recorder processing statistics
+ *
+ * @param handle The handle to the audio recorder
+ * @param stats Filled with the statistics
+ * @return ESP_OK on success, otherwise an error code
+ */
+esp_err_t audio_recorder_get_perf_stats(audio_recorder_handle_t handle, audio_recorder_perf_stats_t *stats);
+
+/* @brief Get the pre-roll statistics
+ *
+ * @param handle The handle to the audio recorder
+ * @param stats Filled with the statistics
+ * @return ESP_OK on success, otherwise an error code
+ */
+esp_err_t audio_recorder_get_preroll_stats(audio_recorder_handle_t handle, audio_recorder_preroll_stats_t *stats);
+
 esp_err_t audio_recorder_add_event_cb(audio_recorder_handle_t handle, audio_recorder_event_cb_t cb, void *user_data);
 
+/* @brief Enter or leave idle mode
+ *
+ * In idle mode only the AFE runs, for the wake word and voice commands. Its output is
+ * dropped before resampling and encoding, so no frames are produced and
+ * audio_recorder_acquire_frame() blocks. Idle mode is left automatically on
+ * AUDIO_RECORDER_EVENT_WAKEUP_START, before the audio following the wake word is processed.
+ * Frames already in the FIFO can still be acquired.
+ *
+ * @param handle The handle to the audio recorder
+ * @param idle true to enter idle mode, false to leave it
+ * @return ESP_OK on success, otherwise an error code
+ */
+esp_err_t audio_recorder_set_idle(audio_recorder_handle_t handle, bool idle);
+
+/* @brief Check whether the recorder is in idle mode
+ *
+ * @param handle The handle to the audio recorder
+ * @return true in idle mode
+ */
+bool audio_recorder_is_idle(audio_recorder_handle_t handle);
+
+/* @brief Set the callback receiving the voice commands configured in audio_recorder_config_t
+ *
+ * Commands are only listened for after a wake word, until one is detected or
+ * AUDIO_RECORDER_COMMAND_WINDOW_MS has passed. See audio_recorder_command_hold().
+ *
+ * @param handle The handle to the audio recorder
+ * @param cb The callback
+ * @param user_data User data passed to the callback
+ * @return ESP_OK on success, ESP_ERR_NOT_SUPPORTED if no commands are configured, otherwise an error code
+ */
+esp_err_t audio_recorder_set_command_cb(audio_recorder_handle_t handle, audio_recorder_command_cb_t cb, void *user_data);
+
 esp_err_t audio_recorder_stay_awake(audio_recorder_handle_t handle, bool awake);
 
 esp_err_t audio_recorder_trigger_sleep(audio_recorder_handle_t handle);
@@ -0,0 +1,70 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <audio_convert.h>
+
+/* One 20 ms frame at 16 kHz, the size the ports convert */
+#define BENCH_FRAMES  320
+#define BENCH_ROUNDS  20000
+
+static int16_t s16_in[2 * BENCH_FRAMES];
+static int16_t s16_out[2 * BENCH_FRAMES];
+static int32_t s32_in[2 * BENCH_FRAMES];
+static int32_t s32_out[2 * BENCH_FRAMES];
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/* Keeps the compiler from dropping the kernel calls */
+static volatile uint32_t sink;
+
+#define BENCH(name, call)                                                       \
+    do {                                                                        \
+        double start = now_ns();                                                \
+        for (int round = 0; round < BENCH_ROUNDS; round++) {                    \
+            call;                                                               \
+            sink += (uint32_t)s16_out[round % BENCH_FRAMES] + (uint32_t)s32_out[round % BENCH_FRAMES]; \
+        }                                                                       \
+        double ns = (now_ns() - start) / ((double)BENCH_ROUNDS * BENCH_FRAMES); \
+        printf("%-32s %8.3f ns/frame\n", name, ns);                             \
+    } while (0)
+
+int main(void)
+{
+    srand(1);
+    for (size_t i = 0; i < 2 * BENCH_FRAMES; i++) {
+        s16_in[i] = (int16_t)rand();
+        s32_in[i] = (int32_t)((uint32_t)rand() << 16 ^ (uint32_t)rand());
+    }
+
+    printf("%d frames per call, %d calls\n", BENCH_FRAMES, BENCH_ROUNDS);
+    BENCH("s16_mono_to_s32_stereo", audio_convert_s16_mono_to_s32_stereo(s16_in, s32_out, BENCH_FRAMES));
+    BENCH("s16_mono_to_s32_stereo_ref", audio_convert_s16_mono_to_s32_stereo_ref(s16_in, s32_out, BENCH_FRAMES));
+    BENCH("s16_mono_to_s16_stereo", audio_convert_s16_mono_to_s16_stereo(s16_in, s16_out, BENCH_FRAMES));
+    BENCH("s16_mono_to_s16_stereo_ref", audio_convert_s16_mono_to_s16_stereo_ref(s16_in, s16_out, BENCH_FRAMES));
+
+    audio_convert_resampler_t resampler = {0};
+    BENCH("downsample_2x", audio_convert_downsample_2x(&resampler, s16_in, s16_out, BENCH_FRAMES));
+    BENCH("downsample_2x_ref", audio_convert_downsample_2x_ref(&resampler, s16_in, s16_out, BENCH_FRAMES));
+    BENCH("upsample_2x", audio_convert_upsample_2x(&resampler, s16_in, s16_out, BENCH_FRAMES));
+    BENCH("upsample_2x_ref", audio_convert_upsample_2x_ref(&resampler, s16_in, s16_out, BENCH_FRAMES));
+
+    /* Stereo, as the mixer runs it */
+    BENCH("mix_s16", audio_convert_mix_s16(s16_in, s16_out, 2 * BENCH_FRAMES, AUDIO_CONVERT_GAIN_UNITY / 2));
+    BENCH("mix_s16_ref", audio_convert_mix_s16_ref(s16_in, s16_out, 2 * BENCH_FRAMES, AUDIO_CONVERT_GAIN_UNITY / 2));
+    BENCH("mix_s32", audio_convert_mix_s32(s32_in, s32_out, 2 * BENCH_FRAMES, AUDIO_CONVERT_GAIN_UNITY / 2));
+    BENCH("mix_s32_ref", audio_convert_mix_s32_ref(s32_in, s32_out, 2 * BENCH_FRAMES, AUDIO_CONVERT_GAIN_UNITY / 2));
+    return 0;
+}
@@ -0,0 +1,109 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include <esp_err.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+#include "host_sim.h"
+
+struct host_sim_semaphore {
+    bool is_mutex;
+    bool given;
+};
+
+static int64_t s_now_ms;
+static host_sim_tick_cb_t s_tick_cb;
+static void *s_tick_ctx;
+
+void host_sim_reset(host_sim_tick_cb_t tick_cb, void *ctx)
+{
+    s_now_ms = 0;
+    s_tick_cb = tick_cb;
+    s_tick_ctx = ctx;
+}
+
+void host_sim_advance_ms(uint32_t ms)
+{
+    for (uint32_t i = 0; i < ms; i++) {
+        s_now_ms++;
+        if (s_tick_cb) {
+            s_tick_cb(s_tick_ctx);
+        }
+    }
+}
+
+int64_t host_sim_now_ms(void)
+{
+    return s_now_ms;
+}
+
+int64_t esp_timer_get_time(void)
+{
+    return s_now_ms * 1000;
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    return (TickType_t)s_now_ms;
+}
+
+const char *esp_err_to_name(esp_err_t code)
+{
+    (void)code;
+    return "error";
+}
+
+static SemaphoreHandle_t host_sim_create(bool is_mutex)
+{
+    SemaphoreHandle_t sem = (SemaphoreHandle_t)calloc(1, sizeof(struct host_sim_semaphore));
+    if (sem) {
+        sem->is_mutex = is_mutex;
+    }
+    return sem;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    return host_sim_create(true);
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void)
+{
+    return host_sim_create(false);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks)
+{
+    if (sem->is_mutex) {
+        return pdTRUE;
+    }
+    for (TickType_t waited = 0; !sem->given && waited < ticks; waited++) {
+        host_sim_advance_ms(1);
+    }
+    if (!sem->given) {
+        return pdFALSE;
+    }
+    sem->given = false;
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem)
+{
+    if (!sem->is_mutex) {
+        sem->given = true;
+    }
+    return pdTRUE;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t sem)
+{
+    free(sem);
+}
@@ -0,0 +1,28 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+/*
+ * Simulated time for the host tests.
+ *
+ * The tests are single threaded. A task that blocks on a semaphore moves the simulated
+ * clock on instead, one tick at a time, and the tick callback plays the other side, e.g.
+ * the network delivering packets, until the semaphore is given or the wait times out.
+ * Mutexes never block.
+ */
+
+/* Called on every tick of simulated time */
+typedef void (*host_sim_tick_cb_t)(void *ctx);
+
+void host_sim_reset(host_sim_tick_cb_t tick_cb, void *ctx);
+
+/* Move the clock on by ms, calling the tick callback every tick */
+void host_sim_advance_ms(uint32_t ms);
+
+int64_t host_sim_now_ms(void);
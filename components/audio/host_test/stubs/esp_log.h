@@ -0,0 +1,19 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/* Host stand-in for the ESP-IDF header, logs are compiled out */
+
+#pragma once
+
+#include <inttypes.h>
+
+#define ESP_LOG_NONE(tag, ...) do { (void)(tag); } while (0)
+
+#define ESP_LOGE ESP_LOG_NONE
+#define ESP_LOGW ESP_LOG_NONE
+#define ESP_LOGI ESP_LOG_NONE
+#define ESP_LOGD ESP_LOG_NONE
+#define ESP_LOGV ESP_LOG_NONE
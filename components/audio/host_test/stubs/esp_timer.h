@@ -0,0 +1,13 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/* Host stand-in for the ESP-IDF header, time is simulated by host_sim.c */
+
+#pragma once
+
+#include <stdint.h>
+
+int64_t esp_timer_get_time(void);
@@ -0,0 +1,191 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <audio_convert.h>
+
+static int failures;
+
+#define CHECK(cond, ...)                                        \
+    do {                                                        \
+        if (!(cond)) {                                          \
+            printf("%s:%d: ", __FILE__, __LINE__);              \
+            printf(__VA_ARGS__);                                \
+            printf("\n");                                       \
+            failures++;                                         \
+        }                                                       \
+    } while (0)
+
+#define MAX_FRAMES 67
+
+static void fill_random(int16_t *buf, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        buf[i] = (int16_t)rand();
+    }
+}
+
+/* Every length up to MAX_FRAMES, at an aligned and an unaligned position, so both the
+ * unrolled loop and the tail are covered */
+static void test_expand_matches_ref(void)
+{
+    int16_t src[MAX_FRAMES + 1];
+    int32_t out32[2 * MAX_FRAMES + 2], ref32[2 * MAX_FRAMES + 2];
+    int16_t out16[2 * MAX_FRAMES + 2], ref16[2 * MAX_FRAMES + 2];
+
+    for (size_t frames = 0; frames <= MAX_FRAMES; frames++) {
+        for (int offset = 0; offset < 2; offset++) {
+            fill_random(src, MAX_FRAMES + 1);
+            memset(out32, 0x55, sizeof(out32));
+            memset(ref32, 0x55, sizeof(ref32));
+            audio_convert_s16_mono_to_s32_stereo(src + offset, out32, frames);
+            audio_convert_s16_mono_to_s32_stereo_ref(src + offset, ref32, frames);
+            CHECK(memcmp(out32, ref32, sizeof(out32)) == 0, "s16_mono_to_s32_stereo, %zu frames, offset %d", frames, offset);
+
+            memset(out16, 0x55, sizeof(out16));
+            memset(ref16, 0x55, sizeof(ref16));
+            audio_convert_s16_mono_to_s16_stereo(src, out16 + offset, frames);
+            audio_convert_s16_mono_to_s16_stereo_ref(src, ref16 + offset, frames);
+            CHECK(memcmp(out16, ref16, sizeof(out16)) == 0, "s16_mono_to_s16_stereo, %zu frames, offset %d", frames, offset);
+        }
+    }
+
+    int16_t sample = -2;
+    int32_t stereo[2];
+    audio_convert_s16_mono_to_s32_stereo(&sample, stereo, 1);
+    CHECK(stereo[0] == -2 * 65536 && stereo[1] == -2 * 65536, "s16 -2 expands to %ld %ld", (long)stereo[0], (long)stereo[1]);
+}
+
+/* The polyphase resamplers against the full convolution, fed in random sized chunks
+ * so the history is carried across calls */
+static void test_resample_matches_ref(void)
+{
+    int16_t src[2 * MAX_FRAMES];
+    int16_t out[4 * MAX_FRAMES], ref[4 * MAX_FRAMES];
+    audio_convert_resampler_t down, down_ref, up, up_ref;
+
+    audio_convert_resampler_reset(&down);
+    audio_convert_resampler_reset(&down_ref);
+    audio_convert_resampler_reset(&up);
+    audio_convert_resampler_reset(&up_ref);
+
+    for (int round = 0; round < 500; round++) {
+        size_t frames = (size_t)(rand() % (2 * MAX_FRAMES));
+        fill_random(src, frames);
+
+        size_t n = audio_convert_downsample_2x(&down, src, out, frames);
+        size_t n_ref = audio_convert_downsample_2x_ref(&down_ref, src, ref, frames);
+        CHECK(n == frames / 2 && n == n_ref, "downsample_2x of %zu frames gives %zu, ref %zu", frames, n, n_ref);
+        CHECK(memcmp(out, ref, n_ref * sizeof(int16_t)) == 0, "downsample_2x round %d, %zu frames", round, frames);
+
+        n = audio_convert_upsample_2x(&up, src, out, frames);
+        n_ref = audio_convert_upsample_2x_ref(&up_ref, src, ref, frames);
+        CHECK(n == 2 * frames && n == n_ref, "upsample_2x of %zu frames gives %zu, ref %zu", frames, n, n_ref);
+        CHECK(memcmp(out, ref, n_ref * sizeof(int16_t)) == 0, "upsample_2x round %d, %zu frames", round, frames);
+    }
+}
+
+/* Random gains and levels, so the sums hit both saturation limits */
+static void test_mix_matches_ref(void)
+{
+    int16_t src16[MAX_FRAMES + 1], out16[MAX_FRAMES + 1], ref16[MAX_FRAMES + 1];
+    int32_t src32[MAX_FRAMES + 1], out32[MAX_FRAMES + 1], ref32[MAX_FRAMES + 1];
+
+    for (size_t samples = 0; samples <= MAX_FRAMES; samples++) {
+        for (int offset = 0; offset < 2; offset++) {
+            int32_t gain = rand() % (AUDIO_CONVERT_GAIN_UNITY + 1);
+            fill_random(src16, MAX_FRAMES + 1);
+            fill_random(out16, MAX_FRAMES + 1);
+            memcpy(ref16, out16, sizeof(ref16));
+            audio_convert_mix_s16(src16 + offset, out16 + offset, samples, gain);
+            audio_convert_mix_s16_ref(src16 + offset, ref16 + offset, samples, gain);
+            CHECK(memcmp(out16, ref16, sizeof(out16)) == 0, "mix_s16, %zu samples, offset %d", samples, offset);
+
+            for (size_t i = 0; i <= MAX_FRAMES; i++) {
+                src32[i] = (int32_t)((uint32_t)rand() << 16 ^ (uint32_t)rand());
+                out32[i] = (int32_t)((uint32_t)rand() << 16 ^ (uint32_t)rand());
+            }
+            memcpy(ref32, out32, sizeof(ref32));
+            audio_convert_mix_s32(src32 + offset, out32 + offset, samples, gain);
+            audio_convert_mix_s32_ref(src32 + offset, ref32 + offset, samples, gain);
+            CHECK(memcmp(out32, ref32, sizeof(out32)) == 0, "mix_s32, %zu samples, offset %d", samples, offset);
+        }
+    }
+
+    int16_t a[2] = {30000, -30000};
+    int16_t b[2] = {30000, -30000};
+    audio_convert_mix_s16(a, b, 2, AUDIO_CONVERT_GAIN_UNITY);
+    CHECK(b[0] == INT16_MAX && b[1] == INT16_MIN, "mix_s16 saturates to %d %d", b[0], b[1]);
+
+    int32_t c[2] = {INT32_MAX, INT32_MIN};
+    int32_t d[2] = {INT32_MAX, INT32_MIN};
+    audio_convert_mix_s32(c, d, 2, AUDIO_CONVERT_GAIN_UNITY);
+    CHECK(d[0] == INT32_MAX && d[1] == INT32_MIN, "mix_s32 saturates to %ld %ld", (long)d[0], (long)d[1]);
+}
+
+/* Peak level of a tone after downsampling, once the filter has settled */
+static double downsampled_tone_level(double freq)
+{
+    enum { FRAMES = 1600 };
+    int16_t src[FRAMES], dst[FRAMES / 2];
+    audio_convert_resampler_t resampler;
+
+    audio_convert_resampler_reset(&resampler);
+    for (int i = 0; i < FRAMES; i++) {
+        src[i] = (int16_t)lrint(16000.0 * sin(2 * M_PI * freq * i));
+    }
+    audio_convert_downsample_2x(&resampler, src, dst, FRAMES);
+
+    int peak = 0;
+    for (int i = 100; i < FRAMES / 2; i++) {
+        peak = abs(dst[i]) > peak ? abs(dst[i]) : peak;
+    }
+    return 20 * log10((peak + 0.5) / 16000.0);
+}
+
+static void test_resample_response(void)
+{
+    int16_t ones[64], out[128];
+    audio_convert_resampler_t resampler;
+
+    for (int i = 0; i < 64; i++) {
+        ones[i] = 10000;
+    }
+    audio_convert_resampler_reset(&resampler);
+    audio_convert_downsample_2x(&resampler, ones, out, 64);
+    CHECK(abs(out[31] - 10000) <= 2, "downsample DC gain, %d for 10000", out[31]);
+
+    audio_convert_resampler_reset(&resampler);
+    audio_convert_upsample_2x(&resampler, ones, out, 64);
+    CHECK(abs(out[126] - 10000) <= 2 && abs(out[127] - 10000) <= 2, "upsample DC gain, %d %d for 10000", out[126], out[127]);
+
+    /* Frequencies in cycles per input sample */
+    double pass = downsampled_tone_level(0.1);
+    double stop = downsampled_tone_level(0.4);
+    CHECK(pass > -0.5, "passband level %.2f dB", pass);
+    CHECK(stop < -60, "stopband level %.2f dB", stop);
+}
+
+int main(void)
+{
+    srand(1);
+    test_expand_matches_ref();
+    test_resample_matches_ref();
+    test_resample_response();
+    test_mix_matches_ref();
+
+    if (failures) {
+        printf("%d checks failed\n", failures);
+        return 1;
+    }
+    printf("All checks passed\n");
+    return 0;
+}
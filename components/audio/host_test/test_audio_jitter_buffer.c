@@ -0,0 +1,362 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "audio_jitter_buffer.h"
+#include "host_sim.h"
+
+static int failures;
+
+#define CHECK(cond, ...)                                        \
+    do {                                                        \
+        if (!(cond)) {                                          \
+            printf("%s:%d: ", __FILE__, __LINE__);              \
+            printf(__VA_ARGS__);                                \
+            printf("\n");                                       \
+            failures++;                                         \
+        }                                                       \
+    } while (0)
+
+#define FRAME_MS        20
+#define MIN_LATENCY_MS  AUDIO_PLAYBACK_JITTER_MIN_MS_DEFAULT
+#define MAX_LATENCY_MS  AUDIO_PLAYBACK_JITTER_MAX_MS_DEFAULT
+#define MAX_EVENTS      256
+
+/* Speech buffered by the mixer ahead of the output */
+#define OUTPUT_BUFFER_MS 40
+
+/* One arrival of the trace: a packet, or the mark that ends a talkspurt */
+typedef struct {
+    int64_t at_ms;
+    bool is_mark;
+} trace_event_t;
+
+typedef struct {
+    audio_jitter_buffer_handle_t jb;
+    trace_event_t events[MAX_EVENTS];
+    int count;
+    int next;
+    int64_t output_end_ms;      /* Time the audio handed to the output runs out */
+    bool in_spurt;
+} trace_t;
+
+/* What the playback made of a trace */
+typedef struct {
+    int played;
+    int concealed;              /* Gaps handed to the decoder to conceal */
+    int gaps;                   /* Times the output ran dry within a talkspurt */
+} playout_t;
+
+static void trace_add(trace_t *trace, int64_t at_ms, bool is_mark)
+{
+    if (trace->count < MAX_EVENTS) {
+        trace->events[trace->count++] = (trace_event_t) {
+            .at_ms = at_ms,
+            .is_mark = is_mark,
+        };
+    }
+}
+
+/* Packets of a talkspurt, arriving in order like over TCP, then its mark */
+static void trace_add_spurt(trace_t *trace, const int64_t *arrival_ms, int packets)
+{
+    int64_t last_ms = 0;
+    for (int i = 0; i < packets; i++) {
+        last_ms = (arrival_ms[i] > last_ms) ? arrival_ms[i] : last_ms;
+        trace_add(trace, last_ms, false);
+    }
+    trace_add(trace, last_ms, true);
+}
+
+static void trace_deliver(void *ctx)
+{
+    trace_t *trace = (trace_t *)ctx;
+    static uint8_t payload[4];
+
+    while (trace->next < trace->count && trace->events[trace->next].at_ms <= host_sim_now_ms()) {
+        if (trace->events[trace->next].is_mark) {
+            audio_jitter_buffer_put_mark(trace->jb, 0);
+        } else {
+            /* The network side never waits for room */
+            audio_jitter_buffer_put(trace->jb, payload, sizeof(payload), FRAME_MS * 1000, 0);
+        }
+        trace->next++;
+    }
+}
+
+static void trace_start(trace_t *trace, uint32_t min_latency_ms)
+{
+    trace->next = 0;
+    trace->output_end_ms = 0;
+    trace->in_spurt = false;
+    CHECK(audio_jitter_buffer_create(min_latency_ms, MAX_LATENCY_MS, &trace->jb) == ESP_OK, "create");
+    host_sim_reset(trace_deliver, trace);
+    trace_deliver(trace);
+}
+
+/*
+ * Play like the playback task: packets are taken while the output holds less than
+ * OUTPUT_BUFFER_MS, as the writes to the mixer block, and the output plays one frame
+ * per packet. A packet queued after the output ran dry within a talkspurt is a gap.
+ */
+static void trace_play(trace_t *trace, int64_t until_ms, playout_t *playout)
+{
+    while (host_sim_now_ms() < until_ms) {
+        if (trace->output_end_ms - host_sim_now_ms() >= OUTPUT_BUFFER_MS) {
+            host_sim_advance_ms(1);
+            continue;
+        }
+        audio_jitter_buffer_packet_t pkt;
+        if (audio_jitter_buffer_get(trace->jb, &pkt, FRAME_MS) != ESP_OK) {
+            continue;
+        }
+        if (pkt.is_mark || pkt.is_last) {
+            trace->in_spurt = false;
+            audio_jitter_buffer_release(trace->jb, &pkt);
+            continue;
+        }
+        if (trace->in_spurt && host_sim_now_ms() > trace->output_end_ms) {
+            playout->gaps++;
+        }
+        int64_t start_ms = (trace->output_end_ms > host_sim_now_ms()) ? trace->output_end_ms : host_sim_now_ms();
+        trace->output_end_ms = start_ms + FRAME_MS;
+        trace->in_spurt = true;
+        if (pkt.is_gap) {
+            playout->concealed++;
+        } else {
+            playout->played++;
+        }
+        audio_jitter_buffer_release(trace->jb, &pkt);
+    }
+}
+
+static void trace_finish(trace_t *trace)
+{
+    audio_jitter_buffer_destroy(trace->jb);
+}
+
+/* Packets every frame time: playout starts at the minimum depth and never runs dry */
+static void test_steady(void)
+{
+    static trace_t trace;
+    int64_t arrival_ms[100];
+    playout_t playout = {0};
+    audio_playback_jitter_stats_t stats;
+
+    for (int i = 0; i < 100; i++) {
+        arrival_ms[i] = i * FRAME_MS;
+    }
+    trace = (trace_t) {0};
+    trace_add_spurt(&trace, arrival_ms, 100);
+    trace_start(&trace, MIN_LATENCY_MS);
+    trace_play(&trace, 50 * FRAME_MS, &playout);
+    audio_jitter_buffer_get_stats(trace.jb, &stats);
+    CHECK(stats.target_ms == MIN_LATENCY_MS, "steady target %u ms", (unsigned)stats.target_ms);
+
+    trace_play(&trace, 100 * FRAME_MS + MAX_LATENCY_MS, &playout);
+    audio_jitter_buffer_get_stats(trace.jb, &stats);
+    CHECK(stats.packets == 100 && playout.played == 100, "steady played %u", (unsigned)stats.packets);
+    CHECK(playout.gaps == 0 && stats.underruns == 0, "steady %d gaps, %u underruns", playout.gaps, (unsigned)stats.underruns);
+    CHECK(playout.concealed == 0 && stats.late == 0, "steady %d concealed, %u late", playout.concealed, (unsigned)stats.late);
+    CHECK(stats.jitter_ms == 0, "steady jitter %u ms", (unsigned)stats.jitter_ms);
+    trace_finish(&trace);
+}
+
+/*
+ * Random arrival jitter of up to 6 frames, twice. The first talkspurt starts at a
+ * depth that does not cover it, the target follows the jitter and the underruns, and
+ * the second talkspurt needs no more concealment. Every packet is played, a late one
+ * after the frames concealed for it.
+ */
+static void test_jitter(void)
+{
+    static trace_t trace;
+    int64_t arrival_ms[100];
+    playout_t playout = {0};
+    audio_playback_jitter_stats_t first, second;
+
+    srand(1);
+    for (int i = 0; i < 100; i++) {
+        arrival_ms[i] = i * FRAME_MS + rand() % (6 * FRAME_MS);
+    }
+    trace = (trace_t) {0};
+    trace_add_spurt(&trace, arrival_ms, 100);
+    for (int i = 0; i < 100; i++) {
+        arrival_ms[i] += 100 * FRAME_MS + 1000;
+    }
+    trace_add_spurt(&trace, arrival_ms, 100);
+    trace_start(&trace, FRAME_MS);
+
+    trace_play(&trace, 100 * FRAME_MS + 1000, &playout);
+    audio_jitter_buffer_get_stats(trace.jb, &first);
+    CHECK(first.jitter_ms > 0, "jitter %u ms", (unsigned)first.jitter_ms);
+    CHECK(first.target_ms > FRAME_MS && first.target_ms < MAX_LATENCY_MS, "jitter target %u ms", (unsigned)first.target_ms);
+    int first_concealed = playout.concealed;
+    CHECK(first.late > 0 && first_concealed > 0, "jitter nothing concealed below the jitter");
+
+    trace_play(&trace, 200 * FRAME_MS + 2000, &playout);
+    audio_jitter_buffer_get_stats(trace.jb, &second);
+    CHECK(playout.concealed - first_concealed <= first_concealed, "jitter %d concealed at first, %d after the target was raised",
+          first_concealed, playout.concealed - first_concealed);
+    CHECK(playout.played == 200 && second.packets == 200, "jitter played %d of 200", playout.played);
+    CHECK(playout.concealed >= (int)second.late, "jitter %d concealed, %u late", playout.concealed, (unsigned)second.late);
+    trace_finish(&trace);
+}
+
+/* A stall longer than concealment covers: one underrun, after which the target is raised */
+static void test_stall(void)
+{
+    static trace_t trace;
+    int64_t arrival_ms[100];
+    playout_t playout = {0};
+    audio_playback_jitter_stats_t before, after;
+
+    for (int i = 0; i < 100; i++) {
+        arrival_ms[i] = (i < 50 || i * FRAME_MS > 50 * FRAME_MS + 300) ? i * FRAME_MS : 50 * FRAME_MS + 300;
+    }
+    trace = (trace_t) {0};
+    trace_add_spurt(&trace, arrival_ms, 100);
+    trace_start(&trace, MIN_LATENCY_MS);
+    trace_play(&trace, 45 * FRAME_MS, &playout);
+    audio_jitter_buffer_get_stats(trace.jb, &before);
+    trace_play(&trace, 100 * FRAME_MS + MAX_LATENCY_MS, &playout);
+    audio_jitter_buffer_get_stats(trace.jb, &after);
+    CHECK(after.underruns == 1, "stall %u underruns", (unsigned)after.underruns);
+    CHECK(playout.gaps == 1, "stall %d gaps", playout.gaps);
+    CHECK(after.target_ms > before.target_ms, "stall target %u ms, before %u ms", (unsigned)after.target_ms, (unsigned)before.target_ms);
+    CHECK(playout.concealed == 3, "stall %d concealed", playout.concealed);
+    /* The packets held up by the stall are played, not dropped */
+    CHECK(playout.played == 100, "stall played %d", playout.played);
+    trace_finish(&trace);
+}
+
+/*
+ * Single packets held up by 30 ms, with the ones behind them, as a retransmission does
+ * over TCP. At the minimum depth that misses the frame time kept for the output: a frame
+ * is concealed instead of leaving a gap, and the held up packets all play after it.
+ */
+static void test_held_up(void)
+{
+    static trace_t trace;
+    int64_t arrival_ms[200];
+    playout_t playout = {0};
+    audio_playback_jitter_stats_t stats;
+
+    for (int i = 0; i < 200; i++) {
+        arrival_ms[i] = i * FRAME_MS;
+        if (i % 25 == 10) {
+            arrival_ms[i] += 30;
+        }
+    }
+    trace = (trace_t) {0};
+    trace_add_spurt(&trace, arrival_ms, 200);
+    trace_start(&trace, MIN_LATENCY_MS);
+    trace_play(&trace, 200 * FRAME_MS + MAX_LATENCY_MS, &playout);
+    audio_jitter_buffer_get_stats(trace.jb, &stats);
+    CHECK(playout.gaps == 0 && stats.underruns == 0, "held up %d gaps, %u underruns", playout.gaps, (unsigned)stats.underruns);
+    CHECK(playout.concealed > 0 && playout.concealed == (int)stats.late, "held up %d concealed, %u late",
+          playout.concealed, (unsigned)stats.late);
+    CHECK(playout.played == 200 && stats.discarded == 0, "held up played %d of 200, %u discarded",
+          playout.played, (unsigned)stats.discarded);
+    trace_finish(&trace);
+}
+
+/*
+ * The server stalls for 60 ms and then sends what it held back at once. The burst is
+ * played out in full behind the concealed frames, none of its packets are dropped.
+ */
+static void test_delayed_burst(void)
+{
+    static trace_t trace;
+    int64_t arrival_ms[100];
+    playout_t playout = {0};
+    audio_playback_jitter_stats_t stats;
+
+    for (int i = 0; i < 100; i++) {
+        arrival_ms[i] = i * FRAME_MS;
+        if (i >= 50 && i < 53) {
+            arrival_ms[i] = 53 * FRAME_MS;
+        }
+    }
+    trace = (trace_t) {0};
+    trace_add_spurt(&trace, arrival_ms, 100);
+    trace_start(&trace, MIN_LATENCY_MS);
+    trace_play(&trace, 100 * FRAME_MS + MAX_LATENCY_MS, &playout);
+    audio_jitter_buffer_get_stats(trace.jb, &stats);
+    CHECK(playout.played == 100 && stats.packets == 100, "burst played %d of 100", playout.played);
+    CHECK(stats.discarded == 0 && stats.underruns == 0, "burst %u discarded, %u underruns",
+          (unsigned)stats.discarded, (unsigned)stats.underruns);
+    CHECK(playout.concealed > 0 && playout.concealed < 3 && stats.late == 1, "burst %d concealed, %u late",
+          playout.concealed, (unsigned)stats.late);
+    CHECK(playout.gaps == 0, "burst %d gaps", playout.gaps);
+    trace_finish(&trace);
+}
+
+/* Talkspurts ended with a mark: the silence between them is no underrun and no loss */
+static void test_talkspurts(void)
+{
+    static trace_t trace;
+    int64_t arrival_ms[10];
+    playout_t playout = {0};
+    audio_playback_jitter_stats_t stats;
+
+    trace = (trace_t) {0};
+    for (int spurt = 0; spurt < 3; spurt++) {
+        for (int i = 0; i < 10; i++) {
+            arrival_ms[i] = spurt * 1000 + i * FRAME_MS;
+        }
+        trace_add_spurt(&trace, arrival_ms, 10);
+    }
+    trace_start(&trace, MIN_LATENCY_MS);
+    trace_play(&trace, 3000 + MAX_LATENCY_MS, &playout);
+    audio_jitter_buffer_get_stats(trace.jb, &stats);
+    CHECK(stats.packets == 30, "talkspurts played %u", (unsigned)stats.packets);
+    CHECK(stats.underruns == 0 && playout.concealed == 0, "talkspurts %u underruns, %d concealed",
+          (unsigned)stats.underruns, playout.concealed);
+    trace_finish(&trace);
+}
+
+/* A burst above the maximum latency: the packets that find no room are discarded */
+static void test_overflow(void)
+{
+    static trace_t trace;
+    int64_t arrival_ms[2 * MAX_LATENCY_MS / FRAME_MS] = {0};
+    int packets = 2 * MAX_LATENCY_MS / FRAME_MS;
+    playout_t playout = {0};
+    audio_playback_jitter_stats_t stats;
+
+    trace = (trace_t) {0};
+    trace_add_spurt(&trace, arrival_ms, packets);
+    trace_start(&trace, MIN_LATENCY_MS);
+    audio_jitter_buffer_get_stats(trace.jb, &stats);
+    CHECK(stats.depth_ms == MAX_LATENCY_MS, "overflow depth %u ms", (unsigned)stats.depth_ms);
+    CHECK(stats.discarded == (uint32_t)(packets - MAX_LATENCY_MS / FRAME_MS), "overflow discarded %u", (unsigned)stats.discarded);
+    trace_play(&trace, 2 * MAX_LATENCY_MS, &playout);
+    CHECK(playout.played == MAX_LATENCY_MS / FRAME_MS, "overflow played %d", playout.played);
+    trace_finish(&trace);
+}
+
+int main(void)
+{
+    test_steady();
+    test_jitter();
+    test_stall();
+    test_held_up();
+    test_delayed_burst();
+    test_talkspurts();
+    test_overflow();
+
+    if (failures) {
+        printf("%d checks failed\n", failures);
+        return 1;
+    }
+    printf("All checks passed\n");
+    return 0;
+}
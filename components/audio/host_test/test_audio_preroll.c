@@ -0,0 +1,225 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "audio_preroll.h"
+
+static int failures;
+
+#define CHECK(cond, ...)                                        \
+    do {                                                        \
+        if (!(cond)) {                                          \
+            printf("%s:%d: ", __FILE__, __LINE__);              \
+            printf(__VA_ARGS__);                                \
+            printf("\n");                                       \
+            failures++;                                         \
+        }                                                       \
+    } while (0)
+
+#define FRAME_MS        20
+#define FIFO_FRAMES     8       /* AUDIO_RECORDER_FIFO_BLOCK_COUNT */
+#define WINDOW_FRAMES   (AUDIO_RECORDER_COMMAND_WINDOW_MS / FRAME_MS)
+#define MAX_FRAMES      400
+
+/* An AFE event, raised as the frame at_frame is encoded */
+typedef struct {
+    int at_frame;
+    audio_preroll_command_t command;
+} afe_event_t;
+
+/* What reached the server */
+typedef struct {
+    uint32_t seq[MAX_FRAMES];
+    int count;
+} uplink_t;
+
+static esp_err_t uplink_send(const audio_recorder_frame_t *frame, void *user_data)
+{
+    uplink_t *uplink = (uplink_t *)user_data;
+    if (uplink->count < MAX_FRAMES) {
+        uplink->seq[uplink->count++] = frame->seq;
+    }
+    return ESP_OK;
+}
+
+/*
+ * Run a conversation that is already streaming, like the microphone task. The AFE raises
+ * its events as it encodes, and the consumer is lag frames behind it in the FIFO.
+ * A frame is sent unless held, after the held ones on a release, then kept in the
+ * pre-roll while armed.
+ */
+static void run(audio_preroll_t *preroll, const afe_event_t *events, int num_events, int frames, int lag, uplink_t *uplink)
+{
+    int next_event = 0;
+    for (int t = 0; t < frames + lag; t++) {
+        while (next_event < num_events && events[next_event].at_frame == t) {
+            if (events[next_event].command == AUDIO_PREROLL_COMMAND_OPEN) {
+                /* The wake word arms the pre-roll along with the window */
+                audio_preroll_arm(preroll, true);
+            }
+            audio_preroll_set_command(preroll, events[next_event].command);
+            next_event++;
+        }
+        int consumed = t - lag;
+        if (consumed < 0 || consumed >= frames) {
+            continue;
+        }
+
+        uint32_t payload = consumed;
+        audio_recorder_frame_t frame = {
+            .data = (const uint8_t *)&payload,
+            .len = sizeof(payload),
+            .seq = consumed,
+            .timestamp_us = (int64_t)consumed * FRAME_MS * 1000,
+        };
+        audio_recorder_hold_t hold = audio_preroll_hold(preroll);
+        if (hold == AUDIO_RECORDER_HOLD_RELEASED) {
+            audio_preroll_flush(preroll, 0, uplink_send, uplink);
+        }
+        if (hold != AUDIO_RECORDER_HOLD_HELD) {
+            uplink_send(&frame, uplink);
+        }
+        audio_preroll_store(preroll, &frame);
+    }
+}
+
+static void preroll_start(audio_preroll_t *preroll, uint16_t slot_count)
+{
+    memset(preroll, 0, sizeof(*preroll));
+    if (slot_count > 0) {
+        CHECK(audio_preroll_init(preroll, slot_count, 4, FRAME_MS * 1000) == ESP_OK, "init");
+    }
+}
+
+/* Slots the recorder allocates for the command window */
+#define WINDOW_SLOTS (WINDOW_FRAMES + FIFO_FRAMES)
+
+/*
+ * A command spoken after the wake word, recognised after it ended, with the consumer
+ * anywhere from in step with the AFE to a full FIFO behind. Nothing of the turn is sent,
+ * and a turn started without a wake word afterwards streams again.
+ */
+static void test_command_dropped(void)
+{
+    for (int lag = 0; lag <= FIFO_FRAMES; lag++) {
+        static audio_preroll_t preroll;
+        uplink_t uplink = {0};
+        const afe_event_t events[] = {
+            {.at_frame = 0, .command = AUDIO_PREROLL_COMMAND_OPEN},
+            /* "volume up" in frames 5 to 40, MultiNet needs a few more to be sure */
+            {.at_frame = 45, .command = AUDIO_PREROLL_COMMAND_MATCHED},
+        };
+
+        preroll_start(&preroll, WINDOW_SLOTS);
+        run(&preroll, events, 2, 100, lag, &uplink);
+        CHECK(uplink.count == 0, "lag %d: %d frames of the command sent, first %u", lag, uplink.count,
+              uplink.count ? (unsigned)uplink.seq[0] : 0);
+        CHECK(preroll.stats.flushes == 0, "lag %d: %u flushes", lag, (unsigned)preroll.stats.flushes);
+
+        /* The recorder leaving idle without a wake word */
+        const afe_event_t next_turn[] = {
+            {.at_frame = 0, .command = AUDIO_PREROLL_COMMAND_NONE},
+        };
+        run(&preroll, next_turn, 1, 50, lag, &uplink);
+        CHECK(uplink.count == 50, "lag %d: next turn sent %d frames", lag, uplink.count);
+        audio_preroll_deinit(&preroll);
+    }
+}
+
+/* No command within the window: every frame reaches the server once, in order, none lost */
+static void test_window_timeout(void)
+{
+    for (int lag = 0; lag <= FIFO_FRAMES; lag++) {
+        static audio_preroll_t preroll;
+        uplink_t uplink = {0};
+        const afe_event_t events[] = {
+            {.at_frame = 0, .command = AUDIO_PREROLL_COMMAND_OPEN},
+            {.at_frame = WINDOW_FRAMES, .command = AUDIO_PREROLL_COMMAND_TIMEOUT},
+        };
+
+        preroll_start(&preroll, WINDOW_SLOTS);
+        run(&preroll, events, 2, 250, lag, &uplink);
+        CHECK(uplink.count == 250, "lag %d: %d frames sent", lag, uplink.count);
+        bool in_order = true;
+        for (int i = 0; i < uplink.count; i++) {
+            in_order &= (uplink.seq[i] == (uint32_t)i);
+        }
+        CHECK(in_order, "lag %d: frames out of order", lag);
+        CHECK(preroll.stats.frames_overwritten == 0, "lag %d: %u frames overwritten", lag,
+              (unsigned)preroll.stats.frames_overwritten);
+        CHECK(preroll.stats.flushes == 1, "lag %d: %u flushes", lag, (unsigned)preroll.stats.flushes);
+        audio_preroll_deinit(&preroll);
+    }
+}
+
+/*
+ * Without room for a pre-roll the window cannot be held, its frames are dropped rather
+ * than sent. Those still in the FIFO when it times out go out live.
+ */
+static void test_no_preroll(void)
+{
+    static audio_preroll_t preroll;
+    uplink_t uplink = {0};
+    const afe_event_t matched[] = {
+        {.at_frame = 0, .command = AUDIO_PREROLL_COMMAND_OPEN},
+        {.at_frame = 45, .command = AUDIO_PREROLL_COMMAND_MATCHED},
+    };
+
+    preroll_start(&preroll, 0);
+    run(&preroll, matched, 2, 100, FIFO_FRAMES, &uplink);
+    CHECK(uplink.count == 0, "no pre-roll: %d frames of the command sent", uplink.count);
+
+    const afe_event_t timeout[] = {
+        {.at_frame = 0, .command = AUDIO_PREROLL_COMMAND_OPEN},
+        {.at_frame = WINDOW_FRAMES, .command = AUDIO_PREROLL_COMMAND_TIMEOUT},
+    };
+    run(&preroll, timeout, 2, 250, FIFO_FRAMES, &uplink);
+    CHECK(uplink.count == 250 - (WINDOW_FRAMES - FIFO_FRAMES) && uplink.seq[0] == WINDOW_FRAMES - FIFO_FRAMES,
+          "no pre-roll: %d frames sent from %u", uplink.count, uplink.count ? (unsigned)uplink.seq[0] : 0);
+}
+
+/* Arming drops what was kept, a flush delivers the most recent max_ms oldest first */
+static void test_flush(void)
+{
+    static audio_preroll_t preroll;
+    uplink_t uplink = {0};
+
+    preroll_start(&preroll, 10);
+    audio_preroll_arm(&preroll, true);
+    for (uint32_t seq = 0; seq < 15; seq++) {
+        audio_recorder_frame_t frame = {.data = (const uint8_t *)&seq, .len = sizeof(seq), .seq = seq};
+        audio_preroll_store(&preroll, &frame);
+    }
+    CHECK(preroll.stats.frames_overwritten == 5, "%u frames overwritten", (unsigned)preroll.stats.frames_overwritten);
+    audio_preroll_flush(&preroll, 4 * FRAME_MS, uplink_send, &uplink);
+    CHECK(uplink.count == 4 && uplink.seq[0] == 11 && uplink.seq[3] == 14, "flushed %d frames from %u", uplink.count,
+          uplink.count ? (unsigned)uplink.seq[0] : 0);
+
+    uint32_t seq = 15;
+    audio_recorder_frame_t frame = {.data = (const uint8_t *)&seq, .len = sizeof(seq), .seq = seq};
+    audio_preroll_store(&preroll, &frame);
+    CHECK(preroll.count == 0, "kept %d frames after the flush disarmed", preroll.count);
+    audio_preroll_deinit(&preroll);
+}
+
+int main(void)
+{
+    test_command_dropped();
+    test_window_timeout();
+    test_no_preroll();
+    test_flush();
+
+    if (failures) {
+        printf("%d checks failed\n", failures);
+        return 1;
+    }
+    printf("All checks passed\n");
+    return 0;
+}
@@ -7,6 +7,8 @@
 #include <esp_err.h>
 #include <esp_gmf_pool.h>
 
+#include <audio_recorder.h>
+
 #pragma once
 
 /**
@@ -32,6 +34,8 @@ esp_gmf_pool_handle_t audio_pool_get(void);
  * It sets up the AFE manager and registers the ai_afe element.
  *
  * @param input_format The input format string for AFE configuration
+ * @param profile The AFE performance profile
+ * @param vcmd_language MultiNet language enabling voice command detection after the wake word, NULL to disable it
  * @return AFE manager handle on success, NULL on failure
  */
-void* audio_pool_register_afe(const char *input_format);
+void* audio_pool_register_afe(const char *input_format, const audio_recorder_afe_profile_t *profile, const char *vcmd_language);
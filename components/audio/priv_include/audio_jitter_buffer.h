@@ -0,0 +1,137 @@
+/**
+ * SPDX-FileCopyrightText: 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <esp_err.h>
+#include <freertos/FreeRTOS.h>
+
+#include <audio_playback.h>
+
+/**
+ * Jitter buffer in front of the playback decoder.
+ *
+ * Packets are played in the order they were added. The downlink comes over the
+ * websocket, which delivers in order and without gaps, and carries no sequence numbers,
+ * so there is nothing to reorder. Playout of a talkspurt starts once the buffered audio
+ * reaches the target depth, or the first packet has waited that long. The target follows
+ * the measured inter-arrival jitter between the minimum and maximum latency, and grows
+ * after an underrun. Packets are never dropped for being late. While playing, a gap is
+ * returned once the output is about to run dry, for the decoder to conceal a frame,
+ * and the late packets play after it. Writers block while the maximum latency is buffered.
+ */
+typedef struct audio_jitter_buffer *audio_jitter_buffer_handle_t;
+
+/**
+ * @brief Packet taken from the jitter buffer
+ *
+ * @param data Packet data, owned by the caller until audio_jitter_buffer_release()
+ * @param len Length of the packet, 0 for markers and gaps
+ * @param free_cb Frees data, NULL for free()
+ * @param free_ctx Context passed to free_cb
+ * @param is_last End of stream marker
+ * @param is_mark Marker queued with audio_jitter_buffer_put_mark()
+ * @param is_gap No packet had arrived when the output needed one, data is NULL. The decoder
+ *               conceals a frame, the packet still plays once it arrives
+ */
+typedef struct {
+    uint8_t *data;
+    size_t len;
+    audio_playback_free_cb_t free_cb;
+    void *free_ctx;
+    bool is_last;
+    bool is_mark;
+    bool is_gap;
+} audio_jitter_buffer_packet_t;
+
+/**
+ * @brief Create a jitter buffer
+ *
+ * @param min_latency_ms Lowest target depth
+ * @param max_latency_ms Highest target depth, and most audio buffered before writers block
+ * @param handle Filled with the jitter buffer handle
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if min_latency_ms is above max_latency_ms,
+ *         ESP_ERR_NO_MEM if out of memory
+ */
+esp_err_t audio_jitter_buffer_create(uint32_t min_latency_ms, uint32_t max_latency_ms, audio_jitter_buffer_handle_t *handle);
+
+void audio_jitter_buffer_destroy(audio_jitter_buffer_handle_t jb);
+
+/**
+ * @brief Add a packet
+ *
+ * @param jb The jitter buffer
+ * @param data Packet data, copied
+ * @param len Length of the packet
+ * @param duration_us Audio duration of the packet
+ * @param timeout Time to wait while the buffer is full
+ * @return ESP_OK on success, ESP_ERR_TIMEOUT if the buffer stayed full, ESP_ERR_NO_MEM if out of memory
+ */
+esp_err_t audio_jitter_buffer_put(audio_jitter_buffer_handle_t jb, const uint8_t *data, size_t len, uint32_t duration_us,
+                                  TickType_t timeout);
+
+/**
+ * @brief Add a packet without copying it
+ *
+ * The buffer is owned by the jitter buffer from this call on, also when it fails, and is
+ * handed to free_cb once played or dropped.
+ *
+ * @param jb The jitter buffer
+ * @param data Packet data
+ * @param len Length of the packet
+ * @param duration_us Audio duration of the packet
+ * @param free_cb Frees data, NULL for free()
+ * @param free_ctx Context passed to free_cb
+ * @param timeout Time to wait while the buffer is full
+ * @return Same as audio_jitter_buffer_put()
+ */
+esp_err_t audio_jitter_buffer_put_ref(audio_jitter_buffer_handle_t jb, uint8_t *data, size_t len, uint32_t duration_us,
+                                      audio_playback_free_cb_t free_cb, void *free_ctx, TickType_t timeout);
+
+/**
+ * @brief Queue an end of stream marker after the last packet added
+ *
+ * @param jb The jitter buffer
+ * @param timeout Time to wait while the buffer is full
+ * @return ESP_OK on success, ESP_ERR_TIMEOUT if the buffer stayed full
+ */
+esp_err_t audio_jitter_buffer_put_end(audio_jitter_buffer_handle_t jb, TickType_t timeout);
+
+/**
+ * @brief Queue a marker after the last packet added, returned once the packets before it were taken
+ *
+ * Like the end of stream marker it ends the talkspurt without counting an underrun,
+ * but the stream goes on.
+ *
+ * @param jb The jitter buffer
+ * @param timeout Time to wait while the buffer is full
+ * @return ESP_OK on success, ESP_ERR_TIMEOUT if the buffer stayed full
+ */
+esp_err_t audio_jitter_buffer_put_mark(audio_jitter_buffer_handle_t jb, TickType_t timeout);
+
+/**
+ * @brief Take the next packet to play
+ *
+ * @param jb The jitter buffer
+ * @param packet Filled with the packet
+ * @param timeout Time to wait for a packet to be due
+ * @return ESP_OK on success, ESP_ERR_TIMEOUT if no packet was due in time
+ */
+esp_err_t audio_jitter_buffer_get(audio_jitter_buffer_handle_t jb, audio_jitter_buffer_packet_t *packet, TickType_t timeout);
+
+/* Free a packet returned by audio_jitter_buffer_get() */
+void audio_jitter_buffer_release(audio_jitter_buffer_handle_t jb, audio_jitter_buffer_packet_t *packet);
+
+/* Drop every queued packet but the markers, writers blocked on a full buffer resume */
+void audio_jitter_buffer_flush(audio_jitter_buffer_handle_t jb);
+
+/* Bytes of the packets waiting in the buffer */
+size_t audio_jitter_buffer_filled_bytes(audio_jitter_buffer_handle_t jb);
+
+void audio_jitter_buffer_get_stats(audio_jitter_buffer_handle_t jb, audio_playback_jitter_stats_t *stats);
@@ -0,0 +1,145 @@
+/**
+ * SPDX-FileCopyrightText: 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <esp_err.h>
+#include <freertos/FreeRTOS.h>
+
+#include <esp_codec_dev.h>
+
+/**
+ * Software mixer in front of the output device.
+ *
+ * Every source has its own buffer, written in the device format. The mixer task is the
+ * only writer of the device: each period it takes what the sources have, scales it by
+ * their gain, and adds it up with saturation. While a source that ducks the others has
+ * audio, the other sources play at the duck level. Gain changes ramp over one period.
+ * A source only waits for room in its own buffer, so one stream never blocks another.
+ */
+typedef struct audio_mixer *audio_mixer_handle_t;
+typedef struct audio_mixer_source *audio_mixer_source_handle_t;
+
+/* Sources a mixer can have */
+#define AUDIO_MIXER_MAX_SOURCES 4
+
+/**
+ * @brief Called once the audio of a flush has faded out
+ *
+ * Runs in the mixer task after the faded period was written to the device, and should not block.
+ *
+ * @param ctx The flushed_ctx of the source
+ */
+typedef void (*audio_mixer_flushed_cb_t)(void *ctx);
+
+/* Period used when audio_mixer_config_t leaves it at 0 */
+#define AUDIO_MIXER_PERIOD_MS_DEFAULT 10
+
+/**
+ * @brief Mixer configuration
+ *
+ * @param out_dev_handle Output device, written by the mixer task only
+ * @param out_codec_info Format the output device was opened with: 16-bit mono or stereo, or 32-bit stereo
+ * @param period_ms Audio mixed and written per device write, 0 for AUDIO_MIXER_PERIOD_MS_DEFAULT
+ * @param duck_percent Level of the other sources while a ducking source plays, 0 to 100
+ * @param dev_buffer_ms Audio the output device buffers behind a write, its DMA buffers, used for the
+ *                      playout position reported by audio_mixer_source_played_at()
+ * @param task_prio Priority of the mixer task, at least that of the writers
+ */
+typedef struct {
+    esp_codec_dev_handle_t out_dev_handle;
+    esp_codec_dev_sample_info_t out_codec_info;
+    uint16_t period_ms;
+    uint8_t duck_percent;
+    uint16_t dev_buffer_ms;
+    UBaseType_t task_prio;
+} audio_mixer_config_t;
+
+/**
+ * @brief Source configuration
+ *
+ * @param name Name for logs, must stay valid while the mixer exists
+ * @param buffer_ms Audio buffered ahead of the mixer before writes block, at least one period
+ * @param gain_percent Level of the source, 0 to 100
+ * @param ducks_others Lower the other sources while this one has audio
+ * @param flushed_cb Called after every audio_mixer_source_flush() once the source is silent, may be NULL
+ * @param flushed_ctx Context passed to flushed_cb
+ */
+typedef struct {
+    const char *name;
+    uint16_t buffer_ms;
+    uint8_t gain_percent;
+    bool ducks_others;
+    audio_mixer_flushed_cb_t flushed_cb;
+    void *flushed_ctx;
+} audio_mixer_source_config_t;
+
+/**
+ * @brief Create a mixer and start its task
+ *
+ * @param config Mixer configuration
+ * @param handle Filled with the mixer handle
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG for an unsupported format,
+ *         ESP_ERR_NO_MEM if out of memory
+ */
+esp_err_t audio_mixer_create(const audio_mixer_config_t *config, audio_mixer_handle_t *handle);
+
+/* Stop the mixer task and free the mixer and its sources. Writers must have stopped */
+void audio_mixer_destroy(audio_mixer_handle_t mixer);
+
+/**
+ * @brief Add a source
+ *
+ * @param mixer The mixer
+ * @param config Source configuration
+ * @param source Filled with the source handle, valid until the mixer is destroyed
+ * @return ESP_OK on success, ESP_ERR_NO_MEM if out of memory or all AUDIO_MIXER_MAX_SOURCES are used
+ */
+esp_err_t audio_mixer_add_source(audio_mixer_handle_t mixer, const audio_mixer_source_config_t *config,
+                                 audio_mixer_source_handle_t *source);
+
+/**
+ * @brief Queue audio on a source, in the format of the output device
+ *
+ * One writer per source. Returns early without error when the source is flushed meanwhile,
+ * the rest of the data is dropped.
+ *
+ * @param source The source
+ * @param data Audio data
+ * @param len Length of the data
+ * @param timeout Time to wait while the source buffer is full
+ * @return ESP_OK on success, ESP_ERR_TIMEOUT if the buffer stayed full
+ */
+esp_err_t audio_mixer_source_write(audio_mixer_source_handle_t source, const void *data, size_t len, TickType_t timeout);
+
+/**
+ * @brief Drop the audio queued on a source, a write in progress returns
+ *
+ * The mixer fades the queued audio out over its next period and skips the rest, the other
+ * sources play on. Audio written after the flush is kept. What the mixer already wrote to
+ * the device still plays. The flushed_cb of the source is called once the faded period
+ * was written.
+ *
+ * @param source The source
+ */
+void audio_mixer_source_flush(audio_mixer_source_handle_t source);
+
+/**
+ * @brief Estimate when the audio queued on a source so far has played
+ *
+ * Counts the audio still in the source buffer, the period being written and the device
+ * buffers in front of it. Errs late by up to a period, never early.
+ *
+ * @param source The source
+ * @return esp_timer time at which the last queued sample leaves the device, in the past once it has
+ */
+int64_t audio_mixer_source_played_at(audio_mixer_source_handle_t source);
+
+/* Set the level of a source, 0 to 100 */
+void audio_mixer_source_set_gain(audio_mixer_source_handle_t source, uint8_t gain_percent);
@@ -0,0 +1,127 @@
+/**
+ * SPDX-FileCopyrightText: 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <esp_err.h>
+
+#include <audio_recorder.h>
+
+typedef enum {
+    AUDIO_PREROLL_REQUEST_NONE,
+    AUDIO_PREROLL_REQUEST_ARM,
+    AUDIO_PREROLL_REQUEST_DISARM,
+} audio_preroll_request_t;
+
+/**
+ * State of the voice command window that follows a wake word
+ */
+typedef enum {
+    AUDIO_PREROLL_COMMAND_NONE,     /*!< No window, or no commands configured */
+    AUDIO_PREROLL_COMMAND_OPEN,     /*!< MultiNet is listening, frames are held */
+    AUDIO_PREROLL_COMMAND_MATCHED,  /*!< A command was recognised, the held and following frames are dropped */
+    AUDIO_PREROLL_COMMAND_TIMEOUT,  /*!< No command, the held frames are released */
+} audio_preroll_command_t;
+
+/**
+ * Pre-roll of the recorder: the most recent frames released while armed, delivered
+ * ahead of the live frames once the conversation starts.
+ *
+ * The ring is only touched by the task consuming frames. Other tasks arm and disarm it,
+ * and move the command window on, through requests that the consumer applies with the
+ * next frame. While the command window is open, the consumer holds frames in the ring
+ * instead of sending them, since MultiNet only recognises a command after it was spoken.
+ * They are dropped with a recognised command, so it never reaches the server, and
+ * released when the window times out.
+ */
+typedef struct {
+    uint8_t *data;                  /* slot_count * slot_size bytes, in PSRAM if there is any */
+    audio_recorder_frame_t *frames; /* Per-slot frame info, data points into the slot */
+    uint16_t slot_count;            /* 0 without a pre-roll */
+    size_t slot_size;
+    uint32_t frame_duration_us;
+    uint16_t head;                  /* Next slot to write */
+    uint16_t count;
+    bool armed;
+    bool holding;                   /* The ring holds the frames of an open command window */
+    volatile audio_preroll_request_t request;
+    volatile audio_preroll_command_t command;
+    volatile bool command_matched;  /* Outcome of the last window, kept when command is reset */
+    audio_recorder_preroll_stats_t stats;
+} audio_preroll_t;
+
+/**
+ * @brief Allocate the ring, in PSRAM or else internal RAM
+ *
+ * Requests, the command window and the statistics are kept across a deinit and init.
+ *
+ * @param preroll The pre-roll
+ * @param slot_count Frames kept
+ * @param slot_size Largest frame kept
+ * @param frame_duration_us Duration of one frame
+ * @return ESP_OK on success, ESP_ERR_NO_MEM if neither has room, the pre-roll then has no slots
+ */
+esp_err_t audio_preroll_init(audio_preroll_t *preroll, uint16_t slot_count, size_t slot_size, uint32_t frame_duration_us);
+
+/**
+ * @brief Free the ring and drop the frames in it
+ *
+ * @param preroll The pre-roll
+ */
+void audio_preroll_deinit(audio_preroll_t *preroll);
+
+/**
+ * @brief Request to start or stop keeping frames, from any task
+ *
+ * Arming also drops the frames kept so far.
+ *
+ * @param preroll The pre-roll
+ * @param arm true to arm, false to disarm
+ */
+void audio_preroll_arm(audio_preroll_t *preroll, bool arm);
+
+/**
+ * @brief Move the command window on, from any task
+ *
+ * @param preroll The pre-roll
+ * @param command AUDIO_PREROLL_COMMAND_OPEN after the wake word, then MATCHED or TIMEOUT.
+ *                NONE ends the dropping after a match for a turn started without a wake word
+ */
+void audio_preroll_set_command(audio_preroll_t *preroll, audio_preroll_command_t command);
+
+/**
+ * @brief Check whether the frame just acquired may be sent, from the consuming task
+ *
+ * @param preroll The pre-roll
+ * @return AUDIO_RECORDER_HOLD_HELD while the command window is open or after a match,
+ *         AUDIO_RECORDER_HOLD_RELEASED for the first frame after a window without a command,
+ *         otherwise AUDIO_RECORDER_HOLD_NONE
+ */
+audio_recorder_hold_t audio_preroll_hold(audio_preroll_t *preroll);
+
+/**
+ * @brief Keep a released frame if armed, from the consuming task
+ *
+ * Once full, the oldest frame is overwritten.
+ *
+ * @param preroll The pre-roll
+ * @param frame The frame, copied
+ */
+void audio_preroll_store(audio_preroll_t *preroll, const audio_recorder_frame_t *frame);
+
+/**
+ * @brief Deliver the frames kept, oldest first, and disarm, from the consuming task
+ *
+ * @param preroll The pre-roll
+ * @param max_ms Only deliver the most recent max_ms of audio, 0 for all of it
+ * @param cb Callback receiving the frames, NULL to drop them
+ * @param user_data User data passed to the callback
+ * @return ESP_OK on success, otherwise the error returned by the callback
+ */
+esp_err_t audio_preroll_flush(audio_preroll_t *preroll, uint32_t max_ms, audio_recorder_frame_cb_t cb, void *user_data);
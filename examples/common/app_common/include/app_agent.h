@@ -40,6 +40,13 @@ esp_err_t app_agent_speech_conversation_start(void);
 
 esp_err_t app_agent_speech_conversation_end(void);
 
+/**
+ * @brief Tell the server that the user interrupted the assistant's speech
+ *
+ * @return ESP_OK on success, ESP_ERR_INVALID_STATE if no conversation is running, otherwise an error code
+ */
+esp_err_t app_agent_send_barge_in(void);
+
 void app_agent_default_event_handler(void *arg, esp_event_base_t event_base,
                                      int32_t event_id, void *event_data);
 
@@ -53,6 +60,46 @@ void app_agent_default_event_handler(void *arg, esp_event_base_t event_base,
  */
 esp_err_t app_agent_register_tool(const char *name, esp_agent_tool_handler_t tool_handler, void *user_data);
 
+/**
+ * @brief Register a local tool with the agent, with a parameter schema and execution settings
+ *
+ * @param[in] name Name of the tool
+ * @param[in] tool_handler Function pointer to the tool handler
+ * @param[in] user_data User data passed to the tool handler
+ * @param[in] config Tool settings, see esp_agent_tool_config_t
+ * @return ESP_OK on success, error code otherwise
+ */
+esp_err_t app_agent_register_tool_with_config(const char *name, esp_agent_tool_handler_t tool_handler, void *user_data,
+                                              const esp_agent_tool_config_t *config);
+
+/**
+ * @brief Register an asynchronous local tool with the agent
+ *
+ * The handler completes the call later with esp_agent_tool_complete().
+ *
+ * @param[in] name Name of the tool
+ * @param[in] tool_handler Function pointer to the async tool handler
+ * @param[in] user_data User data passed to the tool handler
+ * @param[in] config Tool settings, see esp_agent_tool_config_t. May be NULL
+ * @return ESP_OK on success, error code otherwise
+ */
+esp_err_t app_agent_register_async_tool(const char *name, esp_agent_async_tool_handler_t tool_handler, void *user_data,
+                                        const esp_agent_tool_config_t *config);
+
+/**
+ * @brief Register a streaming local tool with the agent
+ *
+ * The handler writes its result in pieces with esp_agent_tool_writer_write().
+ *
+ * @param[in] name Name of the tool
+ * @param[in] tool_handler Function pointer to the streaming tool handler
+ * @param[in] user_data User data passed to the tool handler
+ * @param[in] config Tool settings, see esp_agent_tool_config_t. May be NULL
+ * @return ESP_OK on success, error code otherwise
+ */
+esp_err_t app_agent_register_stream_tool(const char *name, esp_agent_stream_tool_handler_t tool_handler, void *user_data,
+                                         const esp_agent_tool_config_t *config);
+
 /**
  * @brief Unregister a local tool from the agent
  *
@@ -60,3 +107,11 @@ esp_err_t app_agent_register_tool(const char *name, esp_agent_tool_handler_t too
  * @return ESP_OK on success, error code otherwise
  */
 esp_err_t app_agent_tool_unregister(const char *name);
+
+/**
+ * @brief Drop the cached results of a local tool registered with a cache TTL
+ *
+ * @param[in] name Name of the tool, NULL for all tools
+ * @return ESP_OK on success, error code otherwise
+ */
+esp_err_t app_agent_tool_cache_invalidate(const char *name);
@@ -45,14 +45,57 @@ esp_err_t app_audio_start(void);
  */
 esp_err_t app_audio_set_playback_volume(uint8_t volume);
 
+/**
+ * @brief Get the volume of the playback device
+ *
+ * @return The volume, 0 to 100
+ */
+uint8_t app_audio_get_playback_volume(void);
+
+/**
+ * @brief Get the time the VAD last reported the end of speech
+ *
+ * @return The time in esp_timer_get_time() time base, 0 if no speech ended yet
+ */
+int64_t app_audio_get_speech_end_time(void);
+
+/**
+ * @brief Queue downlink speech for playback
+ *
+ * The buffer is taken over without a copy and freed with free() once played or dropped,
+ * also when this fails.
+ *
+ * @param data The speech packet, allocated with malloc()
+ * @param data_len The length of the packet
+ * @return ESP_OK on success or when the speaker drops the speech, otherwise an error code
+ */
 esp_err_t app_audio_play_speech(uint8_t *data, size_t data_len);
 
+/**
+ * @brief Switch the audio formats to the ones negotiated with the server
+ *
+ * The recorder is reconfigured by the microphone task before its next frame,
+ * the playback once the speech already queued has been decoded.
+ *
+ * @param upload The upload audio configuration
+ * @param download The download audio configuration
+ * @return ESP_OK on success, otherwise an error code
+ */
+esp_err_t app_audio_set_audio_config(const esp_agent_audio_config_t *upload, const esp_agent_audio_config_t *download);
+
 esp_err_t app_audio_microphone_set_state(app_audio_microphone_state_t state);
 
 esp_err_t app_audio_speaker_start(void);
 
 esp_err_t app_audio_speaker_stop(void);
 
+/**
+ * @brief Silence the speech being played and drop the speech queued after it
+ *
+ * @return ESP_OK on success, otherwise an error code
+ */
+esp_err_t app_audio_speaker_flush(void);
+
 esp_err_t app_audio_speaker_download_complete(void);
 
 esp_err_t app_audio_play_media_sync(const char *media_url, const uint8_t *data, size_t data_len);
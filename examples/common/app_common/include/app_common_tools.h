@@ -8,11 +8,17 @@
 
 #include <esp_agent.h>
 #include <esp_err.h>
+#include <audio_recorder.h>
 
 #define TOOL_NAME_SET_REMINDER "set_reminder"
 #define TOOL_NAME_GET_LOCAL_TIME "get_local_time"
 #define TOOL_NAME_SET_VOLUME "set_volume"
 
+/* Settings of the common tools, to be passed when registering them */
+extern const esp_agent_tool_config_t app_common_tools_set_reminder_config;
+extern const esp_agent_tool_config_t app_common_tools_get_local_time_config;
+extern const esp_agent_tool_config_t app_common_tools_set_volume_config;
+
 esp_err_t app_common_tools_set_reminder_handler(esp_agent_handle_t handle, const char *tool_name,
                                                 esp_agent_tool_param_t params[], size_t num_params, void *user_data,
                                                 char **result);
@@ -24,3 +30,15 @@ esp_err_t app_common_tools_get_local_time_handler(esp_agent_handle_t handle, con
 esp_err_t app_common_tools_set_volume_handler(esp_agent_handle_t handle, const char *tool_name,
                                               esp_agent_tool_param_t params[], size_t num_params, void *user_data,
                                               char **result);
+
+/* Phrases recognized on device after the wake word, with CONFIG_APP_AUDIO_LOCAL_COMMANDS */
+extern const audio_recorder_command_t app_common_tools_local_commands[];
+extern const size_t app_common_tools_num_local_commands;
+
+/**
+ * @brief Run the local tool mapped to an on-device voice command
+ *
+ * @param command_id Id of the detected command
+ * @return ESP_OK on success, ESP_ERR_NOT_FOUND for an unknown id, otherwise the tool error
+ */
+esp_err_t app_common_tools_run_local_command(int command_id);
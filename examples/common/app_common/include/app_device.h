@@ -13,6 +13,7 @@
 #pragma once
 
 #include <esp_err.h>
+#include <stdint.h>
 
 typedef enum {
     DEVICE_EVENT_SYSTEM_INITIALIZED,
@@ -28,12 +29,26 @@ typedef enum {
     DEVICE_EVENT_REMINDER_COMPLETE,
     DEVICE_EVENT_SET_USER_TEXT,
     DEVICE_EVENT_SET_ASSISTANT_TEXT,
+    DEVICE_EVENT_LOCAL_COMMAND,
+    DEVICE_EVENT_BARGE_IN,
+    DEVICE_EVENT_SPEECH_SILENCED,
     DEVICE_EVENT_MAX,
 } app_device_event_t;
 
 // Event data union for different event types
 typedef union {
     const char *text;           // For REMINDER, SET_USER_TEXT, SET_ASSISTANT_TEXT events
+    struct {
+        int id;
+        int64_t wakeup_us;
+        int64_t detect_us;
+    } command;                  // For LOCAL_COMMAND events
+    struct {
+        int64_t start_us;       // Time of the touch or of the server's barge-in
+    } interrupt;                // For INTERRUPT and BARGE_IN events
+    struct {
+        int64_t silent_us;      // Time the mixer faded out the flushed speech
+    } silenced;                 // For SPEECH_SILENCED events
 } device_event_data_t;
 
 typedef enum {
@@ -6,6 +6,7 @@
 
 #include <esp_log.h>
 #include <esp_check.h>
+#include <esp_timer.h>
 
 #include <esp_agent.h>
 
@@ -61,6 +62,17 @@ void app_agent_default_event_handler(void *arg, esp_event_base_t event_base, int
             ESP_LOGD(TAG, "ESP Agent Received Speech End");
             app_device_event_enqueue(DEVICE_EVENT_SPEECH_END, NULL);
             break;
+        case ESP_AGENT_EVENT_AUDIO_CONFIG_CHANGED:
+            ESP_LOGI(TAG, "ESP Agent audio configuration changed by the server");
+            app_audio_set_audio_config(&data->audio_config.upload, &data->audio_config.download);
+            break;
+        case ESP_AGENT_EVENT_BARGE_IN:
+            {
+                ESP_LOGI(TAG, "ESP Agent Barge-in from the server");
+                device_event_data_t event_data = { .interrupt = { .start_us = esp_timer_get_time() } };
+                app_device_event_enqueue(DEVICE_EVENT_BARGE_IN, &event_data);
+            }
+            break;
         case ESP_AGENT_EVENT_DATA_TYPE_TEXT:
             {
                 if (data->text.generation_stage == ESP_AGENT_MESSAGE_GENERATION_STAGE_FINAL) {
@@ -85,7 +97,8 @@ void app_agent_default_event_handler(void *arg, esp_event_base_t event_base, int
             break;
         case ESP_AGENT_EVENT_DATA_TYPE_SPEECH:
             ESP_LOGD(TAG, "ESP Agent Speech data: %d", data->speech.len);
-            app_audio_play_speech((uint8_t *)data->speech.data, data->speech.len);
+            /* Handed to the playback without a copy */
+            app_audio_play_speech(esp_agent_speech_data_take(data), data->speech.len);
             break;
         case ESP_AGENT_EVENT_DATA_TYPE_THINKING:
             /* Display the thought in gray color */
@@ -180,6 +193,14 @@ esp_err_t app_agent_speech_conversation_end(void)
     return esp_agent_speech_conversation_end(g_app_agent_data.agent_handle);
 }
 
+esp_err_t app_agent_send_barge_in(void)
+{
+    if (g_app_agent_data.state != APP_AGENT_STATE_STARTED) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    return esp_agent_send_barge_in(g_app_agent_data.agent_handle);
+}
+
 esp_err_t app_agent_connect(void)
 {
     if (!g_app_agent_data.agent_handle) {
@@ -212,15 +233,22 @@ esp_err_t app_agent_init(app_agent_config_t *config)
     ESP_RETURN_ON_ERROR(esp_event_handler_register(AGENT_SETUP_EVENT, ESP_EVENT_ANY_ID, agent_setup_event_handler, NULL), TAG, "Failed to register agent event handler");
 
     /* Initialize esp_agent without agent_id and refresh_token */
+#if CONFIG_AUDIO_CONVERSATION_FORMAT_PCM
+    esp_agent_conversation_audio_format_t audio_format = ESP_AGENT_CONVERSATION_AUDIO_FORMAT_PCM;
+#else
+    esp_agent_conversation_audio_format_t audio_format = ESP_AGENT_CONVERSATION_AUDIO_FORMAT_OPUS;
+#endif
     esp_agent_audio_config_t upload_audio_config = {
-        .format = ESP_AGENT_CONVERSATION_AUDIO_FORMAT_OPUS,
+        .format = audio_format,
         .sample_rate = CONFIG_AUDIO_UPLOAD_SAMPLE_RATE,
-        .frame_duration = CONFIG_AUDIO_UPLOAD_FRAME_DURATION_MS,
+        .frame_duration = CONFIG_AUDIO_UPLOAD_FRAME_DURATION_US / 1000,
+        .frame_duration_us = CONFIG_AUDIO_UPLOAD_FRAME_DURATION_US,
     };
     esp_agent_audio_config_t download_audio_config = {
-        .format = ESP_AGENT_CONVERSATION_AUDIO_FORMAT_OPUS,
+        .format = audio_format,
         .sample_rate = CONFIG_AUDIO_DOWNLOAD_SAMPLE_RATE,
-        .frame_duration = CONFIG_AUDIO_DOWNLOAD_FRAME_DURATION_MS,
+        .frame_duration = CONFIG_AUDIO_DOWNLOAD_FRAME_DURATION_US / 1000,
+        .frame_duration_us = CONFIG_AUDIO_DOWNLOAD_FRAME_DURATION_US,
     };
 
     esp_agent_config_t agent_config = {
@@ -273,13 +301,50 @@ app_agent_state_t app_agent_get_state(void)
     return g_app_agent_data.state;
 }
 
+esp_err_t app_agent_register_tool_with_config(const char *name, esp_agent_tool_handler_t tool_handler, void *user_data,
+                                              const esp_agent_tool_config_t *config)
+{
+    if (!g_app_agent_data.agent_handle) {
+        ESP_LOGE(TAG, "Agent handle not initialized");
+        return ESP_ERR_INVALID_STATE;
+    }
+    esp_err_t err = esp_agent_register_local_tool_with_config(g_app_agent_data.agent_handle, name, tool_handler,
+                                                              user_data, config);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to register local tool: %s", name);
+    }
+    return err;
+}
+
 esp_err_t app_agent_register_tool(const char *name, esp_agent_tool_handler_t tool_handler, void *user_data)
+{
+    return app_agent_register_tool_with_config(name, tool_handler, user_data, NULL);
+}
+
+esp_err_t app_agent_register_async_tool(const char *name, esp_agent_async_tool_handler_t tool_handler, void *user_data,
+                                        const esp_agent_tool_config_t *config)
 {
     if (!g_app_agent_data.agent_handle) {
         ESP_LOGE(TAG, "Agent handle not initialized");
         return ESP_ERR_INVALID_STATE;
     }
-    esp_err_t err = esp_agent_register_local_tool(g_app_agent_data.agent_handle, name, tool_handler, user_data);
+    esp_err_t err = esp_agent_register_local_async_tool(g_app_agent_data.agent_handle, name, tool_handler,
+                                                        user_data, config);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to register local tool: %s", name);
+    }
+    return err;
+}
+
+esp_err_t app_agent_register_stream_tool(const char *name, esp_agent_stream_tool_handler_t tool_handler, void *user_data,
+                                         const esp_agent_tool_config_t *config)
+{
+    if (!g_app_agent_data.agent_handle) {
+        ESP_LOGE(TAG, "Agent handle not initialized");
+        return ESP_ERR_INVALID_STATE;
+    }
+    esp_err_t err = esp_agent_register_local_stream_tool(g_app_agent_data.agent_handle, name, tool_handler,
+                                                         user_data, config);
     if (err != ESP_OK) {
         ESP_LOGW(TAG, "Failed to register local tool: %s", name);
     }
@@ -294,3 +359,12 @@ esp_err_t app_agent_tool_unregister(const char *name)
     }
     return esp_agent_unregister_local_tool(g_app_agent_data.agent_handle, name);
 }
+
+esp_err_t app_agent_tool_cache_invalidate(const char *name)
+{
+    if (!g_app_agent_data.agent_handle) {
+        ESP_LOGE(TAG, "Agent handle not initialized");
+        return ESP_ERR_INVALID_STATE;
+    }
+    return esp_agent_tool_cache_invalidate(g_app_agent_data.agent_handle, name);
+}
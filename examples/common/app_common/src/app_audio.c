@@ -6,6 +6,9 @@
 
 #include <esp_check.h>
 #include <esp_log.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
 #include <driver/i2s_std.h>
 #include <nvs_flash.h>
 #include <agent_setup.h>
@@ -19,6 +22,7 @@
 #include "app_audio.h"
 #include "app_agent.h"
 #include "app_device.h"
+#include "app_common_tools.h"
 
 static const char *TAG = "app_audio";
 
@@ -31,8 +35,13 @@ typedef struct {
     bool speaker_active;
     bool audio_download_complete;
     bool audio_playback_complete;
-    EventGroupHandle_t event_group;
     uint8_t volume;
+    volatile bool vad_speech;
+    volatile int64_t vad_end_us;
+    volatile int64_t speech_end_us;             /* Last VAD end of speech, for latency reports */
+    volatile bool recorder_reconfig_pending;    /* Applied by the microphone task, which owns the recorder frames */
+    uint32_t recorder_sample_rate;
+    uint32_t recorder_frame_duration_us;
 } app_audio_data_t;
 
 typedef struct {
@@ -45,10 +54,15 @@ app_audio_data_t g_app_audio_data;
 #define APP_AUDIO_NVS_NAMESPACE "app_audio"
 #define APP_AUDIO_NVS_KEY_VOLUME "volume"
 
-#define AUDIO_SEND_BUFFER_SIZE 1024
-#define OPUS_DUMMY_FRAME_DATA_SIZE 320 // random size for dummy audio data (all 0s)
+#define AUDIO_FRAME_WAIT_TIMEOUT_MS 1000
 
-#define AUDIO_DOWNLOAD_COMPLETE_BIT (1 << 2)
+#if CONFIG_AUDIO_CONVERSATION_FORMAT_PCM
+#define AUDIO_RECORDER_CODEC AUDIO_RECORDER_CODEC_PCM
+#define AUDIO_PLAYBACK_CODEC AUDIO_PLAYBACK_CODEC_PCM
+#else
+#define AUDIO_RECORDER_CODEC AUDIO_RECORDER_CODEC_OPUS
+#define AUDIO_PLAYBACK_CODEC AUDIO_PLAYBACK_CODEC_OPUS
+#endif
 
 static const esp_codec_dev_sample_info_t g_audio_cfg = {
     .sample_rate = 16000,
@@ -135,6 +149,125 @@ static esp_err_t app_audio_set_volume_handler(int argc, char **argv)
     return app_audio_set_playback_volume(atoi(volume));
 }
 
+#if CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+#define AUDIO_STATS_MAX_TASKS 48
+
+/* CPU usage of each task since the previous call, in percent of one core */
+static void audio_log_task_cpu_usage(void)
+{
+    static TaskStatus_t *s_prev_tasks;
+    static UBaseType_t s_prev_count;
+    static uint32_t s_prev_total;
+
+    TaskStatus_t *tasks = (TaskStatus_t *)calloc(AUDIO_STATS_MAX_TASKS, sizeof(TaskStatus_t));
+    if (tasks == NULL) {
+        ESP_LOGE(TAG, "Failed to allocate task list");
+        return;
+    }
+
+    uint32_t total = 0;
+    UBaseType_t count = uxTaskGetSystemState(tasks, AUDIO_STATS_MAX_TASKS, &total);
+    uint32_t elapsed = total - s_prev_total;
+    if (count == 0 || elapsed == 0) {
+        free(tasks);
+        return;
+    }
+
+    ESP_LOGI(TAG, "CPU usage over the last %" PRIu32 " ms:", elapsed / 1000);
+    for (UBaseType_t i = 0; i < count; i++) {
+        uint32_t runtime = tasks[i].ulRunTimeCounter;
+        for (UBaseType_t j = 0; j < s_prev_count; j++) {
+            if (s_prev_tasks[j].xHandle == tasks[i].xHandle) {
+                runtime -= s_prev_tasks[j].ulRunTimeCounter;
+                break;
+            }
+        }
+        if (runtime > 0) {
+            ESP_LOGI(TAG, "  %-24s %3" PRIu32 "%%", tasks[i].pcTaskName, (uint32_t)((uint64_t)runtime * 100 / elapsed));
+        }
+    }
+
+    free(s_prev_tasks);
+    s_prev_tasks = tasks;
+    s_prev_count = count;
+    s_prev_total = total;
+}
+
+/* CPU time used by all tasks, split by recorder mode. Updated by the microphone task only. */
+typedef struct {
+    uint64_t busy;      /* Non-idle run time, summed over all cores */
+    uint64_t elapsed;   /* Run time counter time, per core */
+} audio_cpu_usage_t;
+
+static audio_cpu_usage_t s_cpu_usage[2];    /* Indexed by idle mode */
+static configRUN_TIME_COUNTER_TYPE s_cpu_last_time;
+static configRUN_TIME_COUNTER_TYPE s_cpu_last_idle;
+
+static void audio_cpu_usage_update(bool idle_mode)
+{
+    configRUN_TIME_COUNTER_TYPE now = portGET_RUN_TIME_COUNTER_VALUE();
+    configRUN_TIME_COUNTER_TYPE idle = 0;
+    for (BaseType_t core = 0; core < configNUMBER_OF_CORES; core++) {
+        idle += ulTaskGetRunTimeCounter(xTaskGetIdleTaskHandleForCore(core));
+    }
+
+    if (s_cpu_last_time != 0) {
+        configRUN_TIME_COUNTER_TYPE elapsed = now - s_cpu_last_time;
+        configRUN_TIME_COUNTER_TYPE idle_time = idle - s_cpu_last_idle;
+        uint64_t capacity = (uint64_t)elapsed * configNUMBER_OF_CORES;
+        s_cpu_usage[idle_mode].elapsed += elapsed;
+        s_cpu_usage[idle_mode].busy += capacity > idle_time ? capacity - idle_time : 0;
+    }
+    s_cpu_last_time = now;
+    s_cpu_last_idle = idle;
+}
+
+static void audio_log_cpu_usage_by_mode(void)
+{
+    static const char *const mode_names[] = {"Listening", "Idle"};
+    for (int i = 0; i < 2; i++) {
+        const audio_cpu_usage_t *usage = &s_cpu_usage[i];
+        if (usage->elapsed == 0) {
+            continue;
+        }
+        /* In percent of all cores */
+        uint32_t permille = (uint32_t)(usage->busy * 1000 / (usage->elapsed * configNUMBER_OF_CORES));
+        ESP_LOGI(TAG, "%s: %" PRIu32 ".%" PRIu32 "%% CPU over %" PRIu64 " ms", mode_names[i],
+                 permille / 10, permille % 10, usage->elapsed / 1000);
+    }
+}
+#endif
+
+static esp_err_t app_audio_stats_handler(int argc, char **argv)
+{
+    audio_recorder_perf_stats_t perf;
+    audio_recorder_preroll_stats_t preroll;
+    audio_playback_jitter_stats_t jitter;
+    ESP_RETURN_ON_ERROR(audio_recorder_get_perf_stats(g_app_audio_data.recorder_handle, &perf), TAG, "Failed to get recorder stats");
+    ESP_RETURN_ON_ERROR(audio_recorder_get_preroll_stats(g_app_audio_data.recorder_handle, &preroll), TAG, "Failed to get pre-roll stats");
+    ESP_RETURN_ON_ERROR(audio_playback_get_jitter_stats(g_app_audio_data.playback_handle, &jitter), TAG, "Failed to get jitter stats");
+
+    ESP_LOGI(TAG, "Recorder: %" PRIu32 " frames encoded, %" PRIu32 " dropped, %" PRIu64 " us avg encode",
+             perf.frames_encoded, perf.frames_dropped, perf.frames_encoded ? perf.encode_time_us / perf.frames_encoded : 0);
+    ESP_LOGI(TAG, "Overruns: feed %" PRIu32 ", fetch %" PRIu32, perf.feed_overruns, perf.fetch_overruns);
+    ESP_LOGI(TAG, "Idle: %" PRIu64 " ms of AFE output skipped, recorder %s", perf.idle_audio_us / 1000,
+             audio_recorder_is_idle(g_app_audio_data.recorder_handle) ? "idle" : "active");
+    ESP_LOGI(TAG, "Pre-roll: %" PRIu32 " flushes, %" PRIu32 " frames (%" PRIu32 " ms) salvaged, %" PRIu32 " overwritten",
+             preroll.flushes, preroll.frames_salvaged, preroll.ms_salvaged, preroll.frames_overwritten);
+    ESP_LOGI(TAG, "Jitter buffer: %" PRIu32 " played, %" PRIu32 " underruns, %" PRIu32 " late, %" PRIu32 " concealed, %" PRIu32 " discarded",
+             jitter.packets, jitter.underruns, jitter.late, jitter.concealed, jitter.discarded);
+    ESP_LOGI(TAG, "Jitter buffer: jitter %" PRIu32 " ms, target %" PRIu32 " ms, depth %" PRIu32 " ms",
+             jitter.jitter_ms, jitter.target_ms, jitter.depth_ms);
+
+#if CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+    audio_log_cpu_usage_by_mode();
+    audio_log_task_cpu_usage();
+#else
+    ESP_LOGI(TAG, "Enable CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS for per-task CPU usage");
+#endif
+    return ESP_OK;
+}
+
 static esp_err_t register_audio_commands()
 {
     esp_console_cmd_t cmd = {
@@ -142,8 +275,14 @@ static esp_err_t register_audio_commands()
         .help = "Set the volume of the playback device\nUsage: set-volume <volume>",
         .func = app_audio_set_volume_handler,
     };
+    ESP_RETURN_ON_ERROR(agent_console_register_command(&cmd), TAG, "Failed to register set-volume command");
 
-    return agent_console_register_command(&cmd);
+    esp_console_cmd_t stats_cmd = {
+        .command = "audio-stats",
+        .help = "Print recorder and jitter buffer statistics, and per-task CPU usage since the previous call\nUsage: audio-stats",
+        .func = app_audio_stats_handler,
+    };
+    return agent_console_register_command(&stats_cmd);
 }
 
 static void audio_recorder_event_handler(audio_recorder_handle_t handle, audio_recorder_event_t event, void *user_data)
@@ -155,36 +294,150 @@ static void audio_recorder_event_handler(audio_recorder_handle_t handle, audio_r
         case AUDIO_RECORDER_EVENT_WAKEUP_END:
             app_device_event_enqueue(DEVICE_EVENT_SLEEP, NULL);
             break;
+        case AUDIO_RECORDER_EVENT_VAD_START:
+            g_app_audio_data.vad_speech = true;
+            break;
+        case AUDIO_RECORDER_EVENT_VAD_END:
+            g_app_audio_data.vad_end_us = esp_timer_get_time();
+            g_app_audio_data.speech_end_us = g_app_audio_data.vad_end_us;
+            g_app_audio_data.vad_speech = false;
+            break;
         default:
             break;
     }
 }
 
+#if CONFIG_APP_AUDIO_LOCAL_COMMANDS
+static void audio_recorder_command_handler(audio_recorder_handle_t handle, const audio_recorder_command_result_t *result, void *user_data)
+{
+    device_event_data_t event_data = {
+        .command = {
+            .id = result->id,
+            .wakeup_us = result->wakeup_us,
+            .detect_us = result->detect_us,
+        },
+    };
+    app_device_event_enqueue(DEVICE_EVENT_LOCAL_COMMAND, &event_data);
+}
+#endif
+
+static esp_err_t audio_send_preroll_frame(const audio_recorder_frame_t *frame, void *user_data)
+{
+    return app_agent_send_speech((uint8_t *)frame->data, frame->len);
+}
+
+#if CONFIG_APP_AUDIO_VAD_GATING
+/* Speech, or silence shorter than the hangover, keeps the uplink open */
+static bool audio_vad_gate_open(void)
+{
+    if (g_app_audio_data.vad_speech) {
+        return true;
+    }
+    return esp_timer_get_time() - g_app_audio_data.vad_end_us < CONFIG_APP_AUDIO_VAD_HANGOVER_MS * 1000LL;
+}
+#endif
+
 static void audio_microphone_task(void *arg)
 {
-    uint8_t *audio_data = (uint8_t *) malloc(AUDIO_SEND_BUFFER_SIZE);
-    assert(audio_data);
-    size_t audio_data_len = 0;
-    uint8_t *dummy_audio_data = (uint8_t *) calloc(OPUS_DUMMY_FRAME_DATA_SIZE, 1);
+    audio_recorder_frame_t frame;
+    audio_recorder_frame_t silence_frame;
+    app_audio_microphone_state_t prev_state = MICROPHONE_STATE_STOP;
+    bool gate_open = true;
 
     ESP_LOGI(TAG, "Audio microphone task started");
     while (true) {
-        audio_recorder_read(g_app_audio_data.recorder_handle, audio_data, AUDIO_SEND_BUFFER_SIZE, &audio_data_len);
+#if CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+        /* Attributed to the mode of the wait that just ended */
+        audio_cpu_usage_update(audio_recorder_is_idle(g_app_audio_data.recorder_handle));
+#endif
+        if (g_app_audio_data.recorder_reconfig_pending) {
+            g_app_audio_data.recorder_reconfig_pending = false;
+            esp_err_t err = audio_recorder_reconfigure(g_app_audio_data.recorder_handle, g_app_audio_data.recorder_sample_rate,
+                                                       g_app_audio_data.recorder_frame_duration_us);
+            if (err != ESP_OK) {
+                ESP_LOGE(TAG, "Failed to reconfigure recorder: %s", esp_err_to_name(err));
+            }
+        }
+
+        esp_err_t err = audio_recorder_acquire_frame(g_app_audio_data.recorder_handle, &frame, AUDIO_FRAME_WAIT_TIMEOUT_MS);
+        if (err == ESP_ERR_TIMEOUT) {
+            continue;
+        } else if (err != ESP_OK) {
+            ESP_LOGW(TAG, "Failed to acquire audio frame: %s", esp_err_to_name(err));
+            vTaskDelay(pdMS_TO_TICKS(10));
+            continue;
+        }
 
-        esp_err_t err = ESP_OK;
-        switch (g_app_audio_data.microphone_state) {
+        audio_recorder_hold_t hold = audio_recorder_command_hold(g_app_audio_data.recorder_handle);
+        if (hold == AUDIO_RECORDER_HOLD_HELD) {
+            /* Kept in the pre-roll until MultiNet knows whether this is a local command, dropped if it is */
+            audio_recorder_release_frame(g_app_audio_data.recorder_handle, &frame);
+            continue;
+        } else if (hold == AUDIO_RECORDER_HOLD_RELEASED) {
+            /* No command after the wake word: the held speech goes out like the pre-roll of a new turn */
+            prev_state = MICROPHONE_STATE_STOP;
+        }
+
+        app_audio_microphone_state_t state = g_app_audio_data.microphone_state;
+        if (state == MICROPHONE_STATE_START && prev_state != MICROPHONE_STATE_START) {
+            /* Speech captured between the wake word and now goes out ahead of the live frames */
+            err = audio_recorder_preroll_flush(g_app_audio_data.recorder_handle, 0, audio_send_preroll_frame, NULL);
+            if (err != ESP_OK) {
+                ESP_LOGW(TAG, "Failed to send pre-roll: %s", esp_err_to_name(err));
+            }
+            gate_open = true;
+#if CONFIG_APP_AUDIO_VAD_GATING
+            /* Give the VAD a hangover's time to pick up speech that is already going on */
+            g_app_audio_data.vad_end_us = esp_timer_get_time();
+#endif
+        } else if (state != MICROPHONE_STATE_START && prev_state == MICROPHONE_STATE_START && !gate_open) {
+            /* Drop the silence kept for the onset pre-roll, it is stale by the next conversation turn */
+            audio_recorder_preroll_flush(g_app_audio_data.recorder_handle, 0, NULL, NULL);
+        }
+        prev_state = state;
+
+#if CONFIG_APP_AUDIO_VAD_GATING
+        if (state == MICROPHONE_STATE_START) {
+            bool speech = audio_vad_gate_open();
+            if (speech && !gate_open) {
+                /* The VAD reports speech late, so resend the frames just before the onset */
+                ESP_LOGD(TAG, "Uplink gate opened");
+                audio_recorder_preroll_flush(g_app_audio_data.recorder_handle, CONFIG_APP_AUDIO_VAD_ONSET_PREROLL_MS,
+                                             audio_send_preroll_frame, NULL);
+            } else if (!speech && gate_open) {
+                ESP_LOGD(TAG, "Uplink gate closed");
+                /* Silent frames are kept in the recorder pre-roll for the next onset */
+                audio_recorder_preroll_arm(g_app_audio_data.recorder_handle);
+            }
+            gate_open = speech;
+        }
+#endif
+
+        switch (state) {
             case MICROPHONE_STATE_START:
-                err = app_agent_send_speech(audio_data, audio_data_len);
+                if (!gate_open) {
+                    /* Nothing is sent in PCM mode, which has no DTX frame */
+                    if (audio_recorder_get_silence_frame(g_app_audio_data.recorder_handle, &silence_frame) == ESP_OK) {
+                        err = app_agent_send_speech((uint8_t *)silence_frame.data, silence_frame.len);
+                    }
+                    break;
+                }
+                /* Queued straight from the recorder FIFO block, one Opus frame per message */
+                err = app_agent_send_speech((uint8_t *)frame.data, frame.len);
+                ESP_LOGV(TAG, "Uplink frame %" PRIu32 ": %d bytes, %" PRId64 " us after capture",
+                         frame.seq, frame.len, esp_timer_get_time() - frame.timestamp_us);
                 break;
             case MICROPHONE_STATE_PAUSE:
-                err = app_agent_send_speech(dummy_audio_data, OPUS_DUMMY_FRAME_DATA_SIZE);
+                /* Keepalive while the agent speaks */
+                if (audio_recorder_get_silence_frame(g_app_audio_data.recorder_handle, &silence_frame) == ESP_OK) {
+                    err = app_agent_send_speech((uint8_t *)silence_frame.data, silence_frame.len);
+                }
                 break;
             case MICROPHONE_STATE_STOP:
-                vTaskDelay(pdMS_TO_TICKS(10));
-                continue; // While loop
             default:
                 break;
         }
+        audio_recorder_release_frame(g_app_audio_data.recorder_handle, &frame);
 
         if (err != ESP_OK) {
             ESP_LOGW(TAG, "Failed to send speech data: %s", esp_err_to_name(err));
@@ -192,13 +445,20 @@ static void audio_microphone_task(void *arg)
         }
     }
 
-    free(audio_data);
-    free(dummy_audio_data);
     vTaskDelete(NULL);
 }
 
 static esp_err_t audio_init_micrphone()
 {
+    audio_recorder_afe_profile_t afe_profile;
+#if CONFIG_APP_AUDIO_AFE_PROFILE_LOW_POWER
+    audio_recorder_get_afe_profile(AUDIO_RECORDER_AFE_PRESET_LOW_POWER, &afe_profile);
+#elif CONFIG_APP_AUDIO_AFE_PROFILE_BALANCED
+    audio_recorder_get_afe_profile(AUDIO_RECORDER_AFE_PRESET_BALANCED, &afe_profile);
+#else
+    audio_recorder_get_afe_profile(AUDIO_RECORDER_AFE_PRESET_HIGH_QUALITY, &afe_profile);
+#endif
+
     dev_audio_codec_handles_t *codec_handles = NULL;
     ESP_RETURN_ON_ERROR(esp_board_device_get_handle("audio_adc", (void **)&codec_handles), TAG, "Failed to get audio_adc handle");
     esp_codec_dev_handle_t microphone_handle = codec_handles->codec_dev;
@@ -210,7 +470,15 @@ static esp_err_t audio_init_micrphone()
         .format = "RMNM",
         .in_dev_handle = microphone_handle,
         .sample_rate = CONFIG_AUDIO_UPLOAD_SAMPLE_RATE,
-        .frame_duration_ms = CONFIG_AUDIO_UPLOAD_FRAME_DURATION_MS,
+        .frame_duration_us = CONFIG_AUDIO_UPLOAD_FRAME_DURATION_US,
+        .preroll_ms = CONFIG_AUDIO_UPLOAD_PREROLL_MS,
+        .afe_profile = &afe_profile,
+        .codec = AUDIO_RECORDER_CODEC,
+#if CONFIG_APP_AUDIO_LOCAL_COMMANDS
+        .commands = app_common_tools_local_commands,
+        .num_commands = app_common_tools_num_local_commands,
+        .command_language = "en",
+#endif
     };
 
     g_app_audio_data.recorder_handle = audio_recorder_init(&config);
@@ -219,6 +487,11 @@ static esp_err_t audio_init_micrphone()
     }
 
     audio_recorder_add_event_cb(g_app_audio_data.recorder_handle, audio_recorder_event_handler, NULL);
+    /* The microphone starts stopped, so only the wake word is listened for */
+    audio_recorder_set_idle(g_app_audio_data.recorder_handle, true);
+#if CONFIG_APP_AUDIO_LOCAL_COMMANDS
+    audio_recorder_set_command_cb(g_app_audio_data.recorder_handle, audio_recorder_command_handler, NULL);
+#endif
 
     return ESP_OK;
 }
@@ -243,6 +516,22 @@ static esp_err_t audio_calibrate_volume_curve(esp_codec_dev_handle_t speaker_han
     return ESP_FAIL;
 }
 
+/* The speech before the end mark queued by app_audio_speaker_download_complete() has been played */
+static void audio_playback_drained_handler(void *ctx)
+{
+    ESP_LOGI(TAG, "Speaker playback complete");
+    g_app_audio_data.audio_playback_complete = true;
+    app_device_event_enqueue(DEVICE_EVENT_SPEECH_PLAYBACK_COMPLETE, NULL);
+}
+
+static void audio_playback_flushed_handler(void *ctx)
+{
+    device_event_data_t event_data = {
+        .silenced.silent_us = esp_timer_get_time(),
+    };
+    app_device_event_enqueue(DEVICE_EVENT_SPEECH_SILENCED, &event_data);
+}
+
 static esp_err_t audio_init_speaker()
 {
     dev_audio_codec_handles_t *codec_handles = NULL;
@@ -275,43 +564,25 @@ static esp_err_t audio_init_speaker()
     audio_playback_config_t config = {
         .audio_in_info = {
             .sample_rate = CONFIG_AUDIO_DOWNLOAD_SAMPLE_RATE,
-            .frame_duration_ms = CONFIG_AUDIO_DOWNLOAD_FRAME_DURATION_MS,
+            .frame_duration_us = CONFIG_AUDIO_DOWNLOAD_FRAME_DURATION_US,
+            .codec = AUDIO_PLAYBACK_CODEC,
         },
         .out_codec_info = g_audio_cfg,
         .out_dev_handle = speaker_handle,
+        .jitter_min_ms = CONFIG_APP_AUDIO_JITTER_MIN_MS,
+        .jitter_max_ms = CONFIG_APP_AUDIO_JITTER_MAX_MS,
     };
 
     g_app_audio_data.playback_handle = audio_playback_init(&config);
     if (g_app_audio_data.playback_handle == NULL) {
         return ESP_FAIL;
     }
+    audio_playback_set_drained_cb(g_app_audio_data.playback_handle, audio_playback_drained_handler, NULL);
+    audio_playback_set_flushed_cb(g_app_audio_data.playback_handle, audio_playback_flushed_handler, NULL);
 
     return ESP_OK;
 }
 
-void download_complete_task(void *arg)
-{
-    while (true) {
-        /* Wait for the download complete bit to be set */
-        /* This will be set by the `app_audio_speaker_download_complete` function */
-        xEventGroupWaitBits(g_app_audio_data.event_group, AUDIO_DOWNLOAD_COMPLETE_BIT, pdTRUE, pdFALSE, portMAX_DELAY);
-
-        size_t remaining_bytes = 0;
-        do {
-            audio_playback_remaining_bytes(g_app_audio_data.playback_handle, &remaining_bytes);
-            vTaskDelay(pdMS_TO_TICKS(10));
-        } while (remaining_bytes > 0);
-
-        vTaskDelay(pdMS_TO_TICKS(100));
-
-        ESP_LOGI(TAG, "Speaker playback complete");
-        g_app_audio_data.audio_playback_complete = true;
-        app_device_event_enqueue(DEVICE_EVENT_SPEECH_PLAYBACK_COMPLETE, NULL);
-    }
-
-    vTaskDelete(NULL);
-}
-
 static esp_err_t app_audio_get_volume_cb(uint8_t *volume)
 {
     if (!g_app_audio_data.initialized) {
@@ -340,7 +611,6 @@ esp_err_t app_audio_init(void)
     /* Register volume callbacks with RainMaker */
     ESP_RETURN_ON_ERROR(setup_rainmaker_register_volume_callbacks(app_audio_get_volume_cb, app_audio_set_volume_cb), TAG, "Failed to register volume callbacks");
 
-    g_app_audio_data.event_group = xEventGroupCreate();
     g_app_audio_data.initialized = true;
 
     return ESP_OK;
@@ -353,7 +623,6 @@ esp_err_t app_audio_start(void)
     }
 
     xTaskCreate(audio_microphone_task, "audio_microphone_task", 1024 * 4, NULL, 8, NULL);
-    xTaskCreate(download_complete_task, "download_complete_task", 1024 * 4, NULL, 8, NULL);
 
     ESP_RETURN_ON_ERROR(audio_recorder_start(g_app_audio_data.recorder_handle), TAG, "Failed to start audio recorder");
     ESP_RETURN_ON_ERROR(audio_playback_start(g_app_audio_data.playback_handle), TAG, "Failed to start audio playback");
@@ -365,17 +634,49 @@ esp_err_t app_audio_play_speech(uint8_t *data, size_t data_len)
 {
     if (!g_app_audio_data.speaker_active) {
         ESP_LOGD(TAG, "Speaker is not active. Skipping playback.");
+        free(data);
         return ESP_OK;
     }
 
     if (g_app_audio_data.audio_playback_complete) {
         ESP_LOGD(TAG, "Playback complete. Dropping speech data: %d bytes", data_len);
+        free(data);
         return ESP_OK;
     }
 
-    return audio_playback_write(g_app_audio_data.playback_handle, data, data_len);
+    return audio_playback_write_nocopy(g_app_audio_data.playback_handle, data, data_len, NULL, NULL);
+}
+
+
+static uint32_t audio_config_frame_duration_us(const esp_agent_audio_config_t *config)
+{
+    return config->frame_duration_us ? config->frame_duration_us : config->frame_duration * 1000;
 }
 
+esp_err_t app_audio_set_audio_config(const esp_agent_audio_config_t *upload, const esp_agent_audio_config_t *download)
+{
+    if (upload == NULL || download == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!g_app_audio_data.initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    ESP_LOGI(TAG, "Audio config: upload %d Hz %" PRIu32 " us, download %d Hz %" PRIu32 " us",
+             upload->sample_rate, audio_config_frame_duration_us(upload),
+             download->sample_rate, audio_config_frame_duration_us(download));
+
+    g_app_audio_data.recorder_sample_rate = upload->sample_rate;
+    g_app_audio_data.recorder_frame_duration_us = audio_config_frame_duration_us(upload);
+    g_app_audio_data.recorder_reconfig_pending = true;
+
+    audio_playback_audio_info_t playback_info = {
+        .sample_rate = download->sample_rate,
+        .frame_duration_us = audio_config_frame_duration_us(download),
+        .codec = AUDIO_PLAYBACK_CODEC,
+    };
+    return audio_playback_reconfigure(g_app_audio_data.playback_handle, &playback_info);
+}
 
 esp_err_t app_audio_set_playback_volume(uint8_t volume)
 {
@@ -395,6 +696,16 @@ esp_err_t app_audio_set_playback_volume(uint8_t volume)
     return ESP_OK;
 }
 
+uint8_t app_audio_get_playback_volume(void)
+{
+    return g_app_audio_data.volume;
+}
+
+int64_t app_audio_get_speech_end_time(void)
+{
+    return g_app_audio_data.speech_end_us;
+}
+
 esp_err_t app_audio_microphone_set_state(app_audio_microphone_state_t state)
 {
     switch (state) {
@@ -412,7 +723,8 @@ esp_err_t app_audio_microphone_set_state(app_audio_microphone_state_t state)
     }
     g_app_audio_data.microphone_state = state;
 
-    return ESP_OK;
+    /* Frames are still needed while paused, for the keepalive */
+    return audio_recorder_set_idle(g_app_audio_data.recorder_handle, state == MICROPHONE_STATE_STOP);
 }
 
 
@@ -432,13 +744,17 @@ esp_err_t app_audio_speaker_stop(void)
     return ESP_OK;
 }
 
+esp_err_t app_audio_speaker_flush(void)
+{
+    return audio_playback_flush(g_app_audio_data.playback_handle);
+}
+
 esp_err_t app_audio_speaker_download_complete(void)
 {
     ESP_LOGI(TAG, "Speaker download complete");
 
-    xEventGroupSetBits(g_app_audio_data.event_group, AUDIO_DOWNLOAD_COMPLETE_BIT);
-
-    return ESP_OK;
+    /* Completion is reported by the drained callback once the speech before the mark has played */
+    return audio_playback_write_end(g_app_audio_data.playback_handle);
 }
 
 esp_err_t app_audio_set_awake(bool awake)
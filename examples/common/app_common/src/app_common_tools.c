@@ -17,6 +17,64 @@
 
 static const char *TAG = "app_common_tools";
 
+enum {
+    SET_REMINDER_PARAM_TASK,
+    SET_REMINDER_PARAM_TIMEOUT,
+};
+
+static const esp_agent_tool_param_schema_t set_reminder_params[] = {
+    [SET_REMINDER_PARAM_TASK] = {.name = "task", .type = ESP_AGENT_PARAM_TYPE_STRING, .required = true},
+    [SET_REMINDER_PARAM_TIMEOUT] = {.name = "timeout", .type = ESP_AGENT_PARAM_TYPE_NUMBER, .required = true},
+};
+
+const esp_agent_tool_config_t app_common_tools_set_reminder_config = {
+    .params = set_reminder_params,
+    .num_params = sizeof(set_reminder_params) / sizeof(set_reminder_params[0]),
+};
+
+/* The time is reported with a resolution of one second */
+const esp_agent_tool_config_t app_common_tools_get_local_time_config = {
+    .cache_ttl_ms = 1000,
+};
+
+enum {
+    SET_VOLUME_PARAM_VOLUME,
+};
+
+static const esp_agent_tool_param_schema_t set_volume_params[] = {
+    [SET_VOLUME_PARAM_VOLUME] = {.name = "volume", .type = ESP_AGENT_PARAM_TYPE_NUMBER, .required = true},
+};
+
+const esp_agent_tool_config_t app_common_tools_set_volume_config = {
+    .params = set_volume_params,
+    .num_params = sizeof(set_volume_params) / sizeof(set_volume_params[0]),
+};
+
+#define LOCAL_COMMAND_VOLUME_STEP 10
+
+enum {
+    LOCAL_COMMAND_VOLUME_UP,
+    LOCAL_COMMAND_VOLUME_DOWN,
+    LOCAL_COMMAND_VOLUME_MUTE,
+    LOCAL_COMMAND_VOLUME_MAX,
+    LOCAL_COMMAND_STOP,
+};
+
+const audio_recorder_command_t app_common_tools_local_commands[] = {
+    {.id = LOCAL_COMMAND_VOLUME_UP, .phrase = "volume up"},
+    {.id = LOCAL_COMMAND_VOLUME_UP, .phrase = "turn up the volume"},
+    {.id = LOCAL_COMMAND_VOLUME_UP, .phrase = "louder"},
+    {.id = LOCAL_COMMAND_VOLUME_DOWN, .phrase = "volume down"},
+    {.id = LOCAL_COMMAND_VOLUME_DOWN, .phrase = "turn down the volume"},
+    {.id = LOCAL_COMMAND_VOLUME_DOWN, .phrase = "quieter"},
+    {.id = LOCAL_COMMAND_VOLUME_MUTE, .phrase = "mute"},
+    {.id = LOCAL_COMMAND_VOLUME_MAX, .phrase = "maximum volume"},
+    {.id = LOCAL_COMMAND_STOP, .phrase = "stop"},
+    {.id = LOCAL_COMMAND_STOP, .phrase = "never mind"},
+};
+
+const size_t app_common_tools_num_local_commands = sizeof(app_common_tools_local_commands) / sizeof(app_common_tools_local_commands[0]);
+
 static void reminder_timer_callback(void *arg)
 {
     char *task = (char *)arg;
@@ -39,21 +97,14 @@ esp_err_t app_common_tools_set_reminder_handler(esp_agent_handle_t handle, const
                                                 esp_agent_tool_param_t params[], size_t num_params, void *user_data,
                                                 char **result)
 {
-    const char *task = NULL;
-    int timeout = 0;
+    /* Parameters are validated against set_reminder_params before the handler runs */
+    const char *task = params[SET_REMINDER_PARAM_TASK].value.s;
+    int timeout = params[SET_REMINDER_PARAM_TIMEOUT].value.i;
     esp_err_t ret = ESP_OK;
     char *task_copy = NULL;
     esp_timer_handle_t timer_handle = NULL;
 
-    for (size_t i = 0; i < num_params; i++) {
-        if (strcmp(params[i].name, "task") == 0 && params[i].type == ESP_AGENT_PARAM_TYPE_STRING) {
-            task = params[i].value.s;
-        } else if (strcmp(params[i].name, "timeout") == 0 && params[i].type == ESP_AGENT_PARAM_TYPE_NUMBER) {
-            timeout = params[i].value.i;
-        }
-    }
-
-    if (!task || timeout <= 0) {
+    if (timeout <= 0) {
         *result =
             strdup("Error: Invalid parameters. 'task' must be a string and 'timeout' must be a positive integer.");
         ret = ESP_ERR_INVALID_ARG;
@@ -136,20 +187,8 @@ esp_err_t app_common_tools_set_volume_handler(esp_agent_handle_t handle, const c
                                               esp_agent_tool_param_t params[], size_t num_params, void *user_data,
                                               char **result)
 {
-    int volume = -1;
-    esp_err_t err = ESP_OK;
-    for (size_t i = 0; i < num_params; i++) {
-        if (strncmp(params[i].name, "volume", strlen("volume")) == 0 && params[i].type == ESP_AGENT_PARAM_TYPE_NUMBER) {
-            volume = params[i].value.i;
-        }
-    }
-    if (volume == -1) {
-        *result = strdup("Volume parameter not found.");
-        err = ESP_ERR_INVALID_ARG;
-        return err;
-    }
-
-    err = app_audio_set_playback_volume(volume);
+    int volume = params[SET_VOLUME_PARAM_VOLUME].value.i;
+    esp_err_t err = app_audio_set_playback_volume(volume);
     if (err == ESP_OK) {
         *result = strdup("Volume set successfully.");
     } else {
@@ -157,3 +196,37 @@ esp_err_t app_common_tools_set_volume_handler(esp_agent_handle_t handle, const c
     }
     return err;
 }
+
+static esp_err_t local_command_set_volume(int volume)
+{
+    volume = volume < 0 ? 0 : (volume > 100 ? 100 : volume);
+    esp_agent_tool_param_t params[] = {
+        [SET_VOLUME_PARAM_VOLUME] = {.name = "volume", .type = ESP_AGENT_PARAM_TYPE_NUMBER, .value.i = volume},
+    };
+    char *result = NULL;
+
+    esp_err_t err = app_common_tools_set_volume_handler(NULL, TOOL_NAME_SET_VOLUME, params,
+                                                        sizeof(params) / sizeof(params[0]), NULL, &result);
+    free(result);
+    return err;
+}
+
+esp_err_t app_common_tools_run_local_command(int command_id)
+{
+    switch (command_id) {
+        case LOCAL_COMMAND_VOLUME_UP:
+            return local_command_set_volume(app_audio_get_playback_volume() + LOCAL_COMMAND_VOLUME_STEP);
+        case LOCAL_COMMAND_VOLUME_DOWN:
+            return local_command_set_volume(app_audio_get_playback_volume() - LOCAL_COMMAND_VOLUME_STEP);
+        case LOCAL_COMMAND_VOLUME_MUTE:
+            return local_command_set_volume(0);
+        case LOCAL_COMMAND_VOLUME_MAX:
+            return local_command_set_volume(100);
+        case LOCAL_COMMAND_STOP:
+            /* Ending the turn is all there is to do */
+            return ESP_OK;
+        default:
+            ESP_LOGW(TAG, "Unknown local command: %d", command_id);
+            return ESP_ERR_NOT_FOUND;
+    }
+}
@@ -11,6 +11,7 @@
 #include "app_agent.h"
 #include "app_audio.h"
 #include "app_device.h"
+#include "app_common_tools.h"
 #include "app_capacitive_touch.h"
 #include "app_touch_press.h"
 #include "board_defs.h"
@@ -37,6 +38,7 @@ typedef enum {
     DEVICE_ACTION_MICROPHONE_STOP,
     DEVICE_ACTION_SPEAKER_START,
     DEVICE_ACTION_SPEAKER_STOP,
+    DEVICE_ACTION_SPEAKER_FLUSH,
     DEVICE_ACTION_SLEEP_TIMER_START,
     DEVICE_ACTION_SLEEP_TIMER_STOP,
     DEVICE_ACTION_MAX,
@@ -59,6 +61,8 @@ typedef struct {
     bool reminder_active;
     esp_timer_handle_t reminder_complete_timer;
     bool system_initialized;
+    int64_t barge_in_start_us;          /* Touch or server barge-in waiting for the speech to go silent */
+    const char *barge_in_source;
     esp_err_t (*set_text_cb)(app_device_text_type_t text_type, const char *text, void *priv_data);
     esp_err_t (*system_state_changed_cb)(app_device_system_state_t new_state, void *priv_data);
     void *priv_data;
@@ -171,6 +175,10 @@ static void device_perform_action(device_action_t action)
             app_audio_speaker_stop();
             break;
 
+        case DEVICE_ACTION_SPEAKER_FLUSH:
+            app_audio_speaker_flush();
+            break;
+
         case DEVICE_ACTION_SLEEP_TIMER_STOP:
             esp_timer_stop(g_device_data.sleep_timer);
             break;
@@ -186,6 +194,17 @@ static void device_perform_action(device_action_t action)
 
 }
 
+/* Cut the assistant's speech within a mixer period, the microphone restarts once the playback has drained */
+static void device_barge_in(int64_t start_us, const char *source)
+{
+    device_perform_action(DEVICE_ACTION_SPEAKER_STOP);
+    /* Timed by DEVICE_EVENT_SPEECH_SILENCED, once the mixer has faded the speech out */
+    g_device_data.barge_in_start_us = start_us;
+    g_device_data.barge_in_source = source;
+    device_perform_action(DEVICE_ACTION_SPEAKER_FLUSH);
+    app_device_event_enqueue(DEVICE_EVENT_SPEECH_END, NULL);
+}
+
 void device_process_event(app_device_event_t event, void *data)
 {
     device_event_container_t *container = (device_event_container_t *)data;
@@ -212,6 +231,10 @@ void device_process_event(app_device_event_t event, void *data)
             device_perform_action(DEVICE_ACTION_SPEAKER_START);
             device_perform_action(DEVICE_ACTION_SLEEP_TIMER_STOP);
 
+            if (g_device_data.state == DEVICE_STATE_LISTENING && app_audio_get_speech_end_time()) {
+                ESP_LOGI(TAG, "Cloud response latency: %" PRId64 " ms from the end of speech",
+                         (esp_timer_get_time() - app_audio_get_speech_end_time()) / 1000);
+            }
             g_device_data.state = DEVICE_STATE_SPEAKING;
             break;
 
@@ -277,8 +300,8 @@ void device_process_event(app_device_event_t event, void *data)
             if (g_device_data.state == DEVICE_STATE_LISTENING) {
                 app_device_event_enqueue(DEVICE_EVENT_SLEEP, NULL);
             } else if (g_device_data.state == DEVICE_STATE_SPEAKING) {
-                device_perform_action(DEVICE_ACTION_SPEAKER_STOP);
-                app_device_event_enqueue(DEVICE_EVENT_SPEECH_END, NULL);
+                app_agent_send_barge_in();
+                device_barge_in(has_data ? event_data.interrupt.start_us : 0, "touch");
             } else {
                 /* Will wait for current playback to complete and then start the microphone again */
                 app_device_event_enqueue(DEVICE_EVENT_WAKEUP, NULL);
@@ -350,6 +373,43 @@ void device_process_event(app_device_event_t event, void *data)
             }
             break;
 
+        case DEVICE_EVENT_BARGE_IN:
+            /* The server has already stopped the response */
+            if (g_device_data.state == DEVICE_STATE_SPEAKING) {
+                device_barge_in(has_data ? event_data.interrupt.start_us : 0, "server barge-in");
+            }
+            break;
+
+        case DEVICE_EVENT_SPEECH_SILENCED:
+            if (has_data && g_device_data.barge_in_start_us) {
+                ESP_LOGI(TAG, "Barge-in: silent %" PRId64 " ms after the %s",
+                         (event_data.silenced.silent_us - g_device_data.barge_in_start_us) / 1000, g_device_data.barge_in_source);
+                g_device_data.barge_in_start_us = 0;
+            }
+            break;
+
+        case DEVICE_EVENT_LOCAL_COMMAND:
+            {
+                if (!has_data) {
+                    break;
+                }
+
+                /* The command was held back from the uplink and is dropped, the turn ends here instead of at the server */
+                device_perform_action(DEVICE_ACTION_MICROPHONE_STOP);
+                g_device_data.wakeup_start_pending = false;
+
+                esp_err_t err = app_common_tools_run_local_command(event_data.command.id);
+                int64_t done_us = esp_timer_get_time();
+                ESP_LOGI(TAG, "Local command %d %s, on-device latency: %" PRId64 " ms from detection, %" PRId64 " ms from the wake word",
+                         event_data.command.id, err == ESP_OK ? "done" : "failed",
+                         (done_us - event_data.command.detect_us) / 1000, (done_us - event_data.command.wakeup_us) / 1000);
+
+                /* AFE doesn't emit wakeup_end event when manually triggered */
+                app_device_event_enqueue(DEVICE_EVENT_SLEEP, NULL);
+                app_audio_trigger_sleep();
+            }
+            break;
+
         default:
             ESP_LOGW(TAG, "Event not handled: %d", event);
             break;
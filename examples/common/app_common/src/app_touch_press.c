@@ -62,7 +62,9 @@ bool app_touch_press_on_inactive(void)
     }
 
     if (!s_factory_reset_triggered) {
-        app_device_event_enqueue_from_isr(DEVICE_EVENT_INTERRUPT, NULL);
+        /* Start of the touch to silence latency of a barge-in */
+        device_event_data_t event_data = { .interrupt = { .start_us = esp_timer_get_time() } };
+        app_device_event_enqueue_from_isr(DEVICE_EVENT_INTERRUPT, &event_data);
     } else {
         agent_setup_factory_reset();
     }
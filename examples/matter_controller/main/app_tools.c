@@ -17,6 +17,45 @@
 
 static const char *TAG = "app_agent_tools";
 
+enum {
+    SET_EMOTION_PARAM_EMOTION_NAME,
+};
+
+static const esp_agent_tool_param_schema_t set_emotion_params[] = {
+    [SET_EMOTION_PARAM_EMOTION_NAME] = {.name = "emotion_name", .type = ESP_AGENT_PARAM_TYPE_STRING, .required = true},
+};
+
+static const esp_agent_tool_config_t set_emotion_config = {
+    .params = set_emotion_params,
+    .num_params = sizeof(set_emotion_params) / sizeof(set_emotion_params[0]),
+};
+
+enum {
+    CONTROL_DEVICE_PARAM_NODE_ID,
+    CONTROL_DEVICE_PARAM_CLUSTER_ID,
+    CONTROL_DEVICE_PARAM_COMMAND_ID,
+    CONTROL_DEVICE_PARAM_COMMAND_ARGS,
+};
+
+static const esp_agent_tool_param_schema_t control_device_params[] = {
+    [CONTROL_DEVICE_PARAM_NODE_ID] = {.name = "node_id", .type = ESP_AGENT_PARAM_TYPE_STRING, .required = true},
+    [CONTROL_DEVICE_PARAM_CLUSTER_ID] = {.name = "cluster_id", .type = ESP_AGENT_PARAM_TYPE_NUMBER, .required = true},
+    [CONTROL_DEVICE_PARAM_COMMAND_ID] = {.name = "command_id", .type = ESP_AGENT_PARAM_TYPE_NUMBER, .required = true},
+    [CONTROL_DEVICE_PARAM_COMMAND_ARGS] = {.name = "command_args", .type = ESP_AGENT_PARAM_TYPE_STRING, .required = false},
+};
+
+static const esp_agent_tool_config_t control_device_config = {
+    .params = control_device_params,
+    .num_params = sizeof(control_device_params) / sizeof(control_device_params[0]),
+};
+
+#define TOOL_NAME_GET_DEVICE_LIST "get_device_list"
+
+/* The list only changes when the device manager refreshes it, see app_tools_device_list_updated */
+static const esp_agent_tool_config_t get_device_list_config = {
+    .cache_ttl_ms = 30000,
+};
+
 #define ERROR_CHECK_WARN(err, msg) \
     if (err != ESP_OK) { \
         ESP_LOGW(TAG, "%s: %s", msg, esp_err_to_name(err)); \
@@ -33,7 +72,9 @@ static esp_err_t app_tools_get_device_list_handler(esp_agent_handle_t handle, co
         *result = strdup(device_list);
         free(device_list);
     } else {
+        /* Report an error, so that the failure is not cached */
         *result = strdup("Failed to get device list.");
+        return ESP_FAIL;
     }
     return ESP_OK;
 }
@@ -42,24 +83,14 @@ static esp_err_t app_tools_control_device_handler(esp_agent_handle_t handle, con
                                                   esp_agent_tool_param_t params[], size_t num_params, void *user_data,
                                                   char **result)
 {
-    const char *node_id = NULL;
-    uint32_t cluster_id = 0;
-    uint32_t command_id = 0;
-    const char *command_params_json = NULL;
-
-    for (size_t i = 0; i < num_params; i++) {
-        if (strcmp(params[i].name, "node_id") == 0 && params[i].type == ESP_AGENT_PARAM_TYPE_STRING) {
-            node_id = params[i].value.s;
-        } else if (strcmp(params[i].name, "cluster_id") == 0 && params[i].type == ESP_AGENT_PARAM_TYPE_NUMBER) {
-            cluster_id = params[i].value.i;
-        } else if (strcmp(params[i].name, "command_id") == 0 && params[i].type == ESP_AGENT_PARAM_TYPE_NUMBER) {
-            command_id = params[i].value.i;
-        } else if (strcmp(params[i].name, "command_args") == 0 && params[i].type == ESP_AGENT_PARAM_TYPE_STRING) {
-            command_params_json = params[i].value.s;
-        }
-    }
-
-    if (!node_id || cluster_id == 0) {
+    /* Parameters are validated against control_device_params before the handler runs */
+    const char *node_id = params[CONTROL_DEVICE_PARAM_NODE_ID].value.s;
+    uint32_t cluster_id = params[CONTROL_DEVICE_PARAM_CLUSTER_ID].value.i;
+    uint32_t command_id = params[CONTROL_DEVICE_PARAM_COMMAND_ID].value.i;
+    const esp_agent_tool_param_t *command_args = &params[CONTROL_DEVICE_PARAM_COMMAND_ARGS];
+    const char *command_params_json = command_args->type == ESP_AGENT_PARAM_TYPE_STRING ? command_args->value.s : NULL;
+
+    if (cluster_id == 0) {
         *result =
             strdup("Error: Invalid parameters. 'node_id' must be a string, 'cluster_id' must be positive integers.");
         return ESP_ERR_INVALID_ARG;
@@ -82,19 +113,8 @@ static esp_err_t app_tools_set_emotion_handler(esp_agent_handle_t handle, const
                                                esp_agent_tool_param_t params[], size_t num_params, void *user_data,
                                                char **result)
 {
-    const char *emotion = NULL;
+    const char *emotion = params[SET_EMOTION_PARAM_EMOTION_NAME].value.s;
     esp_err_t err = ESP_OK;
-    for (size_t i = 0; i < num_params; i++) {
-        if (strncmp(params[i].name, "emotion_name", strlen("emotion_name")) == 0 &&
-            params[i].type == ESP_AGENT_PARAM_TYPE_STRING) {
-            emotion = params[i].value.s;
-        }
-    }
-    if (emotion == NULL) {
-        *result = strdup("Emotion parameter not found.");
-        err = ESP_ERR_INVALID_ARG;
-        return err;
-    }
 
     if (!app_display_is_emotion_valid(emotion)) {
         *result = strdup("Invalid emotion.");
@@ -112,17 +132,27 @@ static esp_err_t app_tools_set_emotion_handler(esp_agent_handle_t handle, const
     return err;
 }
 
+static void app_tools_device_list_updated(void)
+{
+    app_agent_tool_cache_invalidate(TOOL_NAME_GET_DEVICE_LIST);
+}
+
 esp_err_t app_tools_register(void)
 {
     /* Register common tools */
-    app_agent_register_tool(TOOL_NAME_SET_REMINDER, app_common_tools_set_reminder_handler, NULL);
-    app_agent_register_tool(TOOL_NAME_GET_LOCAL_TIME, app_common_tools_get_local_time_handler, NULL);
-    app_agent_register_tool(TOOL_NAME_SET_VOLUME, app_common_tools_set_volume_handler, NULL);
+    app_agent_register_tool_with_config(TOOL_NAME_SET_REMINDER, app_common_tools_set_reminder_handler, NULL,
+                                        &app_common_tools_set_reminder_config);
+    app_agent_register_tool_with_config(TOOL_NAME_GET_LOCAL_TIME, app_common_tools_get_local_time_handler, NULL,
+                                        &app_common_tools_get_local_time_config);
+    app_agent_register_tool_with_config(TOOL_NAME_SET_VOLUME, app_common_tools_set_volume_handler, NULL,
+                                        &app_common_tools_set_volume_config);
 
     /* Register Matter controller specific tools */
-    app_agent_register_tool("get_device_list", app_tools_get_device_list_handler, NULL);
-    app_agent_register_tool("control_device", app_tools_control_device_handler, NULL);
-    app_agent_register_tool("set_emotion", app_tools_set_emotion_handler, NULL);
+    app_agent_register_tool_with_config(TOOL_NAME_GET_DEVICE_LIST, app_tools_get_device_list_handler, NULL,
+                                        &get_device_list_config);
+    matter_controller_set_device_list_update_cb(app_tools_device_list_updated);
+    app_agent_register_tool_with_config("control_device", app_tools_control_device_handler, NULL, &control_device_config);
+    app_agent_register_tool_with_config("set_emotion", app_tools_set_emotion_handler, NULL, &set_emotion_config);
 
     return ESP_OK;
 }
@@ -39,8 +39,12 @@
 #include <esp_matter_controller_credentials_issuer.h>
 #include <matter_controller_std.h>
 
+#include <app_controller.h>
+
 static const char *TAG = "app_controller";
 
+static matter_controller_device_list_update_cb_t s_device_list_update_cb = NULL;
+
 /* Callback to handle commands received from the RainMaker cloud */
 static esp_err_t write_cb(const esp_rmaker_device_t *device, const esp_rmaker_param_t *param,
                           const esp_rmaker_param_val_t val, void *priv_data, esp_rmaker_write_ctx_t *ctx)
@@ -148,7 +152,7 @@ static esp_err_t matter_controller_start()
     esp_matter::lock::chip_stack_lock(portMAX_DELAY);
     ESP_RETURN_ON_ERROR(esp_matter::controller::matter_controller_client::get_instance().init(0, 0, 5580), TAG, "Failed to initialize Matter Controller Client");
     esp_matter::lock::chip_stack_unlock();
-    ESP_RETURN_ON_ERROR(init_device_manager(NULL), TAG, "Failed to initialize Device Manager");
+    ESP_RETURN_ON_ERROR(init_device_manager(s_device_list_update_cb), TAG, "Failed to initialize Device Manager");
     /* Update matter controller after joining to Wi-Fi network */
     esp_event_handler_register(IP_EVENT, IP_EVENT_STA_GOT_IP, &update_controller_handler, NULL);
     return ESP_OK;
@@ -163,6 +167,11 @@ static void matter_controller_launcher_task(void *pvParameters)
     vTaskDelete(NULL);
 }
 
+extern "C" void matter_controller_set_device_list_update_cb(matter_controller_device_list_update_cb_t cb)
+{
+    s_device_list_update_cb = cb;
+}
+
 extern "C" esp_err_t matter_controller_start_task(void)
 {
     if (xTaskCreate(matter_controller_launcher_task, "launch_matter", 5120, NULL, 6, NULL) != pdTRUE) {
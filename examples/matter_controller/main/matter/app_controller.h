@@ -19,6 +19,20 @@ extern "C" {
  */
 esp_err_t matter_controller_start_task(void);
 
+/**
+ * @brief Callback invoked after the device list has been refreshed from the cloud
+ */
+typedef void (*matter_controller_device_list_update_cb_t)(void);
+
+/**
+ * @brief Set the callback for device list updates
+ *
+ * Must be called before `matter_controller_start_task`
+ *
+ * @param cb Callback, NULL to clear
+ */
+void matter_controller_set_device_list_update_cb(matter_controller_device_list_update_cb_t cb);
+
 esp_err_t matter_controller_get_device_list(char **device_list_json);
 
 esp_err_t matter_controller_control_device(char **result, uint64_t node_id, uint32_t cluster_id, uint32_t command_id,
@@ -15,23 +15,25 @@
 
 static const char *TAG = "app_agent_tools";
 
+enum {
+    SET_EMOTION_PARAM_EMOTION_NAME,
+};
+
+static const esp_agent_tool_param_schema_t set_emotion_params[] = {
+    [SET_EMOTION_PARAM_EMOTION_NAME] = {.name = "emotion_name", .type = ESP_AGENT_PARAM_TYPE_STRING, .required = true},
+};
+
+static const esp_agent_tool_config_t set_emotion_config = {
+    .params = set_emotion_params,
+    .num_params = sizeof(set_emotion_params) / sizeof(set_emotion_params[0]),
+};
+
 static esp_err_t app_tools_set_emotion_handler(esp_agent_handle_t handle, const char *tool_name,
                                                esp_agent_tool_param_t params[], size_t num_params, void *user_data,
                                                char **result)
 {
-    const char *emotion = NULL;
+    const char *emotion = params[SET_EMOTION_PARAM_EMOTION_NAME].value.s;
     esp_err_t err = ESP_OK;
-    for (size_t i = 0; i < num_params; i++) {
-        if (strncmp(params[i].name, "emotion_name", strlen("emotion_name")) == 0 &&
-            params[i].type == ESP_AGENT_PARAM_TYPE_STRING) {
-            emotion = params[i].value.s;
-        }
-    }
-    if (emotion == NULL) {
-        *result = strdup("Emotion parameter not found.");
-        err = ESP_ERR_INVALID_ARG;
-        return err;
-    }
 
     /* Check if LLM has provided a valid emotion name */
     if (!app_display_is_emotion_valid(emotion)) {
@@ -53,12 +55,15 @@ static esp_err_t app_tools_set_emotion_handler(esp_agent_handle_t handle, const
 esp_err_t app_tools_register(void)
 {
     /* Register common tools */
-    app_agent_register_tool(TOOL_NAME_SET_REMINDER, app_common_tools_set_reminder_handler, NULL);
-    app_agent_register_tool(TOOL_NAME_GET_LOCAL_TIME, app_common_tools_get_local_time_handler, NULL);
-    app_agent_register_tool(TOOL_NAME_SET_VOLUME, app_common_tools_set_volume_handler, NULL);
+    app_agent_register_tool_with_config(TOOL_NAME_SET_REMINDER, app_common_tools_set_reminder_handler, NULL,
+                                        &app_common_tools_set_reminder_config);
+    app_agent_register_tool_with_config(TOOL_NAME_GET_LOCAL_TIME, app_common_tools_get_local_time_handler, NULL,
+                                        &app_common_tools_get_local_time_config);
+    app_agent_register_tool_with_config(TOOL_NAME_SET_VOLUME, app_common_tools_set_volume_handler, NULL,
+                                        &app_common_tools_set_volume_config);
 
     /* Register voice_chat specific tools */
-    app_agent_register_tool("set_emotion", app_tools_set_emotion_handler, NULL);
+    app_agent_register_tool_with_config("set_emotion", app_tools_set_emotion_handler, NULL, &set_emotion_config);
 
     return ESP_OK;
 }